@@ -0,0 +1,241 @@
+/**
+ * Static SRAM arena
+ *
+ * Every sizeable buffer lives here, partitioned at compile time, so nothing
+ * is allocated at run time and the whole budget is visible in one place.
+ * Page buffers are shared over time: while the read engine runs, the ones
+ * it does not use hold the TX ring. The page cache keeps its lines.
+ * Only one job runs at a time, so the state of each kind of job shares
+ * the job union with the others.
+ * The build fails if the arena outgrows ARENA_BUDGET.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+#include "script.h"
+
+// A run of bytes that differ between the chip and the image, found by verify
+struct MismatchRange {
+  unsigned long start;
+  unsigned long end;     // Last differing byte + 1
+  unsigned long differ;  // Bytes that differ within the run
+  byte chip[4];          // The first differing bytes, as read
+  byte image[4];         // and as expected
+};
+
+#define MISMATCH_RANGES  (LINE_BUFFER_SIZE / sizeof(MismatchRange))
+
+// Byte patterns to search for, one after another (search.h)
+struct SearchPatterns {
+  byte data[SEARCH_MAX_BYTES];
+  byte mask[SEARCH_MAX_BYTES];  // Bits that must match
+  byte length[SEARCH_MAX_PATTERNS];
+  byte count;
+};
+
+// Content statistics map (blockmap.h)
+struct BlockMapJob {
+  MemoryDevice dev;
+  unsigned long block;     // Bytes per block
+  unsigned long blocks;
+  unsigned long filled;    // Bytes of the current block counted so far
+  unsigned long ff;
+  unsigned long zero;
+  unsigned long first;     // Offsets of the first and last byte not 0xFF
+  unsigned long last;
+  unsigned long blankStart;  // Address of a run of blank blocks not yet printed
+  bool inBlank;
+  unsigned long used;
+  bool running;            // The read job has been started
+  unsigned long startTime;
+};
+
+// Chip-to-chip copy (clone.h)
+struct CloneJob {
+  MemoryDevice source;
+  MemoryDevice target;
+  unsigned long address;
+  unsigned long length;
+  byte stage;
+  unsigned long startTime;
+};
+
+// One image into a gang of SPI flashes (gang.h)
+struct GangJob {
+  unsigned long address;
+  unsigned long length;
+  byte stage;
+  byte chip;        // Chip being checked
+  byte dropped;     // Chips lost before the check
+  unsigned long startTime;
+};
+
+// CRC-32 per erase unit (hashmap.h)
+struct HashMapJob {
+  MemoryDevice dev;
+  unsigned long unit;      // Bytes per hash
+  unsigned long units;
+  unsigned long filled;    // Bytes of the current unit hashed so far
+  uint32_t crc;
+  bool running;            // The read job has been started
+  unsigned long startTime;
+};
+
+// Serial link speed negotiation (link.h)
+struct LinkNegotiation {
+  unsigned long baud;           // Proposed rate
+  unsigned long previous;       // Rate to return to
+  byte state;
+  byte matched;                 // Sync word characters seen so far
+  unsigned int count;           // Test bytes echoed
+  uint32_t crc;
+  unsigned long lastActivity;   // millis() of the last progress
+};
+
+// Test pattern generator and checker (pattern.h)
+struct PatternGenerator {
+  byte kind;
+  uint32_t seed;
+  byte invert;            // XORed into every byte
+  uint32_t state;         // Random pattern: current xorshift32 output
+  unsigned long start;    // First address of the job
+  unsigned long address;  // Address of the next byte
+  unsigned long errors;
+  unsigned long firstError;
+};
+
+// A pattern fill or check started from the menu
+struct PatternRun {
+  MemoryDevice dev;
+  unsigned long start;
+  unsigned long length;
+  bool check;
+  bool started;
+  unsigned long startTime;
+};
+
+// Time totals of a memory test cycle
+enum MemTestTime {
+  MT_TIME_ERASE,
+  MT_TIME_PROGRAM,
+  MT_TIME_READ,
+  MT_TIMES
+};
+
+// March / endurance memory test (memtest.h)
+struct MemTestJob {
+  MemoryDevice dev;
+  unsigned long address;
+  unsigned long length;
+  unsigned int cycles;
+  unsigned int cycle;          // 1-based
+  byte step;                   // Half * MT_OPS + MemTestOp
+  bool running;                // The step's job has been started
+  bool needsErase;
+  bool savedVerify;            // writeVerify, restored at the end
+  unsigned long stepStart;
+  unsigned long times[MT_TIMES];
+  unsigned long firstTimes[MT_TIMES];
+  unsigned long errors;        // Bytes or operations that failed this cycle
+  unsigned long firstError;
+  unsigned int failedCycles;
+  unsigned long startTime;
+};
+
+// Stored job script being run (script.h)
+struct ScriptRun {
+  MemoryDevice dev;
+  byte count;
+  byte index;
+  byte phase;
+  ScriptStep step;
+  unsigned long startTime;
+  unsigned long deadline;
+};
+
+// Byte pattern search (search.h)
+struct SearchJob {
+  MemoryDevice dev;
+  unsigned long address;
+  unsigned long length;
+  byte shortest;           // Length the skip table is built for
+  byte longest;
+  byte carried;            // Bytes from earlier chunks still to search, in arena.scratch
+  byte skipAhead;          // Bytes of the next chunk the last shift jumped over
+  unsigned long base;      // Address of the first carried byte
+  unsigned long matches;
+  bool running;            // The read job has been started
+  unsigned long startTime;
+};
+
+struct Arena {
+  union {
+    char line[LINE_BUFFER_SIZE];              // Serial RX line assembly; free while a job runs
+    MismatchRange mismatch[MISMATCH_RANGES];  // Verify: the first ranges that differ
+    uint32_t nibbles[16];                     // Block map: nibble counts of a block
+  };
+  union {
+    char text[TEXT_BUFFER_SIZE];  // Output line formatting
+    SearchPatterns patterns;      // Search; its matches are printed without it
+  };
+  byte scratch[COMPARE_CHUNK];  // Chip data read back for comparison
+#if FEATURE_CACHE
+  byte cache[PAGE_CACHE_LINES][PAGE_CACHE_LINE_SIZE];  // Page cache (cache.h)
+#endif
+  union {
+    byte page[PAGE_BUFFER_COUNT][PAGE_BUFFER_SIZE];  // Write engines
+    struct {
+      byte chunk[PAGE_BUFFER_SIZE];  // Read engine
+      byte tx[TX_RING_SIZE];         // Dump output waiting for the UART (txring.h)
+    } reader;
+    struct {
+      byte chunk[PAGE_BUFFER_SIZE];  // Read engine
+      byte skip[256];                // Horspool shift for each byte value; the search
+    } search;                        // prints directly, so the TX ring is idle
+  };
+  union {
+#if FEATURE_BLOCKMAP
+    BlockMapJob blockMap;
+#endif
+#if FEATURE_CLONE
+    CloneJob clone;
+#endif
+#if FEATURE_GANG
+    GangJob gang;
+#endif
+#if FEATURE_HASHMAP
+    HashMapJob hashMap;
+#endif
+#if FEATURE_LINK
+    LinkNegotiation link;
+#endif
+#if FEATURE_PATTERN
+    struct {
+      PatternGenerator generator;  // Also drives the memory test's steps
+      union {
+        PatternRun run;
+        MemTestJob test;
+      };
+    } pattern;
+#endif
+#if FEATURE_SCRIPT
+    ScriptRun script;
+#endif
+#if FEATURE_SEARCH
+    SearchJob search;
+#endif
+  } job;  // State of the running job; set up afresh when one starts
+};
+
+static_assert(TX_RING_SIZE >= TEXT_BUFFER_SIZE + 2, "The TX ring must hold a whole dump line");
+static_assert(!FEATURE_SEARCH || TX_RING_SIZE >= 256, "The search skip table must fit in the TX ring's place");
+static_assert(PAGE_BUFFER_COUNT >= 2, "The write pipeline needs at least two page buffers");
+static_assert(sizeof(Arena) <= ARENA_BUDGET, "SRAM arena exceeds ARENA_BUDGET");
+
+extern Arena arena;
+
+#endif
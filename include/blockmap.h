@@ -0,0 +1,35 @@
+/**
+ * Content statistics map
+ *
+ * Reads a chip once and prints a few figures per block, to see which
+ * regions are in use before deciding what to dump. Blocks are the erase
+ * unit (4K sectors on SPI flash, blocks on NAND, EEPROM pages) unless a
+ * size is given. Each line holds the block address, the share of 0xFF and
+ * 0x00 bytes, an entropy estimate in bits per byte and the offsets of the
+ * first and last byte that is not 0xFF; runs of blank blocks take one line:
+ *
+ *   Block map: 256 blocks of 4096 bytes
+ *   00000000 FF=3% 00=41% H=3.2 0000-0FFF
+ *   00001000-000FFFFF blank
+ *   Block map done, 1 of 256 blocks used, 2794 ms
+ *
+ * The entropy is that of the nibble distribution, doubled: 0.0 for a fill,
+ * about 4 to 6 for code and text and near 8.0 for compressed or encrypted
+ * data. It needs 16 counters where a byte histogram would need 256.
+ */
+
+#ifndef BLOCKMAP_H
+#define BLOCKMAP_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_BLOCKMAP
+
+// Run the map as a job sequence; blockSize 0 uses the erase unit
+void blockMapRun(const MemoryDevice& dev, unsigned long blockSize);
+
+#endif
+
+#endif
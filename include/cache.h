@@ -0,0 +1,52 @@
+/**
+ * SRAM page cache
+ *
+ * Keeps the last few lines read from the chips (PAGE_CACHE_LINES lines of
+ * PAGE_CACHE_LINE_SIZE bytes in the arena), keyed by device and address, so
+ * headers, partition tables and other regions that are read again and again
+ * come from SRAM instead of another bus command or NAND page load. Only
+ * read jobs short enough to fit in the cache use it; longer reads stream
+ * past and leave it alone, except for lines read ahead: when a read job
+ * continues where the last one ended, the engine fills the lines after it
+ * while the output is still going out, and the next job takes them from
+ * here (see engine.cpp). Every program or erase drops the lines it
+ * overlaps, on all devices, since a gang or clone writes to chips other
+ * than the one selected. Switching modes empties the cache.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_CACHE
+
+// Reads from the chip, as the engine's readDevice()
+typedef unsigned int (*CacheFetch)(unsigned long address, byte* buffer, unsigned int len);
+
+// True if a read of length bytes at address fits in the cache
+bool cacheFits(unsigned long address, unsigned long length);
+
+// Copy up to len bytes at address, within one line; a miss first fills the
+// least recently used line through fetch. Returns 0 while the chip is busy
+unsigned int cacheRead(const MemoryDevice& dev, unsigned long address, byte* buffer, unsigned int len, CacheFetch fetch);
+
+// Copy up to len bytes at address from a line already read; 0 if there is none
+unsigned int cachePeek(const MemoryDevice& dev, unsigned long address, byte* buffer, unsigned int len);
+
+// Read the line starting at address ahead of use; false while the chip is busy
+bool cachePrefetch(const MemoryDevice& dev, unsigned long address, CacheFetch fetch);
+
+// Drop the lines overlapping the range, whichever device they came from
+void cacheInvalidate(unsigned long address, unsigned long length);
+// Drop every line
+void cacheClear();
+
+// Print the hit and miss counts and start counting afresh
+void printCacheStats();
+
+#endif
+
+#endif
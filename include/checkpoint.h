@@ -0,0 +1,55 @@
+/**
+ * Job checkpoints
+ *
+ * Long reads and image transfers record how far they got: the bytes
+ * completed from the start of the range and a CRC-32 of those bytes. The
+ * record is kept in RAM and, when enabled, in the MCU's internal EEPROM, so
+ * after an abort, a lost link or a reset the host can check the CRC against
+ * its own data and resume from the last completed page.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+enum JobOp {
+  OP_NONE,
+  OP_READ,
+  OP_PROGRAM,
+  OP_DIFF,
+  OP_VERIFY
+};
+
+struct JobCheckpoint {
+  byte op;                // JobOp
+  bool finished;          // The job ran to the end
+  MemoryDevice dev;
+  unsigned long start;
+  unsigned long length;
+  unsigned long done;     // Bytes completed from start, all without error
+  uint32_t crc;           // CRC-32 of the completed bytes
+};
+
+extern JobCheckpoint checkpoint;
+extern bool checkpointPersist;  // Also keep the checkpoint in EEPROM
+
+// Load a checkpoint left in EEPROM by an earlier session; false if none
+bool checkpointRestore();
+
+void checkpointBegin(byte op, const MemoryDevice& dev, unsigned long start, unsigned long length);
+// Record the next completed bytes, in address order
+void checkpointAdvance(const byte* data, unsigned int len);
+// CHECKPOINT_SAVE_INTERVAL bytes have completed since the last EEPROM write
+bool checkpointSyncDue();
+// Write the checkpoint to EEPROM if that is due. This blocks for a few ms
+// per changed byte, so call it only while the host has nothing to send
+void checkpointSync();
+// The job stopped, finished or not; the checkpoint is saved
+void checkpointEnd();
+
+void printCheckpoint();
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * On-device cloning
+ *
+ * Copies a range of the selected chip onto a second chip of the same family,
+ * on another chip select or I2C address, without the data crossing the
+ * serial link. The target's sectors covering the range are erased if it
+ * needs it, the range is programmed through the page buffers (the source
+ * is read while the target programs the previous page), and then the target
+ * is read back and its CRC-32 compared with that of the data read from the
+ * source. One summary line reports the result.
+ */
+
+#ifndef CLONE_H
+#define CLONE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_CLONE
+
+// Run the clone as a job sequence
+void cloneRun(const MemoryDevice& source, const MemoryDevice& target, unsigned long address, unsigned long length);
+
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * Build configuration: feature profile, pin assignments, link settings and
+ * buffer sizes
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+// Feature profiles, selected with a build flag (see platformio.ini):
+//   PROFILE_MINIMAL   I2C EEPROM only, no host image transfer
+//   PROFILE_SPI_ONLY  SPI flash, deeper write pipeline
+//   PROFILE_NAND_ONLY NAND flash, deeper write pipeline
+//   (none)            everything but the diagnostics below
+#if defined(PROFILE_MINIMAL)
+#define FEATURE_NAND          0
+#define FEATURE_SPI           0
+#define FEATURE_I2C           1
+#define FEATURE_IMAGE         0
+#define FEATURE_CHECKPOINT    0
+#define FEATURE_SCRIPT        0
+#define FEATURE_LINK          0
+#define FEATURE_CLONE         0
+#define FEATURE_GANG          0
+#define FEATURE_PATTERN       0
+#define FEATURE_MEMTEST       0
+#define FEATURE_HASHMAP       0
+#define FEATURE_SEARCH        0
+#define FEATURE_BLOCKMAP      0
+#define PAGE_BUFFER_SIZE      64    // EEPROM pages are at most 64 bytes
+#define TX_RING_SIZE          128   // At least one dump line
+#elif defined(PROFILE_SPI_ONLY)
+#define FEATURE_NAND          0
+#define FEATURE_SPI           1
+#define FEATURE_I2C           0
+#define FEATURE_IMAGE         1
+#define FEATURE_CHECKPOINT    1
+#define FEATURE_SCRIPT        1
+#define FEATURE_LINK          1
+#define FEATURE_CLONE         1
+#define FEATURE_GANG          1
+#define FEATURE_PATTERN       1
+#define FEATURE_MEMTEST       1
+#define FEATURE_HASHMAP       1
+#define FEATURE_SEARCH        1
+#define FEATURE_BLOCKMAP      1
+#define PAGE_BUFFER_COUNT     3
+#elif defined(PROFILE_NAND_ONLY)
+#define FEATURE_NAND          1
+#define FEATURE_SPI           0
+#define FEATURE_I2C           0
+#define FEATURE_IMAGE         1
+#define FEATURE_CHECKPOINT    1
+#define FEATURE_SCRIPT        1
+#define FEATURE_LINK          1
+#define FEATURE_CLONE         1
+#define FEATURE_GANG          0
+#define FEATURE_PATTERN       1
+#define FEATURE_MEMTEST       1
+#define FEATURE_HASHMAP       1
+#define FEATURE_SEARCH        1
+#define FEATURE_BLOCKMAP      1
+#define PAGE_BUFFER_COUNT     3
+#else
+#define FEATURE_NAND          1
+#define FEATURE_SPI           1
+#define FEATURE_I2C           1
+#define FEATURE_IMAGE         1     // Program/diff/verify images from the host
+#define FEATURE_CHECKPOINT    1     // Resumable reads and image transfers
+#define FEATURE_SCRIPT        1     // Job scripts stored in EEPROM
+#define FEATURE_LINK          1     // Serial link speed negotiation
+#define FEATURE_CLONE         1     // Chip-to-chip copies on the programmer
+#define FEATURE_GANG          1     // One image into several SPI flashes at once
+#define FEATURE_PATTERN       1     // Test pattern fill and check
+#define FEATURE_MEMTEST       1     // March / endurance memory test
+#define FEATURE_HASHMAP       1     // CRC-32 per erase unit, for incremental backups
+#define FEATURE_SEARCH        1     // Byte pattern search on the programmer
+#define FEATURE_BLOCKMAP      1     // Blank, fill and entropy per block
+#endif
+
+// Diagnostics, for any profile (the native build turns on all but the trace).
+// Their tables do not fit the ATmega328P's SRAM beside a profile's buffers
+#ifndef FEATURE_STATS
+#define FEATURE_STATS         0     // Per-operation timing counters
+#endif
+#ifndef FEATURE_ESTIMATE
+#define FEATURE_ESTIMATE      0     // Dry-run time estimates for script steps
+#endif
+#ifndef FEATURE_CACHE
+#define FEATURE_CACHE         0     // SRAM cache for small repeated reads
+#endif
+#ifndef FEATURE_TRACE
+#define FEATURE_TRACE         0     // Bus transaction trace (see trace.h)
+#endif
+
+static_assert(FEATURE_NAND || FEATURE_SPI || FEATURE_I2C, "The profile enables no memory driver");
+static_assert(!FEATURE_SCRIPT || FEATURE_IMAGE, "Job scripts need host image transfer");
+static_assert(!FEATURE_MEMTEST || FEATURE_PATTERN, "The memory test needs test patterns");
+static_assert(!FEATURE_ESTIMATE || (FEATURE_SCRIPT && FEATURE_STATS), "Estimates need job scripts and operation timing");
+static_assert(!FEATURE_GANG || (FEATURE_SPI && FEATURE_IMAGE), "Gang programming needs SPI and host image transfer");
+
+// Define pin configurations
+#define SPI_CS_PIN      10  // SPI Chip Select
+#define NAND_CLE_PIN    A0  // NAND Command Latch Enable
+#define NAND_ALE_PIN    A1  // NAND Address Latch Enable
+#define NAND_WE_PIN     A2  // NAND Write Enable
+#define NAND_RE_PIN     A3  // NAND Read Enable
+#define NAND_CE_PIN     A4  // NAND Chip Enable
+#define NAND_RB_PIN     A5  // NAND Ready/Busy
+#define NAND_DATA_FIRST_PIN  2  // NAND data bus D2-D9, wired to the ports
+#define NAND_DATA_LAST_PIN   9  // in drv_nand.cpp
+
+// Debug settings
+#define DEBUG_MODE      1   // Set to 0 to disable debug messages
+#define SERIAL_BAUD     115200  // Rate after reset; 'b' negotiates a faster one
+
+// Link speed negotiation (see link.h)
+#define LINK_TEST_BYTES   1024    // Loopback test data echoed at the new rate
+#define LINK_TIMEOUT_MS   2000    // Host silent this long: back to the old rate
+
+// Gang programming (see gang.h)
+#define GANG_MAX_CHIPS  4     // Chip selects programmed together
+#define GANG_SLACK_MS   20    // Beyond twice the quickest chip's time: dropped
+
+// Host image transfers: bytes the host may have been asked for and not
+// yet delivered. Nothing else holds it back, so they must fit the 64-byte
+// RX buffer however long a page program keeps the engine from reading
+#define GRANT_WINDOW    56
+
+// Busy-wait limits for job state machines (ms)
+#define NAND_TIMEOUT_MS       1000
+#define I2C_WRITE_TIMEOUT_MS  20
+#define STREAM_TIMEOUT_MS     5000  // Host stopped sending image data
+
+// Hash map: smallest unit hashed, so a read chunk makes a few lines at most
+#define HASHMAP_MIN_UNIT      64
+
+// Block map: block sizes accepted, in bytes (multiples of the smallest)
+#define BLOCKMAP_MIN_BLOCK    64
+#define BLOCKMAP_MAX_BLOCK    65536UL
+
+// Pattern search: bytes of all patterns together, and matches listed
+#define SEARCH_MAX_PATTERNS   4
+#define SEARCH_MAX_BYTES      32
+#define SEARCH_MAX_MATCHES    64
+
+// Verify against a host image: differing bytes this close together are
+// reported as one range
+#define MISMATCH_GAP          16
+
+// Verify-on-write: read back every programmed page (toggled with 'W')
+#define VERIFY_ON_WRITE       0     // On by default
+#define WRITE_RETRIES         1     // Reprograms of a page that read back wrong
+
+// Job checkpoints (see checkpoint.h)
+#define CHECKPOINT_PERSIST        0       // Keep checkpoints in EEPROM by default
+#define CHECKPOINT_EEPROM_ADDR    0
+#define CHECKPOINT_EEPROM_SIZE    64
+#define CHECKPOINT_SAVE_INTERVAL  16384UL // Bytes between EEPROM updates
+
+// Job scripts (see script.h)
+#define SCRIPT_EEPROM_ADDR        (CHECKPOINT_EEPROM_ADDR + CHECKPOINT_EEPROM_SIZE)
+#define SCRIPT_EEPROM_SIZE        320
+#define SCRIPT_MAX_STEPS          16
+#define SCRIPT_STATUS_TIMEOUT_MS  100
+
+// Dry-run estimates (see estimate.h)
+#define ESTIMATE_STATUS_US        15000   // Status register write (tW)
+
+// Bus trace ring (see trace.h); 18 bytes of SRAM per entry
+#ifndef TRACE_ENTRIES
+#define TRACE_ENTRIES             24
+#endif
+
+// SRAM arena partitions (see arena.h); page buffers may be set by build flags
+#define LINE_BUFFER_SIZE      100   // Longest accepted input line (32 hex bytes fit)
+#define TEXT_BUFFER_SIZE      80    // One formatted output line
+#define COMPARE_CHUNK         32    // Bytes read back per driver call when comparing
+#define PAGE_CACHE_LINES      4     // Page cache (cache.h): lines kept
+#define PAGE_CACHE_LINE_SIZE  64    // Bytes per line, aligned on the chip
+#ifndef PAGE_BUFFER_SIZE
+#define PAGE_BUFFER_SIZE      256   // Largest program unit; SPI flash page
+#endif
+#ifndef PAGE_BUFFER_COUNT
+#define PAGE_BUFFER_COUNT     2     // One fills while another is programmed
+#endif
+#ifndef TX_RING_SIZE
+#define TX_RING_SIZE          ((PAGE_BUFFER_COUNT - 1) * PAGE_BUFFER_SIZE)  // Spare page buffers
+#endif
+// arena.h checks the arena against this; scripts/size_report.py checks all
+// static data against what the stack needs
+#ifndef ARENA_BUDGET
+#define ARENA_BUDGET          1280  // Buffers and job state; 768 bytes stay for the rest
+#endif
+
+// The read engine collects whole 16-byte dump lines in a page buffer
+static_assert(PAGE_BUFFER_SIZE >= 16, "PAGE_BUFFER_SIZE is smaller than a dump line");
+
+#endif
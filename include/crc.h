@@ -0,0 +1,14 @@
+/**
+ * CRC-32 (IEEE 802.3, as used by zlib and most host tools)
+ */
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <Arduino.h>
+
+// Continue a CRC over more data; start with crc = 0. The result matches
+// zlib's crc32(crc, data, len), so chunks can be chained.
+uint32_t crc32(uint32_t crc, const byte* data, unsigned int len);
+
+#endif
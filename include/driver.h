@@ -0,0 +1,115 @@
+/**
+ * Memory driver interface
+ *
+ * Each chip family provides one MemoryDriver, a table of function pointers
+ * kept in PROGMEM. A MemoryDevice pairs a driver with a unit number (SPI chip
+ * select pin, I2C address; unused for NAND), so several chips of one family
+ * can be driven side by side. The engines in engine.h are written once
+ * against this interface.
+ *
+ * Program and erase calls only start the operation; the caller polls for
+ * completion. readStream() returns the bytes it could read, which may be
+ * fewer than requested (e.g. at a NAND page end) or 0 while the chip is busy.
+ */
+
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Geometry flags
+#define GEO_NEEDS_ERASE  0x01  // Programming can only clear bits
+#define GEO_PROGRAM_ONCE 0x02  // Writes already use up the partial programs a page allows
+                                // before an erase, so nothing is programmed twice
+
+struct Geometry {
+  unsigned long capacity;   // Addressable bytes
+  unsigned int pageSize;    // Largest unit one programPage() call accepts
+  unsigned long eraseSize;  // Smallest erase unit (sector)
+  unsigned long blockSize;  // Large erase unit (block)
+  byte flags;
+};
+
+// Typical datasheet timings, for time estimates (estimate.h)
+struct ChipTiming {
+  unsigned long programUs;     // One page: tPP, tPROG or tWR
+  unsigned long eraseUs;       // One eraseSize unit: tSE or tBERS (0 if none)
+  unsigned long blockEraseUs;  // One blockSize unit: tBE
+  unsigned long byteNs;        // Bus time per data byte, with the 16MHz AVR's overhead
+};
+
+enum PollResult {
+  POLL_BUSY,
+  POLL_DONE,
+  POLL_FAILED
+};
+
+struct MemoryDriver {
+  const char* name;  // PROGMEM string
+
+  // Start bringing the interface up after a mode switch; completes via poll()
+  void (*begin)(byte unit);
+  // Copy raw ID bytes into id; returns the number of bytes (0 if none)
+  byte (*readID)(byte unit, byte* id, byte maxLen);
+  // Print a human-readable identification report
+  void (*identify)(byte unit);
+  // Read up to len bytes; sequential calls continue the same bus transaction
+  unsigned int (*readStream)(byte unit, unsigned long address, byte* buffer, unsigned int len);
+  // Start programming len bytes that lie within one page
+  void (*programPage)(byte unit, unsigned long address, const byte* data, unsigned int len);
+  // Start erasing the largest unit at address that fits in length;
+  // returns the bytes from address to the end of that unit (0 if unsupported)
+  unsigned long (*eraseRange)(byte unit, unsigned long address, unsigned long length);
+  // Check the operation in progress
+  PollResult (*poll)(byte unit);
+  // End any open read stream and deselect the chip
+  void (*release)(byte unit);
+  void (*geometry)(byte unit, Geometry& geo);
+  // Print a decoded status report
+  void (*status)(byte unit);
+  // Start writing the status/protection register; false if the chip has none.
+  // Completes via poll()
+  bool (*writeStatus)(byte unit, byte value);
+  void (*timing)(byte unit, ChipTiming& t);
+};
+
+struct MemoryDevice {
+  const MemoryDriver* driver;  // Points into PROGMEM
+  byte unit;
+};
+
+// Call a driver entry point through its PROGMEM table, e.g.
+//   DRIVER(dev, poll)(dev.unit)
+#define DRIVER(dev, fn) \
+  ((decltype(MemoryDriver::fn)) pgm_read_ptr(&(dev).driver->fn))
+
+// Drivers included in the build profile
+#if FEATURE_NAND
+extern const MemoryDriver nandDriver PROGMEM;
+#endif
+#if FEATURE_SPI
+extern const MemoryDriver spiDriver PROGMEM;
+#endif
+#if FEATURE_GANG
+// Identical SPI flashes driven as one (see gang.h): each program or erase
+// goes to every chip in turn and poll() waits for all of them. Chips that
+// have no ID or stay busy much longer than the quickest are marked failed
+// and left out of later operations; reads come from the first healthy chip
+struct SpiGang {
+  byte count;
+  byte pins[GANG_MAX_CHIPS];  // Chip select of each socket
+  byte failed;                // Bit per chip
+};
+
+extern SpiGang spiGang;
+extern const MemoryDriver spiGangDriver PROGMEM;
+#endif
+#if FEATURE_I2C
+extern const MemoryDriver i2cDriver PROGMEM;
+
+// I2C EEPROMs cannot be identified, so their size is configured by the user
+extern unsigned long i2cEepromSize;
+#endif
+
+#endif
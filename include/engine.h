@@ -0,0 +1,105 @@
+/**
+ * Generic memory engines
+ *
+ * Streaming read, pipelined program, diff-program, verify and range erase,
+ * written once against the MemoryDriver interface. Each engine runs as a
+ * scheduler job; the start functions return immediately.
+ *
+ * The write engines cycle through the arena's page buffers: the next ones
+ * are filled from a DataSource while one is being programmed or compared,
+ * so image transfer overlaps the chip's program time. With verify-on-write
+ * each page is read back as soon as it is programmed and compared with the
+ * buffer still holding it, so the image is checked in the same pass.
+ *
+ * Reads and host image transfers record their progress in the job
+ * checkpoint (checkpoint.h) and can be resumed.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+// Image data for the write engines. Sources and sinks are tables in PROGMEM,
+// like the driver tables, and the engines read them with pgm_read_*()
+struct DataSource {
+  // Called once the device is ready, before the first grant (may be NULL)
+  void (*begin)();
+  // Copy up to len bytes into buffer; returns the count (0 while waiting)
+  unsigned int (*fill)(byte* buffer, unsigned int len);
+  // The engine is ready to accept len more bytes (may be NULL)
+  void (*grant)(unsigned int len);
+};
+
+// Consumer of the read engine's data
+struct ReadSink {
+  bool (*ready)();  // False holds back the next chunk
+  void (*consume)(unsigned long address, const byte* data, unsigned int len);
+  void (*finish)();  // May be NULL
+  uint16_t chunk;      // Bytes per consume() call, at most PAGE_BUFFER_SIZE
+};
+
+enum WriteMode {
+  WRITE_PROGRAM,  // Program every page
+  WRITE_DIFF,     // Skip pages that already hold the image data
+  WRITE_VERIFY    // Compare only
+};
+
+// Read back and compare every page programmed; a page that reads back wrong
+// is programmed again (WRITE_RETRIES times) unless it would need an erase
+extern bool writeVerify;
+
+// Human-readable dump of the data read
+extern const ReadSink hexDumpSink PROGMEM;
+
+// CRC-32 of the data read, as computed by zlib
+extern const ReadSink crcSink PROGMEM;
+void crcSinkBegin();
+uint32_t crcSinkValue();
+
+#if FEATURE_IMAGE
+// Raw image bytes from the serial link. The device sends ">" and the byte
+// count it accepts next, followed by a line break, and never asks for more
+// than GRANT_WINDOW bytes beyond those it has received, so the RX buffer
+// cannot overflow while the chip keeps it busy.
+extern const DataSource hostSource PROGMEM;
+
+// The host sends the image PackBits-encoded; the count after ">" is still
+// in decoded bytes. Each header byte h is followed by h + 1 literal bytes
+// (0 to 127) or by one byte to repeat 1 - h times (-127 to -1); -128 is
+// skipped. Packets may run on from one request to the next
+extern bool imagePacked;
+#endif
+
+#if FEATURE_CLONE
+// Another chip, set with setDeviceSource()
+extern const DataSource deviceSource PROGMEM;
+void setDeviceSource(const MemoryDevice& dev, unsigned long address);
+#endif
+
+// Bytes already in RAM, set with setMemorySource()
+extern const DataSource memorySource PROGMEM;
+void setMemorySource(const byte* data);
+
+// Report only failures, for jobs run by a script
+void engineSetQuiet(bool quiet);
+// The last job ran to the end without errors
+bool engineSucceeded();
+// CRC-32 (zlib) of the data the last write job took from its source
+uint32_t engineDataCrc();
+
+// Bring the interface up after a mode switch
+void engineBegin(const MemoryDevice& dev);
+void engineRead(const MemoryDevice& dev, unsigned long address, unsigned long length, const ReadSink& sink);
+void engineWrite(const MemoryDevice& dev, unsigned long address, unsigned long length, const DataSource& source, byte mode);
+void engineErase(const MemoryDevice& dev, unsigned long address, unsigned long length);
+
+#if FEATURE_CHECKPOINT
+// Continue the checkpointed job after its last completed page. Reads go to
+// the hex dump, image transfers request the rest of the image from the host.
+bool engineResume(const MemoryDevice& dev);
+#endif
+
+#endif
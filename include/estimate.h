@@ -0,0 +1,55 @@
+/**
+ * Dry-run time estimates
+ *
+ * Predicts how long a script step, or the whole stored script, takes on
+ * the selected chip without touching it, and breaks each step down into
+ * erase, bus transfer, chip busy (program) and serial link time. The model
+ * starts from the driver's typical datasheet timings (ChipTiming) and
+ * replaces each figure with the average measured by the engines once an
+ * operation has run on the chip, so estimates sharpen after a first run.
+ * Program steps overlap the link with programming, so they take about as
+ * long as the slower of the two; the summary names the phase that
+ * dominates, which is the one worth speeding up (link rate with 'b',
+ * PackBits with 'Z', larger erase units).
+ */
+
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+// What the engines measure
+enum EstimateLearn {
+  LEARN_READ,          // Microseconds per bytes read
+  LEARN_WRITE,         // Microseconds per bytes sent for programming
+  LEARN_PAGE,          // Microseconds busy per page programmed
+  LEARN_SECTOR,        // Microseconds busy per eraseSize unit
+  LEARN_BLOCK,         // Microseconds busy per blockSize unit
+  LEARN_PACKED,        // PackBits bytes received per image bytes
+  LEARN_COUNT
+};
+
+#if FEATURE_ESTIMATE
+
+// Add a measurement: total over count units
+void estimateLearn(byte what, unsigned long total, unsigned long count);
+
+// Forget the measurements, e.g. for another chip
+void estimateReset();
+
+// Estimate one step in script syntax (script.h), or the stored script for
+// "script"; false if the line is invalid
+bool estimateRun(const MemoryDevice& dev, char* line);
+
+// Time from start (micros()) to now over count units
+#define ESTIMATE_LEARN(what, start, count)  estimateLearn(what, micros() - (start), count)
+
+#else
+
+#define ESTIMATE_LEARN(what, start, count)
+
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+/**
+ * Gang programming
+ *
+ * Programs one host image into several identical SPI flashes, each on its
+ * own chip select, while the image crosses the serial link only once. The
+ * range is erased on all chips together, then every page is loaded into
+ * each chip in turn: a chip starts programming as soon as its page is in,
+ * so its busy time overlaps the loading of the others and the next page
+ * arrives from the host meanwhile. Each chip is then read back and its
+ * CRC-32 compared with that of the image. A chip that does not answer,
+ * hangs busy or reads back wrong is reported and the others carry on; the
+ * result is one line per chip and a summary.
+ */
+
+#ifndef GANG_H
+#define GANG_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#if FEATURE_GANG
+
+// Run the gang as a job sequence on the chips in spiGang (see driver.h)
+void gangRun(unsigned long address, unsigned long length);
+
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * Per-sector hash map
+ *
+ * Reads the whole chip in one pass and prints the CRC-32 (as computed by
+ * zlib) of each erase unit: 4K sectors on SPI flash, blocks on NAND and
+ * pages on EEPROMs, at least HASHMAP_MIN_UNIT bytes. A header line gives the
+ * unit count and size, then one line per unit holds its address and CRC as
+ * eight hex digits each, and a summary line follows:
+ *
+ *   Hash map: 256 units of 4096 bytes
+ *   00000000 1A2B3C4D
+ *   ...
+ *   Hash map done, 256 units in 2150 ms
+ *
+ * A backup tool compares the map with its last copy of the chip and reads
+ * only the units that changed (scripts/backup.py).
+ */
+
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_HASHMAP
+
+// Run the hash map as a job sequence
+void hashMapRun(const MemoryDevice& dev);
+
+#endif
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * Human-readable hex dump output
+ *
+ * Lines are queued in the TX ring (txring.h); each call needs
+ * HEX_DUMP_SPACE bytes free there.
+ */
+
+#ifndef HEXDUMP_H
+#define HEXDUMP_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define HEX_DUMP_SPACE  (TEXT_BUFFER_SIZE + 2)  // A formatted line and CR LF
+
+// Hex dump output state, used to fold runs of identical lines (hexdump -C style)
+struct HexDumpState {
+  unsigned long address;  // Address of the next line to be printed
+  byte lastLine[16];      // Previous full line, for duplicate detection
+  bool haveLast;          // lastLine holds a valid full line
+  bool folded;            // A '*' marker was printed for the current run
+};
+
+extern bool dumpFolding;  // Collapse identical consecutive dump lines
+
+void hexDumpBegin(HexDumpState& state, unsigned long address);
+void hexDumpLine(HexDumpState& state, const byte* data, byte len);
+void hexDumpEnd(HexDumpState& state);
+
+#endif
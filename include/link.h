@@ -0,0 +1,34 @@
+/**
+ * Serial link speed negotiation
+ *
+ * The link always comes up at SERIAL_BAUD. 'b' proposes another rate: the
+ * programmer announces the switch, changes its UART once the announcement
+ * has been sent and waits for the host to follow with the sync word "LINK".
+ * It then echoes LINK_TEST_BYTES bytes of test data back and reports their
+ * CRC-32, so the host can check both directions and time the round trip.
+ * The new rate is kept only if the host answers 'y'; anything else, or
+ * LINK_TIMEOUT_MS without progress, returns to the previous rate. A reset
+ * comes back up at SERIAL_BAUD. scripts/link.py drives the host side.
+ */
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#if FEATURE_LINK
+
+// Rate the UART runs at
+extern unsigned long linkBaud;
+
+// True if the UART can generate baud within 2.5% (U2X, 16MHz: 250000,
+// 500000, 1000000 and 2000000 are exact; 230400 and 460800 are not)
+bool linkRateSupported(unsigned long baud);
+
+// Start the switch and loopback test as a job
+void linkNegotiate(unsigned long baud);
+
+#endif
+
+#endif
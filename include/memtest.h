@@ -0,0 +1,31 @@
+/**
+ * Memory test
+ *
+ * March-style test and endurance loop over a range, for qualifying chips.
+ * Flash can only clear bits, so each cycle works on whole erase units:
+ * erase, check blank, program a pattern P, verify it, erase, check blank,
+ * program the inverse of P and verify that, so every bit is taken both
+ * ways. EEPROMs skip the erase and blank check. P is xorshift32 data seeded
+ * with the cycle number, so neighbouring cycles and addresses differ.
+ *
+ * After each cycle one line gives the erase, program and read time, the
+ * bytes that failed with the first failing address, and how far the erase
+ * and program times have drifted from the first cycle, which is how wear
+ * shows before bits start failing. A summary follows the last cycle.
+ */
+
+#ifndef MEMTEST_H
+#define MEMTEST_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_MEMTEST
+
+// Run the test as a job sequence; flash ranges must be whole erase units
+void memTestRun(const MemoryDevice& dev, unsigned long address, unsigned long length, unsigned int cycles);
+
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+/**
+ * Input line parsing
+ *
+ * Works in place on the line buffer; nothing is copied or allocated.
+ */
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <Arduino.h>
+
+// Split off the next token separated by spaces or commas; NULL at the end
+char* nextToken(char*& cursor);
+
+// Parse a whole token; false on empty input, stray characters or overflow
+bool parseHex(const char* text, unsigned long& value);  // Optional 0x prefix
+bool parseDec(const char* text, unsigned long& value);
+
+// Parse pairs of hex digits into at most maxLen bytes, up to the end of the
+// text or a '/'; returns the count, 0 on stray characters or overflow
+byte parseHexBytes(const char* text, byte* out, byte maxLen);
+
+#endif
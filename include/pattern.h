@@ -0,0 +1,52 @@
+/**
+ * Test patterns
+ *
+ * Generates fill data on the programmer, so program and read throughput can
+ * be measured, and chips burned in, without the serial link in the way.
+ * patternFill() programs a range through the write engine with a pattern as
+ * its source; patternCheck() reads the range back and compares it with the
+ * same pattern regenerated. Both report the time taken and bytes per second.
+ * The sequence depends on the start address and the seed only, so a check
+ * can run long after the fill.
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_PATTERN
+
+enum PatternKind {
+  PATTERN_CONSTANT,       // The seed's low byte everywhere
+  PATTERN_INCREMENT,      // Counts up from the seed's low byte
+  PATTERN_ADDRESS,        // Each 32-bit word holds its own address, LSB first
+  PATTERN_WALKING_ONES,   // 01 02 04 ... 80
+  PATTERN_WALKING_ZEROS,  // FE FD FB ... 7F
+  PATTERN_RANDOM,         // xorshift32 from the seed, LSB first
+  PATTERN_COUNT
+};
+
+// Print the pattern names, numbered from 1
+void printPatterns();
+
+// Select the pattern for the jobs below; invert flips every bit
+void patternSet(byte kind, uint32_t seed, bool invert);
+// Start a write engine job programming the range with the pattern
+void patternWrite(const MemoryDevice& dev, unsigned long address, unsigned long length);
+// Start a read engine job comparing the range with the pattern
+void patternRead(const MemoryDevice& dev, unsigned long address, unsigned long length);
+// Bytes that differed in the last patternRead(), and the first of them
+unsigned long patternErrors();
+unsigned long patternFirstError();
+
+// Program the range with the pattern as a job sequence
+void patternFill(const MemoryDevice& dev, unsigned long address, unsigned long length, byte kind, uint32_t seed);
+// Read the range back and count the bytes that differ from the pattern
+void patternCheck(const MemoryDevice& dev, unsigned long address, unsigned long length, byte kind, uint32_t seed);
+
+#endif
+
+#endif
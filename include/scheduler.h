@@ -0,0 +1,61 @@
+/**
+ * Cooperative task scheduler
+ *
+ * loop() calls schedulerRun(), which gives each task one short turn:
+ * - serial TX: moves queued output into the UART's buffer (txring.h)
+ * - serial RX: assembles input lines without blocking and dispatches them
+ *   to a pending prompt, or single characters to the command handler
+ * - the active memory job: one bounded step of a read/write/erase state machine,
+ *   or between jobs the next step of a job sequence
+ * - progress reporting for long-running jobs
+ *
+ * Nothing in the firmware may spin on the UART or on a chip's busy flag; a job
+ * step that has to wait simply returns and is called again on the next pass.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define PROGRESS_INTERVAL   500   // ms between progress dots
+#define TX_READY_THRESHOLD  32    // Free TX bytes before a job may queue more output
+
+// Called with each complete, non-empty input line
+typedef void (*LineHandler)(char* line);
+
+// One step of a job; returns true when the job has finished
+typedef bool (*JobStep)();
+
+// Called when a job is aborted by the user, to release the bus
+typedef void (*JobCancel)();
+
+// startJob() flags
+#define JOB_PROGRESS   0x01  // Print progress dots while the job runs
+#define JOB_RAW_INPUT  0x02  // The job reads binary data from Serial itself
+
+void schedulerInit(void (*commandHandler)(char cmd));
+void schedulerRun();
+
+// Print a prompt and route the next input line to handler
+void promptLine(const __FlashStringHelper* prompt, LineHandler handler);
+
+// Make step the active job; unless the job takes raw input, ESC or Ctrl-C
+// aborts it through cancel (may be NULL)
+void startJob(JobStep step, JobCancel cancel, byte flags);
+
+// Run a sequence of jobs: step is called whenever no job is active, starts
+// the next job (or does a short piece of work itself) and returns true when
+// the sequence has finished. ESC or Ctrl-C aborts the current job and then
+// calls cancel (may be NULL)
+void startSequence(JobStep step, JobCancel cancel);
+
+// True while a job or a sequence is running
+bool jobActive();
+
+// True when the UART can take another chunk of output without blocking and
+// nothing is waiting in the TX ring
+bool outputReady();
+
+#endif
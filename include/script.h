@@ -0,0 +1,63 @@
+/**
+ * On-device job scripts
+ *
+ * A production sequence (check the ID, unprotect, erase, program, verify,
+ * protect) is uploaded once and kept in the MCU's EEPROM. Running it
+ * executes every step back to back, without host round-trips, and reports a
+ * single summary. Steps only print when they fail; program steps request
+ * image data with ">" like the 'p' command.
+ *
+ * One step per line, numbers in hex:
+ *   id <b0> [<b1> <b2> <b3>]       Device ID must start with these bytes
+ *   status <value>                 Write the status/protection register
+ *   erase <address> <length>      Whole erase units on flash
+ *   program <address> <length>     Image streamed by the host
+ *   verify <address> <length> <crc32>
+ *   end
+ */
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+enum ScriptOp {
+  SCRIPT_ID,
+  SCRIPT_STATUS,
+  SCRIPT_ERASE,
+  SCRIPT_PROGRAM,
+  SCRIPT_VERIFY
+};
+
+// Stored in EEPROM, so fixed-width fields
+struct ScriptStep {
+  byte op;                // ScriptOp
+  uint32_t address;
+  uint32_t length;        // Byte range, or the number of ID bytes
+  uint32_t value;         // ID bytes (first in the low byte), status or CRC
+};
+
+enum ScriptLine {
+  SCRIPT_LINE_OK,
+  SCRIPT_LINE_END,
+  SCRIPT_LINE_ERROR
+};
+
+// Parse one line into step, without storing it
+ScriptLine scriptParseLine(char* line, ScriptStep& step);
+
+// Start a new upload; the stored script is invalid until it completes
+void scriptClear();
+// Parse and store one uploaded line
+ScriptLine scriptAddLine(char* line);
+// Steps of the stored script (0 if none)
+byte scriptLength();
+// Read a step of the stored script
+void scriptLoadStep(byte index, ScriptStep& step);
+
+// Run the stored script on dev as a job sequence
+void scriptRun(const MemoryDevice& dev);
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * On-device pattern search
+ *
+ * Scans a range at bus speed for up to SEARCH_MAX_PATTERNS byte patterns,
+ * each with an optional bit mask, and prints only the matches:
+ *
+ *   Match at 0x20000, pattern 1
+ *   Search done, 1 matches in 2794 ms
+ *
+ * The search is Horspool's algorithm over all patterns at once: the skip
+ * table holds, for each byte value, how far the window may move when that
+ * byte ends it, based on the shortest pattern. It lives in the TX ring's
+ * place in the arena, and the patterns in the text buffer's.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_SEARCH
+
+// Set the patterns from a line of hex tokens, each with an optional
+// "/mask" of the same length, e.g. "27051956 55AA/FF0F"; false if invalid
+bool searchSetPatterns(char* line);
+
+// Run the search as a job sequence
+void searchRun(const MemoryDevice& dev, unsigned long address, unsigned long length);
+
+#endif
+
+#endif
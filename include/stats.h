@@ -0,0 +1,48 @@
+/**
+ * Operation statistics
+ *
+ * A fixed table of per-operation counters: calls, bytes and total/min/max
+ * time in microseconds. The engines record bus transfers, status polls, the
+ * time chips stay busy and serial I/O, so each fixture shows where its time
+ * goes. Compiled out unless FEATURE_STATS is set.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum StatOp {
+  STAT_READ,     // Driver readStream() calls
+  STAT_PROGRAM,  // Driver programPage() calls (bus transfer only)
+  STAT_ERASE,    // Driver eraseRange() calls (command only)
+  STAT_POLL,     // Driver poll() calls
+  STAT_BUSY,     // Chip busy after a program or erase, until poll() ends it
+  STAT_OUTPUT,   // Formatting and queueing dump output
+  STAT_INPUT,    // Receiving image data from the host
+  STAT_COUNT
+};
+
+#if FEATURE_STATS
+
+void statsRecord(byte op, unsigned int bytes, unsigned long micros);
+
+// Print the table and start counting afresh
+void printStats();
+
+// Time a block: STATS_BEGIN(t); ...; STATS_END(STAT_READ, t, len);
+#define STATS_BEGIN(start)            unsigned long start = micros()
+#define STATS_END(op, start, bytes)   statsRecord(op, bytes, micros() - (start))
+// Store the current time in an existing variable, for intervals across steps
+#define STATS_MARK(since)             (since) = micros()
+
+#else
+
+#define STATS_BEGIN(start)
+#define STATS_END(op, start, bytes)
+#define STATS_MARK(since)
+
+#endif
+
+#endif
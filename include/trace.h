@@ -0,0 +1,45 @@
+/**
+ * Bus transaction trace
+ *
+ * A small ring of the most recent driver calls: what was done, where, how
+ * many bytes, the status returned and when it started and ended (micros()).
+ * Consecutive busy polls are folded into one entry, so a chip that
+ * stays busy costs a single slot. The 'T' command prints the ring
+ * as lines starting with "T "; scripts/trace2json.py turns a capture into a
+ * Chrome trace / Perfetto timeline. Compiled out unless FEATURE_TRACE is set.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum TraceOp {
+  TRACE_READ,
+  TRACE_PROGRAM,
+  TRACE_ERASE,
+  TRACE_POLL,    // result is the PollResult; length counts folded polls
+  TRACE_STATUS,  // Status register write; address holds the value
+  TRACE_OP_COUNT
+};
+
+#if FEATURE_TRACE
+
+void traceRecord(byte op, unsigned long start, unsigned long address, unsigned long length, byte result);
+
+// Print the ring, oldest first, and clear it
+void printTrace();
+
+// Trace a call: TRACE_START(t); ...; TRACE_END(TRACE_READ, t, addr, len, 0);
+#define TRACE_START(start)                              unsigned long start = micros()
+#define TRACE_END(op, start, address, length, result)   traceRecord(op, start, address, length, result)
+
+#else
+
+#define TRACE_START(start)
+#define TRACE_END(op, start, address, length, result)
+
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * Serial TX ring
+ *
+ * Output queued here is moved into the UART's interrupt-driven buffer a
+ * little at a time by the scheduler, so producers never wait for the link.
+ * The ring lives in the page buffers the read engine leaves free (arena.h),
+ * which makes it several lines deep: the read engine fetches the next
+ * chunk from the chip while earlier dump lines are still shifting out.
+ *
+ * Only read jobs may queue output. The scheduler holds back commands and
+ * sequence steps until the ring has drained, so the page buffers are free
+ * again before a write job starts, and direct Serial output stays in order.
+ */
+
+#ifndef TXRING_H
+#define TXRING_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Queue a block; returns false, queueing nothing, if it does not fit
+bool txRingWrite(const byte* data, unsigned int len);
+
+// Free space in bytes
+unsigned int txRingFree();
+
+// Everything queued has been handed to the UART
+bool txRingEmpty();
+
+// Drop queued output, e.g. when a job is aborted
+void txRingClear();
+
+// Move as much as the UART can take without blocking; called by the scheduler
+void txRingPump();
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * Host stand-in for the Arduino core (ATmega328P / Uno)
+ *
+ * Enough of the API for the firmware to build and run natively. Time is
+ * simulated: every call advances a virtual clock by roughly what it costs
+ * on a 16MHz AVR, so timings printed by the firmware stay meaningful.
+ * Pins and port registers follow the Uno mapping and are wired to the
+ * simulated chips (see sim.h).
+ */
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "avr/pgmspace.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+
+#define DEC  10
+#define HEX  16
+#define OCT  8
+#define BIN  2
+
+#define LSBFIRST  0
+#define MSBFIRST  1
+
+#define A0  14
+#define A1  15
+#define A2  16
+#define A3  17
+#define A4  18
+#define A5  19
+#define NUM_DIGITAL_PINS  20
+
+#define F_CPU  16000000UL
+
+#define SS    10
+#define MOSI  11
+#define MISO  12
+#define SCK   13
+#define SDA   18
+#define SCL   19
+
+#define min(a, b)               ((a) < (b) ? (a) : (b))
+#define max(a, b)               ((a) > (b) ? (a) : (b))
+#define constrain(x, lo, hi)    ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+#define lowByte(w)              ((uint8_t)((w) & 0xFF))
+#define highByte(w)             ((uint8_t)((w) >> 8))
+#define bitRead(value, bit)     (((value) >> (bit)) & 0x01)
+#define bit(b)                  (1UL << (b))
+
+#define noInterrupts()
+#define interrupts()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void setup();
+void loop();
+
+// ===== PORT REGISTERS =====
+
+enum IoPort { IO_PORTB, IO_PORTC, IO_PORTD };
+enum IoKind { IO_PIN, IO_DDR, IO_PORT };
+
+uint8_t ioRegisterRead(uint8_t port, uint8_t kind);
+void ioRegisterWrite(uint8_t port, uint8_t kind, uint8_t value);
+
+// Direct register access as used by the NAND data bus
+class IoRegister {
+ public:
+  IoRegister(uint8_t port, uint8_t kind) : port(port), kind(kind) {}
+  operator uint8_t() const { return ioRegisterRead(port, kind); }
+  IoRegister& operator=(uint8_t value) { ioRegisterWrite(port, kind, value); return *this; }
+  IoRegister& operator|=(uint8_t value) { return *this = (uint8_t)(*this | value); }
+  IoRegister& operator&=(uint8_t value) { return *this = (uint8_t)(*this & value); }
+  IoRegister& operator^=(uint8_t value) { return *this = (uint8_t)(*this ^ value); }
+
+ private:
+  IoRegister& operator=(const IoRegister&);
+  uint8_t port;
+  uint8_t kind;
+};
+
+extern IoRegister PINB, DDRB, PORTB;
+extern IoRegister PINC, DDRC, PORTC;
+extern IoRegister PIND, DDRD, PORTD;
+
+// ===== PRINT / STREAM =====
+
+class __FlashStringHelper;
+#define F(s)  (reinterpret_cast<const __FlashStringHelper*>(s))
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper* str) { return write((const char*)str); }
+  size_t print(const char* str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+  template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+// UART model: bytes move at the configured baud rate through 64-byte RX
+// and TX buffers. Input comes from stdin, output goes to stdout.
+#define SERIAL_TX_BUFFER_SIZE  64
+#define SERIAL_RX_BUFFER_SIZE  64
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud);
+  void begin(unsigned long baud, uint8_t config) { begin(baud); }
+  void end() {}
+  operator bool() { return true; }
+
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buffer, size_t size);
+  using Print::write;
+  int availableForWrite();
+  void flush();
+};
+
+extern HardwareSerial Serial;
+
+#define SERIAL_8N1  0x06
+
+#endif
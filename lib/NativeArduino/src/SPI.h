@@ -0,0 +1,50 @@
+/**
+ * Host stand-in for the Arduino SPI library
+ *
+ * Transfers go to the simulated flash whose chip select is low. Each byte
+ * takes eight SPI clocks at the configured rate (4MHz by default).
+ */
+
+#ifndef NATIVE_SPI_H
+#define NATIVE_SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE0  0x00
+#define SPI_MODE1  0x04
+#define SPI_MODE2  0x08
+#define SPI_MODE3  0x0C
+
+#define SPI_CLOCK_DIV4    0x00
+#define SPI_CLOCK_DIV16   0x01
+#define SPI_CLOCK_DIV64   0x02
+#define SPI_CLOCK_DIV128  0x03
+#define SPI_CLOCK_DIV2    0x04
+#define SPI_CLOCK_DIV8    0x05
+#define SPI_CLOCK_DIV32   0x06
+
+class SPISettings {
+ public:
+  SPISettings() : clock(4000000) {}
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : clock(clock) {}
+  uint32_t clock;
+};
+
+class SPIClass {
+ public:
+  void begin();
+  void end() {}
+  void beginTransaction(SPISettings settings);
+  void endTransaction() {}
+  void setClockDivider(uint8_t divider);
+  void setBitOrder(uint8_t order) {}
+  void setDataMode(uint8_t mode) {}
+
+  uint8_t transfer(uint8_t data);
+  uint16_t transfer16(uint16_t data);
+  void transfer(void* buffer, size_t count);
+};
+
+extern SPIClass SPI;
+
+#endif
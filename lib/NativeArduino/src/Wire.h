@@ -0,0 +1,43 @@
+/**
+ * Host stand-in for the Arduino Wire library
+ *
+ * Transactions go to the simulated 24-series EEPROM and take nine SCL
+ * periods per byte at the configured clock (100kHz by default).
+ */
+
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+#include <Arduino.h>
+
+#define BUFFER_LENGTH  32
+
+class TwoWire : public Stream {
+ public:
+  void begin();
+  void end() {}
+  void setClock(uint32_t clock);
+
+  void beginTransmission(uint8_t address);
+  void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+  uint8_t endTransmission(uint8_t sendStop = true);
+
+  uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true);
+  uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t quantity);
+  size_t write(unsigned long n) { return write((uint8_t)n); }
+  size_t write(long n) { return write((uint8_t)n); }
+  size_t write(unsigned int n) { return write((uint8_t)n); }
+  size_t write(int n) { return write((uint8_t)n); }
+  using Print::write;
+
+  int available();
+  int read();
+  int peek();
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,23 @@
+/**
+ * Host stand-in for <avr/eeprom.h>
+ *
+ * 1KB like the ATmega328P. Each byte that changes costs the 3.4ms write
+ * time in simulated time. Pass --mcu-eeprom FILE to keep it across runs.
+ */
+
+#ifndef NATIVE_EEPROM_H
+#define NATIVE_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END  0x3FF
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+void eeprom_write_byte(uint8_t* address, uint8_t value);
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+void eeprom_read_block(void* dest, const void* source, size_t len);
+void eeprom_write_block(const void* source, void* dest, size_t len);
+void eeprom_update_block(const void* source, void* dest, size_t len);
+
+#endif
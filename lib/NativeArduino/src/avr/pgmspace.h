@@ -0,0 +1,27 @@
+/**
+ * Host stand-in for <avr/pgmspace.h>: program memory is ordinary memory
+ */
+
+#ifndef NATIVE_PGMSPACE_H
+#define NATIVE_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P                 const char*
+#define PSTR(s)               (s)
+
+#define pgm_read_byte(p)      (*(const uint8_t*)(p))
+#define pgm_read_word(p)      (*(const uint16_t*)(p))
+#define pgm_read_dword(p)     (*(const uint32_t*)(p))
+#define pgm_read_ptr(p)       (*(void* const*)(p))
+
+#define memcpy_P              memcpy
+#define memcmp_P              memcmp
+#define strlen_P              strlen
+#define strcmp_P              strcmp
+#define strncmp_P             strncmp
+#define strcpy_P              strcpy
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * Native simulator internals
+ *
+ * Shared by the Arduino stand-ins and the simulated chips: the virtual
+ * clock, pin levels and the VCD recorder. The firmware never includes this.
+ */
+
+#ifndef NATIVE_SIM_H
+#define NATIVE_SIM_H
+
+#include <Arduino.h>
+
+// ===== CLOCK =====
+
+#define NS_PER_CYCLE  62.5  // 16MHz
+
+// Virtual time in nanoseconds since reset
+uint64_t simNow();
+
+// Let time pass; timers that fall due meanwhile fire at their own time
+void simAdvance(uint64_t ns);
+
+// One pending timer per slot; scheduling again replaces it
+enum SimTimer {
+  TIMER_NAND_READY,
+  TIMER_COUNT
+};
+
+void simSchedule(byte timer, uint64_t at, void (*fire)());
+
+// ===== PINS =====
+
+// Level seen on a pin: the output latch, the level a chip drives onto an
+// input, or high (pulled up) when nothing drives it
+byte simPinLevel(byte pin);
+
+// Drive an input pin from a simulated chip, or stop driving it
+void simDrive(byte pin, byte level);
+void simRelease(byte pin);
+
+// Record a pin in the VCD file under the given signal
+void simWatchPin(byte pin, byte signal);
+
+// ===== VCD =====
+
+bool vcdOpen(const char* path);
+void vcdClose();
+
+// Declare a signal before vcdBegin(); returns its handle
+byte vcdSignal(const char* scope, const char* name, byte width);
+
+// Write the header and initial values; no signals may be added afterwards
+void vcdBegin();
+
+// Record a new value at the current time
+void vcdChange(byte signal, unsigned long value);
+
+bool vcdEnabled();
+
+// ===== CHIPS =====
+
+// Called once at start-up, before vcdBegin()
+void spiFlashInit();
+void nandInit();
+void i2cEepromInit(unsigned long size);
+
+// The next write to the page holding this address leaves it all zeros
+void i2cEepromFailOnce(unsigned long address);
+
+// Pin changes (chip selects) and data bytes for the SPI flashes
+void spiFlashPinChanged(byte pin, byte level);
+byte spiFlashTransfer(byte mosi);
+
+// NAND control and data pins changed level
+void nandPinChanged(byte pin, byte level);
+
+#endif
@@ -0,0 +1,709 @@
+/**
+ * Native simulator core: clock, pins, UART, EEPROM and main()
+ *
+ * Usage: program [--vcd FILE] [--mcu-eeprom FILE] [--i2c-size BYTES]
+ *                [--idle-ms MS] [--timestamps] [--baud RATE]
+ *                [--paced] [--image FILE]
+ *
+ * The session is read from stdin at the UART's pace. Once stdin has ended
+ * and the serial link has been quiet for --idle-ms of simulated time
+ * (default 10000), the run stops and the simulated time is reported on
+ * stderr. --timestamps prefixes each output line with the simulated time
+ * in microseconds at which its first character left the UART; a paced host
+ * also logs each command line on stderr as "[time] < line", timed when its
+ * last byte arrived. --baud runs
+ * the link at RATE from the start, as if 'b' had negotiated it.
+ *
+ * By default the host waits whenever the RX buffer is full, as if the link
+ * had flow control. With --paced it behaves like the tools in scripts/
+ * instead: stdin holds only the command lines, each sent once the previous
+ * one has been taken and answered and no transfer is running, and image data (--image, the images of
+ * the whole session in order) goes out only as the programmer grants it
+ * with ">N". Nothing holds the host back beyond that, so, as with the USB
+ * bridge of a real board, bytes that arrive while the RX buffer is full
+ * are lost. Their count is reported and the exit status is then 3.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <avr/eeprom.h>
+#include "config.h"
+#include "sim.h"
+
+// Approximate costs on a 16MHz ATmega328P with the Arduino core
+#define COST_DIGITAL_WRITE_NS  3500
+#define COST_DIGITAL_READ_NS   3000
+#define COST_REGISTER_NS       125
+#define COST_TIMER_READ_NS     2000
+#define COST_SERIAL_CALL_NS    1000
+#define COST_LOOP_NS           2000   // One pass of loop() besides the calls it makes
+#define EEPROM_WRITE_NS        3400000ULL
+
+#define UART_BUFFER_SIZE  SERIAL_TX_BUFFER_SIZE
+#define RX_CAPACITY       (SERIAL_RX_BUFFER_SIZE - 1)  // The core's ring keeps one slot free
+#define HOST_TURNAROUND_NS  1000000ULL    // Paced host: USB bridge and host reply latency
+#define HOST_QUIET_NS       100000000ULL  // Paced host: silence that ends an answer
+#define HOST_GRANTS         8             // Paced host: grants queued before they merge
+#define MCU_EEPROM_SIZE   (E2END + 1)
+
+// ===== CLOCK =====
+
+static uint64_t now = 0;
+
+static struct {
+  uint64_t at;
+  void (*fire)();
+} timers[TIMER_COUNT];
+
+uint64_t simNow() {
+  return now;
+}
+
+void simSchedule(byte timer, uint64_t at, void (*fire)()) {
+  timers[timer].at = at;
+  timers[timer].fire = fire;
+}
+
+void simAdvance(uint64_t ns) {
+  uint64_t end = now + ns;
+
+  // Fire due timers in time order
+  for (;;) {
+    byte next = TIMER_COUNT;
+    for (byte i = 0; i < TIMER_COUNT; i++) {
+      if (timers[i].fire != NULL && timers[i].at <= end &&
+          (next == TIMER_COUNT || timers[i].at < timers[next].at)) {
+        next = i;
+      }
+    }
+    if (next == TIMER_COUNT) {
+      break;
+    }
+
+    void (*fire)() = timers[next].fire;
+    timers[next].fire = NULL;
+    if (timers[next].at > now) {
+      now = timers[next].at;
+    }
+    fire();
+  }
+
+  now = end;
+}
+
+unsigned long millis() {
+  simAdvance(COST_TIMER_READ_NS);
+  return now / 1000000;
+}
+
+unsigned long micros() {
+  simAdvance(COST_TIMER_READ_NS);
+  return now / 1000;
+}
+
+void delay(unsigned long ms) {
+  simAdvance(ms * 1000000ULL);
+}
+
+void delayMicroseconds(unsigned int us) {
+  simAdvance(us * 1000ULL);
+}
+
+// ===== PINS =====
+
+// Uno mapping: D0-D7 on port D, D8-D13 on port B, A0-A5 on port C
+static byte ddr[3], latch[3];
+static byte driven[3], drivenLevel[3];  // Inputs driven by a simulated chip
+static byte pinSignal[NUM_DIGITAL_PINS];
+
+static void pinLocation(byte pin, byte& port, byte& mask) {
+  if (pin < 8) {
+    port = IO_PORTD;
+    mask = 1 << pin;
+  } else if (pin < 14) {
+    port = IO_PORTB;
+    mask = 1 << (pin - 8);
+  } else {
+    port = IO_PORTC;
+    mask = 1 << (pin - 14);
+  }
+}
+
+static byte portLevels(byte port) {
+  byte inputs = ~ddr[port];
+  byte levels = ddr[port] & latch[port];
+  levels |= inputs & driven[port] & drivenLevel[port];
+  levels |= inputs & ~driven[port];  // Pulled up
+  return levels;
+}
+
+byte simPinLevel(byte pin) {
+  byte port, mask;
+  pinLocation(pin, port, mask);
+  return (portLevels(port) & mask) ? HIGH : LOW;
+}
+
+static void pinChanged(byte pin, byte level) {
+  if (pinSignal[pin] != 0) {
+    vcdChange(pinSignal[pin], level);
+  }
+  spiFlashPinChanged(pin, level);
+  nandPinChanged(pin, level);
+}
+
+// Apply a register change and report every pin whose level moved
+static void updatePort(byte port, byte& reg, byte value) {
+  byte before = portLevels(port);
+  reg = value;
+  byte changed = before ^ portLevels(port);
+
+  for (byte bitIndex = 0; bitIndex < 8 && changed != 0; bitIndex++) {
+    if (changed & (1 << bitIndex)) {
+      byte pin = (port == IO_PORTD) ? bitIndex : (port == IO_PORTB) ? bitIndex + 8 : bitIndex + 14;
+      if (pin < NUM_DIGITAL_PINS) {
+        pinChanged(pin, (before & (1 << bitIndex)) ? LOW : HIGH);
+      }
+      changed &= ~(1 << bitIndex);
+    }
+  }
+}
+
+void simDrive(byte pin, byte level) {
+  byte port, mask;
+  pinLocation(pin, port, mask);
+  drivenLevel[port] = level ? (drivenLevel[port] | mask) : (drivenLevel[port] & ~mask);
+  updatePort(port, driven[port], driven[port] | mask);
+}
+
+void simRelease(byte pin) {
+  byte port, mask;
+  pinLocation(pin, port, mask);
+  updatePort(port, driven[port], driven[port] & ~mask);
+}
+
+void simWatchPin(byte pin, byte signal) {
+  pinSignal[pin] = signal;
+  vcdChange(signal, simPinLevel(pin));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  byte port, mask;
+  pinLocation(pin, port, mask);
+  simAdvance(COST_DIGITAL_WRITE_NS);
+
+  if (mode == OUTPUT) {
+    updatePort(port, ddr[port], ddr[port] | mask);
+  } else {
+    updatePort(port, ddr[port], ddr[port] & ~mask);
+    if (mode == INPUT_PULLUP) {
+      latch[port] |= mask;
+    }
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  byte port, mask;
+  pinLocation(pin, port, mask);
+  simAdvance(COST_DIGITAL_WRITE_NS);
+  updatePort(port, latch[port], value ? (latch[port] | mask) : (latch[port] & ~mask));
+}
+
+int digitalRead(uint8_t pin) {
+  simAdvance(COST_DIGITAL_READ_NS);
+  return simPinLevel(pin);
+}
+
+uint8_t ioRegisterRead(uint8_t port, uint8_t kind) {
+  simAdvance(COST_REGISTER_NS);
+  switch (kind) {
+    case IO_PIN: return portLevels(port);
+    case IO_DDR: return ddr[port];
+    default:     return latch[port];
+  }
+}
+
+void ioRegisterWrite(uint8_t port, uint8_t kind, uint8_t value) {
+  simAdvance(COST_REGISTER_NS);
+  switch (kind) {
+    case IO_PIN:
+      // Writing PINx toggles the output latch
+      updatePort(port, latch[port], latch[port] ^ value);
+      break;
+    case IO_DDR:
+      updatePort(port, ddr[port], value);
+      break;
+    default:
+      updatePort(port, latch[port], value);
+  }
+}
+
+IoRegister PINB(IO_PORTB, IO_PIN), DDRB(IO_PORTB, IO_DDR), PORTB(IO_PORTB, IO_PORT);
+IoRegister PINC(IO_PORTC, IO_PIN), DDRC(IO_PORTC, IO_DDR), PORTC(IO_PORTC, IO_PORT);
+IoRegister PIND(IO_PORTD, IO_PIN), DDRD(IO_PORTD, IO_DDR), PORTD(IO_PORTD, IO_PORT);
+
+// ===== PRINT =====
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value, int base) {
+  if (value < 0 && base == DEC) {
+    return print('-') + print((unsigned long)-value, base);
+  }
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char digits[8 * sizeof(value) + 1];
+  char* p = &digits[sizeof(digits) - 1];
+  *p = '\0';
+
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    byte digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value != 0);
+
+  return write(p);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[40];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+// ===== UART =====
+
+// Session input from stdin; bytes enter the RX buffer at the line rate
+static byte hostInput[4096];
+static size_t hostInputLength = 0, hostInputPos = 0;
+static bool inputEnded = false;
+
+static byte rxBuffer[SERIAL_RX_BUFFER_SIZE];
+static byte rxHead = 0, rxCount = 0;
+static uint64_t rxNextArrival = 0;
+static unsigned long rxDropped = 0;
+
+static uint64_t byteTime = 10 * 1000000000ULL / 9600;
+static bool baudFixed = false;
+static uint64_t txBusyUntil = 0;  // The TX buffer has drained by then
+static uint64_t lastTraffic = 0;
+static bool timestamps = false;
+static bool lineStart = true;
+
+// Paced host (--paced): what it has been granted and whether its last
+// command line has been taken and answered
+static struct {
+  bool enabled;
+  byte* image;
+  size_t imageLength, imagePos;
+  struct {
+    unsigned long bytes;   // Image bytes granted and not yet sent
+    uint64_t start;        // They may leave the host from then on
+  } grants[HOST_GRANTS];
+  byte grantHead, grantCount;
+  bool transfer;           // Image transfer running: command lines wait
+  bool linePending;        // A command line sent, not yet all read
+  uint64_t lineTaken;      // When the programmer read its last byte
+  uint64_t outputEnd;      // Last output byte has reached the host then
+  char line[8];            // Start of the output line being written
+  byte lineLength;
+  char sent[32];           // Start of the command line being sent
+  byte sentLength;
+} host;
+
+static void readHostInput() {
+  if (hostInputPos < hostInputLength || inputEnded) {
+    return;
+  }
+
+  ssize_t count = ::read(STDIN_FILENO, hostInput, sizeof(hostInput));
+  if (count > 0) {
+    hostInputLength = count;
+    hostInputPos = 0;
+  } else if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+    inputEnded = true;
+  }
+}
+
+// Next byte the host would send and the earliest time it leaves; false if
+// the host has nothing to send yet
+static bool hostNext(byte& c, uint64_t& departure) {
+  if (host.enabled && host.grantCount > 0 && host.imagePos < host.imageLength) {
+    c = host.image[host.imagePos];
+    departure = host.grants[host.grantHead].start;
+    return true;
+  }
+
+  // Command lines wait for the answer to the previous one
+  if (host.enabled && (host.transfer || host.linePending)) {
+    return false;
+  }
+  readHostInput();
+  if (hostInputPos == hostInputLength) {
+    return false;
+  }
+
+  c = hostInput[hostInputPos];
+  departure = 0;
+  if (host.enabled) {
+    departure = (host.lineTaken > host.outputEnd ? host.lineTaken : host.outputEnd) + HOST_QUIET_NS;
+  }
+  return true;
+}
+
+static void hostTake(byte c, uint64_t arrival) {
+  if (host.enabled && host.grantCount > 0 && host.imagePos < host.imageLength) {
+    host.imagePos++;
+    if (--host.grants[host.grantHead].bytes == 0) {
+      host.grantHead = (host.grantHead + 1) % HOST_GRANTS;
+      host.grantCount--;
+    }
+    return;
+  }
+
+  hostInputPos++;
+  if (c != '\n') {
+    if (c != '\r' && host.sentLength < sizeof(host.sent) - 1) {
+      host.sent[host.sentLength++] = c;
+    }
+    return;
+  }
+
+  host.linePending = true;
+  if (host.enabled && timestamps) {
+    host.sent[host.sentLength] = '\0';
+    fprintf(stderr, "[%llu] < %s\n", (unsigned long long)(arrival / 1000), host.sent);
+  }
+  host.sentLength = 0;
+}
+
+// Paced host: a transfer starts with "Send N bytes" or a grant line and
+// ends with any other line; grants are queued
+static void hostSees(byte c) {
+  if (c == '\r') {
+    return;
+  }
+  if (c != '\n') {
+    if (host.lineLength < sizeof(host.line) - 1) {
+      host.line[host.lineLength++] = c;
+    }
+    return;
+  }
+
+  host.line[host.lineLength] = '\0';
+  host.transfer = host.line[0] == '>' || strncmp(host.line, "Send ", 5) == 0;
+  unsigned long bytes = host.line[0] == '>' ? strtoul(host.line + 1, NULL, 10) : 0;
+  if (bytes > 0) {
+    // A full queue adds to the newest grant
+    if (host.grantCount == HOST_GRANTS) {
+      host.grantCount--;
+      bytes += host.grants[(host.grantHead + host.grantCount) % HOST_GRANTS].bytes;
+    }
+    byte tail = (host.grantHead + host.grantCount++) % HOST_GRANTS;
+    host.grants[tail].bytes = bytes;
+    host.grants[tail].start = txBusyUntil + HOST_TURNAROUND_NS;
+  }
+  host.lineLength = 0;
+}
+
+// Move input that has arrived by now into the RX buffer
+static void receive() {
+  for (;;) {
+    if (!host.enabled && rxCount == RX_CAPACITY) {
+      // The host waits for room (flow control)
+      if (rxNextArrival < now) {
+        rxNextArrival = now;
+      }
+      return;
+    }
+
+    byte c;
+    uint64_t departure;
+    if (!hostNext(c, departure)) {
+      if (rxNextArrival < now) {
+        rxNextArrival = now;
+      }
+      return;
+    }
+
+    uint64_t arrival = (rxNextArrival > departure ? rxNextArrival : departure) + byteTime;
+    if (arrival > now) {
+      return;
+    }
+
+    hostTake(c, arrival);
+    rxNextArrival = arrival;
+    lastTraffic = arrival;
+    if (rxCount == RX_CAPACITY) {
+      rxDropped++;
+      continue;
+    }
+    rxBuffer[(rxHead + rxCount) % SERIAL_RX_BUFFER_SIZE] = c;
+    rxCount++;
+  }
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  if (!baudFixed) {
+    byteTime = 10 * 1000000000ULL / baud;
+  }
+}
+
+int HardwareSerial::available() {
+  simAdvance(COST_SERIAL_CALL_NS);
+  receive();
+  return rxCount;
+}
+
+int HardwareSerial::peek() {
+  simAdvance(COST_SERIAL_CALL_NS);
+  receive();
+  return rxCount ? rxBuffer[rxHead] : -1;
+}
+
+int HardwareSerial::read() {
+  simAdvance(COST_SERIAL_CALL_NS);
+  receive();
+  if (rxCount == 0) {
+    return -1;
+  }
+
+  byte c = rxBuffer[rxHead];
+  rxHead = (rxHead + 1) % SERIAL_RX_BUFFER_SIZE;
+  rxCount--;
+  if (rxCount == 0 && host.linePending) {
+    host.linePending = false;
+    host.lineTaken = now;
+  }
+  return c;
+}
+
+int HardwareSerial::availableForWrite() {
+  simAdvance(COST_SERIAL_CALL_NS);
+  if (txBusyUntil <= now) {
+    return UART_BUFFER_SIZE - 1;
+  }
+
+  uint64_t queued = (txBusyUntil - now + byteTime - 1) / byteTime;
+  return queued >= UART_BUFFER_SIZE - 1 ? 0 : UART_BUFFER_SIZE - 1 - queued;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  // Block while the TX buffer is full, as the Arduino core does
+  while (availableForWrite() == 0) {
+    simAdvance(txBusyUntil - now - (UART_BUFFER_SIZE - 2) * byteTime);
+  }
+
+  txBusyUntil = (txBusyUntil > now ? txBusyUntil : now) + byteTime;
+  lastTraffic = txBusyUntil;
+
+  if (timestamps && lineStart) {
+    printf("[%llu] ", (unsigned long long)(txBusyUntil / 1000));
+  }
+  lineStart = (c == '\n');
+
+  if (host.enabled) {
+    // Input due by now arrives before the host sees this
+    receive();
+    host.outputEnd = txBusyUntil;
+    hostSees(c);
+  }
+
+  putchar(c);
+  if (c == '\n') {
+    fflush(stdout);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  return Print::write(buffer, size);
+}
+
+void HardwareSerial::flush() {
+  if (txBusyUntil > now) {
+    simAdvance(txBusyUntil - now);
+  }
+  fflush(stdout);
+}
+
+HardwareSerial Serial;
+
+// ===== EEPROM =====
+
+static uint8_t mcuEeprom[MCU_EEPROM_SIZE];
+
+uint8_t eeprom_read_byte(const uint8_t* address) {
+  simAdvance(4 * NS_PER_CYCLE);
+  return mcuEeprom[(size_t)address % MCU_EEPROM_SIZE];
+}
+
+void eeprom_write_byte(uint8_t* address, uint8_t value) {
+  simAdvance(EEPROM_WRITE_NS);
+  mcuEeprom[(size_t)address % MCU_EEPROM_SIZE] = value;
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value) {
+  if (eeprom_read_byte(address) != value) {
+    eeprom_write_byte(address, value);
+  }
+}
+
+void eeprom_read_block(void* dest, const void* source, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    ((uint8_t*)dest)[i] = eeprom_read_byte((const uint8_t*)source + i);
+  }
+}
+
+void eeprom_write_block(const void* source, void* dest, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    eeprom_write_byte((uint8_t*)dest + i, ((const uint8_t*)source)[i]);
+  }
+}
+
+void eeprom_update_block(const void* source, void* dest, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    eeprom_update_byte((uint8_t*)dest + i, ((const uint8_t*)source)[i]);
+  }
+}
+
+static void loadEeprom(const char* path) {
+  memset(mcuEeprom, 0xFF, sizeof(mcuEeprom));
+  FILE* f = path ? fopen(path, "rb") : NULL;
+  if (f != NULL) {
+    size_t ignored = fread(mcuEeprom, 1, sizeof(mcuEeprom), f);
+    (void)ignored;
+    fclose(f);
+  }
+}
+
+static bool loadImage(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+
+  fseek(f, 0, SEEK_END);
+  host.imageLength = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  host.image = (byte*) malloc(host.imageLength + 1);
+  bool complete = fread(host.image, 1, host.imageLength, f) == host.imageLength;
+  fclose(f);
+  return complete;
+}
+
+static void saveEeprom(const char* path) {
+  FILE* f = path ? fopen(path, "wb") : NULL;
+  if (f != NULL) {
+    fwrite(mcuEeprom, 1, sizeof(mcuEeprom), f);
+    fclose(f);
+  }
+}
+
+// ===== MAIN =====
+
+static void usage(const char* program) {
+  fprintf(stderr, "Usage: %s [--vcd FILE] [--mcu-eeprom FILE] [--i2c-size BYTES] [--idle-ms MS] [--timestamps]\n"
+                  "       [--baud RATE] [--paced] [--image FILE] [--i2c-fail ADDRESS]\n", program);
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  const char* vcdPath = NULL;
+  const char* eepromPath = NULL;
+  const char* imagePath = NULL;
+  unsigned long i2cSize = 32768;
+  long i2cFail = -1;
+  uint64_t idleNs = 10000 * 1000000ULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--timestamps") == 0) {
+      timestamps = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--paced") == 0) {
+      host.enabled = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      usage(argv[0]);
+    }
+    if (strcmp(argv[i], "--vcd") == 0) {
+      vcdPath = argv[++i];
+    } else if (strcmp(argv[i], "--mcu-eeprom") == 0) {
+      eepromPath = argv[++i];
+    } else if (strcmp(argv[i], "--i2c-size") == 0) {
+      i2cSize = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--i2c-fail") == 0) {
+      i2cFail = strtol(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--idle-ms") == 0) {
+      idleNs = strtoull(argv[++i], NULL, 0) * 1000000ULL;
+    } else if (strcmp(argv[i], "--baud") == 0) {
+      byteTime = 10 * 1000000000ULL / strtoul(argv[++i], NULL, 0);
+      baudFixed = true;
+    } else if (strcmp(argv[i], "--image") == 0) {
+      imagePath = argv[++i];
+      host.enabled = true;
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  if (vcdPath != NULL && !vcdOpen(vcdPath)) {
+    fprintf(stderr, "Cannot write %s\n", vcdPath);
+    return 1;
+  }
+
+  if (imagePath != NULL && !loadImage(imagePath)) {
+    fprintf(stderr, "Cannot read %s\n", imagePath);
+    return 1;
+  }
+
+  fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+  loadEeprom(eepromPath);
+
+  spiFlashInit();
+  nandInit();
+  i2cEepromInit(i2cSize);
+  if (i2cFail >= 0) {
+    i2cEepromFailOnce(i2cFail);
+  }
+  vcdBegin();
+
+  setup();
+  for (;;) {
+    loop();
+    simAdvance(COST_LOOP_NS);
+
+    // Stop once the session has been sent and the link has gone quiet
+    if (inputEnded && hostInputPos == hostInputLength && rxCount == 0 &&
+        now > txBusyUntil && now - lastTraffic > idleNs) {
+      break;
+    }
+  }
+
+  fflush(stdout);
+  vcdClose();
+  saveEeprom(eepromPath);
+  fprintf(stderr, "Simulated time: %.6f s\n", lastTraffic / 1e9);
+  if (host.imagePos < host.imageLength) {
+    fprintf(stderr, "Image: %zu of %zu bytes sent\n", host.imagePos, host.imageLength);
+  }
+  if (rxDropped > 0) {
+    fprintf(stderr, "RX overflow: %lu bytes dropped\n", rxDropped);
+    return 3;
+  }
+  return 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * Simulated parallel NAND flash
+ *
+ * Follows the firmware's wiring (config.h) at pin level: commands, address
+ * and data are latched on the rising edge of WE#, output bytes are driven
+ * onto D2-D9 while RE# is low and R/B# is low while the chip is busy. The
+ * array is 32MB of 512-byte pages in 16KB blocks (ID EC 75), addressed with
+ * two column and three row cycles like the driver sends.
+ */
+
+#include "config.h"
+#include "sim.h"
+
+#define NAND_SIZE        (32UL * 1024 * 1024)
+#define NAND_PAGE        512
+#define NAND_BLOCK       (16UL * 1024)
+
+#define READ_NS          12000ULL     // tR
+#define PROGRAM_NS       200000ULL    // tPROG
+#define ERASE_NS         2000000ULL   // tBERS
+#define RESET_NS         5000ULL      // tRST
+
+// Data bus: bits 0-7 on pins D2-D9
+#define DATA_PIN(bitIndex)  (2 + (bitIndex))
+
+enum NandOutput {
+  OUT_NONE,
+  OUT_ID,
+  OUT_STATUS,
+  OUT_DATA
+};
+
+static byte* array;
+static byte pageRegister[NAND_PAGE];
+
+static byte command = 0;
+static byte addressBytes[5];
+static byte addressCount = 0;
+static unsigned int column = 0;
+static byte output = OUT_NONE;
+static byte idIndex = 0;
+static bool busy = false;
+static bool failed = false;
+
+static byte sigCE, sigCLE, sigALE, sigWE, sigRE, sigRB, sigIO;
+
+static const byte nandID[] = { 0xEC, 0x75, 0xA5, 0xBD, 0x00 };
+
+static byte dataBus() {
+  byte value = 0;
+  for (byte i = 0; i < 8; i++) {
+    if (simPinLevel(DATA_PIN(i))) {
+      value |= 1 << i;
+    }
+  }
+  return value;
+}
+
+static void ready() {
+  busy = false;
+  simDrive(NAND_RB_PIN, HIGH);
+}
+
+static void startBusy(uint64_t duration) {
+  busy = true;
+  simDrive(NAND_RB_PIN, LOW);
+  simSchedule(TIMER_NAND_READY, simNow() + duration, ready);
+}
+
+static unsigned long rowAddress(byte first) {
+  unsigned long row = addressBytes[first] | ((unsigned long)addressBytes[first + 1] << 8) |
+                      ((unsigned long)addressBytes[first + 2] << 16);
+  return row % (NAND_SIZE / NAND_PAGE);
+}
+
+static void latchCommand(byte value) {
+  if (busy && value != 0x70 && value != 0xFF) {
+    return;
+  }
+
+  switch (value) {
+    case 0xFF:  // Reset
+      output = OUT_NONE;
+      startBusy(RESET_NS);
+      break;
+    case 0x90:  // Read ID
+    case 0x00:  // Read
+    case 0x60:  // Block erase
+      addressCount = 0;
+      output = OUT_NONE;
+      break;
+    case 0x80:  // Program: the register starts out blank
+      addressCount = 0;
+      output = OUT_NONE;
+      memset(pageRegister, 0xFF, sizeof(pageRegister));
+      break;
+    case 0x70:
+      output = OUT_STATUS;
+      break;
+    case 0x30:  // Read confirm
+      if (command == 0x00 && addressCount == 5) {
+        memcpy(pageRegister, array + rowAddress(2) * NAND_PAGE, NAND_PAGE);
+        column = (addressBytes[0] | (addressBytes[1] << 8)) % NAND_PAGE;
+        output = OUT_DATA;
+        startBusy(READ_NS);
+      }
+      break;
+    case 0x10:  // Program confirm
+      if (command == 0x80 && addressCount == 5) {
+        byte* page = array + rowAddress(2) * NAND_PAGE;
+        for (unsigned int i = 0; i < NAND_PAGE; i++) {
+          page[i] &= pageRegister[i];
+        }
+        failed = false;
+        startBusy(PROGRAM_NS);
+      }
+      break;
+    case 0xD0:  // Erase confirm
+      if (command == 0x60 && addressCount == 3) {
+        unsigned long block = rowAddress(0) * NAND_PAGE / NAND_BLOCK;
+        memset(array + block * NAND_BLOCK, 0xFF, NAND_BLOCK);
+        failed = false;
+        startBusy(ERASE_NS);
+      }
+      break;
+  }
+  command = value;
+}
+
+static void latchAddress(byte value) {
+  if (addressCount < sizeof(addressBytes)) {
+    addressBytes[addressCount++] = value;
+  }
+  if (command == 0x90) {
+    output = OUT_ID;
+    idIndex = 0;
+  } else if (command == 0x80 && addressCount == 2) {
+    column = (addressBytes[0] | (addressBytes[1] << 8)) % NAND_PAGE;
+  }
+}
+
+static void latchData(byte value) {
+  if (command == 0x80 && addressCount == 5 && column < NAND_PAGE) {
+    pageRegister[column++] = value;
+  }
+}
+
+static byte nextOutput() {
+  switch (output) {
+    case OUT_ID:
+      return idIndex < sizeof(nandID) ? nandID[idIndex++] : 0x00;
+    case OUT_STATUS:
+      // Not write protected, ready flag, pass/fail
+      return 0x80 | (busy ? 0x00 : 0x40) | (failed ? 0x01 : 0x00);
+    case OUT_DATA:
+      if (busy) {
+        return 0xFF;
+      }
+      return column < NAND_PAGE ? pageRegister[column++] : 0xFF;
+  }
+  return 0xFF;
+}
+
+void nandInit() {
+  array = (byte*)malloc(NAND_SIZE);
+  memset(array, 0xFF, NAND_SIZE);
+
+  sigCE = vcdSignal("nand", "ce_n", 1);
+  sigCLE = vcdSignal("nand", "cle", 1);
+  sigALE = vcdSignal("nand", "ale", 1);
+  sigWE = vcdSignal("nand", "we_n", 1);
+  sigRE = vcdSignal("nand", "re_n", 1);
+  sigRB = vcdSignal("nand", "rb_n", 1);
+  sigIO = vcdSignal("nand", "io", 8);
+
+  simDrive(NAND_RB_PIN, HIGH);
+  vcdChange(sigIO, dataBus());
+  simWatchPin(NAND_CE_PIN, sigCE);
+  simWatchPin(NAND_CLE_PIN, sigCLE);
+  simWatchPin(NAND_ALE_PIN, sigALE);
+  simWatchPin(NAND_WE_PIN, sigWE);
+  simWatchPin(NAND_RE_PIN, sigRE);
+  simWatchPin(NAND_RB_PIN, sigRB);
+}
+
+void nandPinChanged(byte pin, byte level) {
+  if (pin >= DATA_PIN(0) && pin <= DATA_PIN(7)) {
+    vcdChange(sigIO, dataBus());
+    return;
+  }
+
+  bool enabled = simPinLevel(NAND_CE_PIN) == LOW;
+
+  if (pin == NAND_WE_PIN && level == HIGH && enabled) {
+    byte value = dataBus();
+    if (simPinLevel(NAND_CLE_PIN)) {
+      latchCommand(value);
+    } else if (simPinLevel(NAND_ALE_PIN)) {
+      latchAddress(value);
+    } else {
+      latchData(value);
+    }
+  } else if (pin == NAND_RE_PIN) {
+    if (level == LOW && enabled) {
+      byte value = nextOutput();
+      for (byte i = 0; i < 8; i++) {
+        simDrive(DATA_PIN(i), (value >> i) & 1);
+      }
+    } else {
+      for (byte i = 0; i < 8; i++) {
+        simRelease(DATA_PIN(i));
+      }
+    }
+  }
+}
@@ -0,0 +1,285 @@
+/**
+ * SPI stand-in and simulated 25-series SPI NOR flash
+ *
+ * Two flashes, on CS pins 10 and 9, behave like a 1MB Winbond W25Q80
+ * (JEDEC ID EF 40 14) with typical datasheet timings. Any block protection
+ * bit write-protects the whole array.
+ */
+
+#include "config.h"
+#include "sim.h"
+#include <SPI.h>
+
+#define FLASH_SIZE       (1UL << 20)
+#define FLASH_PAGE_SIZE  256
+
+#define PAGE_PROGRAM_NS   700000ULL        // tPP
+#define SECTOR_ERASE_NS   45000000ULL      // tSE, 4KB
+#define BLOCK32_ERASE_NS  120000000ULL     // tBE1
+#define BLOCK64_ERASE_NS  150000000ULL     // tBE2
+#define CHIP_ERASE_NS     2000000000ULL    // tCE
+#define STATUS_WRITE_NS   10000000ULL      // tW
+
+#define SPI_BYTE_OVERHEAD_NS  (10 * NS_PER_CYCLE)  // Load SPDR, wait for SPIF
+
+#define STATUS_WIP  0x01
+#define STATUS_WEL  0x02
+#define STATUS_BP   0x3C
+
+// Second chip for clone and gang tests; its CS doubles as NAND data bit 7,
+// so the firmware only accepts it in builds without NAND
+#define FLASH_COUNT      2
+static const byte flashPins[FLASH_COUNT] = { SPI_CS_PIN, 9 };
+
+struct SpiFlash {
+  byte* data;
+  byte status;
+  uint64_t busyUntil;
+
+  // Command in progress while CS is low
+  bool selected;
+  byte command;
+  unsigned int phase;  // Bytes received since CS fell
+  unsigned long address;
+  byte pageBuffer[FLASH_PAGE_SIZE];
+  bool pageTouched[FLASH_PAGE_SIZE];
+};
+
+static SpiFlash flashes[FLASH_COUNT];
+
+static uint32_t spiClock = 4000000;
+static byte sigSCK, sigMOSI, sigMISO, sigMosiByte, sigMisoByte;
+
+void spiFlashInit() {
+  static const char* const csNames[FLASH_COUNT] = { "cs_n", "cs2_n" };
+
+  for (byte i = 0; i < FLASH_COUNT; i++) {
+    flashes[i].data = (byte*)malloc(FLASH_SIZE);
+    memset(flashes[i].data, 0xFF, FLASH_SIZE);
+    simWatchPin(flashPins[i], vcdSignal("spi", csNames[i], 1));
+  }
+
+  sigSCK = vcdSignal("spi", "sck", 1);
+  sigMOSI = vcdSignal("spi", "mosi", 1);
+  sigMISO = vcdSignal("spi", "miso", 1);
+  sigMosiByte = vcdSignal("spi", "mosi_byte", 8);
+  sigMisoByte = vcdSignal("spi", "miso_byte", 8);
+}
+
+static bool flashBusy(SpiFlash& f) {
+  if (f.busyUntil > simNow()) {
+    return true;
+  }
+  f.status &= ~STATUS_WIP;
+  return false;
+}
+
+static void startBusy(SpiFlash& f, uint64_t duration) {
+  f.busyUntil = simNow() + duration;
+  f.status |= STATUS_WIP;
+  f.status &= ~STATUS_WEL;
+}
+
+static void eraseRange(SpiFlash& f, unsigned long start, unsigned long length) {
+  start &= ~(length - 1);
+  memset(f.data + (start % FLASH_SIZE), 0xFF, length);
+}
+
+// Complete a write command when CS rises
+static void finishCommand(SpiFlash& f) {
+  if (flashBusy(f) || !(f.status & STATUS_WEL)) {
+    return;
+  }
+
+  bool writable = !(f.status & STATUS_BP);
+  switch (f.command) {
+    case 0x02:  // Page program
+      if (f.phase <= 4) {
+        return;
+      }
+      if (writable) {
+        unsigned long page = (f.address % FLASH_SIZE) & ~(FLASH_PAGE_SIZE - 1UL);
+        for (unsigned int i = 0; i < FLASH_PAGE_SIZE; i++) {
+          if (f.pageTouched[i]) {
+            f.data[page + i] &= f.pageBuffer[i];
+          }
+        }
+      }
+      startBusy(f, PAGE_PROGRAM_NS);
+      break;
+    case 0x20:
+    case 0x52:
+    case 0xD8:
+      if (f.phase != 4) {
+        return;
+      }
+      if (writable) {
+        eraseRange(f, f.address, f.command == 0x20 ? 4096 : f.command == 0x52 ? 32768 : 65536);
+      }
+      startBusy(f, f.command == 0x20 ? SECTOR_ERASE_NS : f.command == 0x52 ? BLOCK32_ERASE_NS : BLOCK64_ERASE_NS);
+      break;
+    case 0xC7:
+    case 0x60:
+      if (writable) {
+        memset(f.data, 0xFF, FLASH_SIZE);
+      }
+      startBusy(f, CHIP_ERASE_NS);
+      break;
+    case 0x01:  // Write status register
+      if (f.phase >= 2) {
+        f.status = (f.status & (STATUS_WIP | STATUS_WEL)) | (f.pageBuffer[0] & 0xFC);
+        startBusy(f, STATUS_WRITE_NS);
+      }
+      break;
+  }
+}
+
+static void select(SpiFlash& f, bool nowSelected) {
+  if (nowSelected && !f.selected) {
+    f.phase = 0;
+    f.address = 0;
+  } else if (!nowSelected && f.selected && f.phase > 0) {
+    if (f.command == 0x06 && !flashBusy(f)) {
+      f.status |= STATUS_WEL;
+    } else if (f.command == 0x04 && !flashBusy(f)) {
+      f.status &= ~STATUS_WEL;
+    } else {
+      finishCommand(f);
+    }
+  }
+  f.selected = nowSelected;
+}
+
+void spiFlashPinChanged(byte pin, byte level) {
+  for (byte i = 0; i < FLASH_COUNT; i++) {
+    if (flashPins[i] == pin) {
+      select(flashes[i], level == LOW);
+    }
+  }
+}
+
+static byte transfer(SpiFlash& f, byte mosi) {
+  unsigned int index = f.phase++;
+  if (index == 0) {
+    f.command = mosi;
+    if (f.command == 0x02 || f.command == 0x01) {
+      memset(f.pageTouched, 0, sizeof(f.pageTouched));
+    }
+    return 0xFF;
+  }
+
+  // Only the status register can be read during a program or erase
+  if (f.command == 0x05) {
+    flashBusy(f);
+    return f.status;
+  }
+  if (flashBusy(f)) {
+    return 0xFF;
+  }
+
+  switch (f.command) {
+    case 0x9F: {
+      static const byte id[] = { 0xEF, 0x40, 0x14 };
+      return index <= 3 ? id[index - 1] : 0xFF;
+    }
+    case 0x01:
+      if (index == 1) {
+        f.pageBuffer[0] = mosi;
+      }
+      return 0xFF;
+    case 0x03:
+    case 0x0B:
+    case 0x02:
+    case 0x20:
+    case 0x52:
+    case 0xD8:
+      if (index <= 3) {
+        f.address = (f.address << 8) | mosi;
+        return 0xFF;
+      }
+      if (f.command == 0x0B && index == 4) {
+        return 0xFF;  // Dummy byte
+      }
+      if (f.command == 0x02) {
+        // Data wraps within the page
+        unsigned int column = (f.address + index - 4) % FLASH_PAGE_SIZE;
+        f.pageBuffer[column] = mosi;
+        f.pageTouched[column] = true;
+        return 0xFF;
+      }
+      if (f.command == 0x03 || f.command == 0x0B) {
+        return f.data[f.address++ % FLASH_SIZE];
+      }
+      return 0xFF;
+  }
+  return 0xFF;
+}
+
+// Every selected chip sees MOSI; chips answering at once pull MISO low together
+byte spiFlashTransfer(byte mosi) {
+  byte miso = 0xFF;
+  for (byte i = 0; i < FLASH_COUNT; i++) {
+    if (flashes[i].selected) {
+      miso &= transfer(flashes[i], mosi);
+    }
+  }
+  return miso;
+}
+
+// ===== SPI LIBRARY =====
+
+SPIClass SPI;
+
+void SPIClass::begin() {
+  pinMode(SS, OUTPUT);
+  pinMode(SCK, OUTPUT);
+  pinMode(MOSI, OUTPUT);
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+  spiClock = min(settings.clock, (uint32_t)8000000);
+}
+
+void SPIClass::setClockDivider(uint8_t divider) {
+  static const byte dividers[] = { 4, 16, 64, 128, 2, 8, 32, 64 };
+  spiClock = 16000000 / dividers[divider & 0x07];
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  uint64_t halfPeriod = 500000000ULL / spiClock;
+  simAdvance(SPI_BYTE_OVERHEAD_NS);
+
+  byte miso = spiFlashTransfer(data);
+
+  if (!vcdEnabled()) {
+    simAdvance(16 * halfPeriod);
+    return miso;
+  }
+
+  // Mode 0, MSB first: data changes while SCK is low
+  vcdChange(sigMosiByte, data);
+  vcdChange(sigMisoByte, miso);
+  for (int bitIndex = 7; bitIndex >= 0; bitIndex--) {
+    vcdChange(sigSCK, LOW);
+    vcdChange(sigMOSI, (data >> bitIndex) & 1);
+    vcdChange(sigMISO, (miso >> bitIndex) & 1);
+    simAdvance(halfPeriod);
+    vcdChange(sigSCK, HIGH);
+    simAdvance(halfPeriod);
+  }
+  vcdChange(sigSCK, LOW);
+  return miso;
+}
+
+uint16_t SPIClass::transfer16(uint16_t data) {
+  uint16_t high = transfer(data >> 8);
+  return (high << 8) | transfer(data & 0xFF);
+}
+
+void SPIClass::transfer(void* buffer, size_t count) {
+  byte* p = (byte*)buffer;
+  while (count--) {
+    *p = transfer(*p);
+    p++;
+  }
+}
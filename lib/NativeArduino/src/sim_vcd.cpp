@@ -0,0 +1,132 @@
+/**
+ * VCD recorder for the native simulator
+ *
+ * Writes a Value Change Dump (IEEE 1364) with 1ns resolution that GTKWave
+ * and PulseView open directly. Signals are grouped in one scope per bus.
+ */
+
+#include <stdio.h>
+#include "sim.h"
+
+#define VCD_MAX_SIGNALS  32
+
+struct VcdSignal {
+  const char* scope;
+  const char* name;
+  byte width;
+  unsigned long value;
+};
+
+static FILE* vcd = NULL;
+static VcdSignal signals[VCD_MAX_SIGNALS + 1];  // Handle 0 means "not recorded"
+static byte signalCount = 0;
+static uint64_t lastTime = 0;
+static bool started = false;
+
+bool vcdOpen(const char* path) {
+  vcd = fopen(path, "w");
+  return vcd != NULL;
+}
+
+bool vcdEnabled() {
+  return vcd != NULL && started;
+}
+
+byte vcdSignal(const char* scope, const char* name, byte width) {
+  if (started || signalCount == VCD_MAX_SIGNALS) {
+    return 0;
+  }
+
+  VcdSignal& s = signals[++signalCount];
+  s.scope = scope;
+  s.name = name;
+  s.width = width;
+  s.value = 0;
+  return signalCount;
+}
+
+static void writeValue(byte handle) {
+  const VcdSignal& s = signals[handle];
+  char id = '!' + handle;
+
+  if (s.width == 1) {
+    fprintf(vcd, "%c%c\n", s.value ? '1' : '0', id);
+    return;
+  }
+
+  fputc('b', vcd);
+  for (int bitIndex = s.width - 1; bitIndex >= 0; bitIndex--) {
+    fputc((s.value >> bitIndex) & 1 ? '1' : '0', vcd);
+  }
+  fprintf(vcd, " %c\n", id);
+}
+
+void vcdBegin() {
+  started = true;
+  if (vcd == NULL) {
+    return;
+  }
+
+  fprintf(vcd, "$version UniHardPro native build $end\n");
+  fprintf(vcd, "$timescale 1ns $end\n");
+
+  // Signals were declared scope by scope
+  const char* scope = NULL;
+  for (byte i = 1; i <= signalCount; i++) {
+    const VcdSignal& s = signals[i];
+    if (scope == NULL || strcmp(scope, s.scope) != 0) {
+      if (scope != NULL) {
+        fprintf(vcd, "$upscope $end\n");
+      }
+      scope = s.scope;
+      fprintf(vcd, "$scope module %s $end\n", scope);
+    }
+    if (s.width == 1) {
+      fprintf(vcd, "$var wire 1 %c %s $end\n", '!' + i, s.name);
+    } else {
+      fprintf(vcd, "$var wire %d %c %s [%d:0] $end\n", s.width, '!' + i, s.name, s.width - 1);
+    }
+  }
+  if (scope != NULL) {
+    fprintf(vcd, "$upscope $end\n");
+  }
+  fprintf(vcd, "$enddefinitions $end\n");
+
+  fprintf(vcd, "#%llu\n$dumpvars\n", (unsigned long long)simNow());
+  for (byte i = 1; i <= signalCount; i++) {
+    writeValue(i);
+  }
+  fprintf(vcd, "$end\n");
+  lastTime = simNow();
+}
+
+void vcdChange(byte handle, unsigned long value) {
+  if (handle == 0) {
+    return;
+  }
+
+  VcdSignal& s = signals[handle];
+  if (s.value == value) {
+    return;
+  }
+  s.value = value;
+
+  // Before vcdBegin() this only sets the initial value
+  if (vcd == NULL || !started) {
+    return;
+  }
+
+  if (simNow() != lastTime) {
+    lastTime = simNow();
+    fprintf(vcd, "#%llu\n", (unsigned long long)lastTime);
+  }
+  writeValue(handle);
+}
+
+void vcdClose() {
+  if (vcd != NULL) {
+    fprintf(vcd, "#%llu\n", (unsigned long long)simNow());
+    fclose(vcd);
+    vcd = NULL;
+  }
+}
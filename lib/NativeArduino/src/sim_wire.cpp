@@ -0,0 +1,249 @@
+/**
+ * Wire stand-in and simulated 24-series I2C EEPROM
+ *
+ * The EEPROM answers at 0x50 with its address pins low. Parts up to 2KB
+ * take one address byte and use the low device address bits as the high
+ * address bits, larger ones two bytes (and the device address bits above
+ * 64KB), matching the driver. Page writes wrap within the page and start
+ * a 5ms write cycle during which the part does not acknowledge. Parts from
+ * 4KB to 64KB have a twin at 0x51 for clone and gang tests. A page can be
+ * set to fail its first write, which then leaves it all zeros.
+ */
+
+#include "sim.h"
+#include <Wire.h>
+
+#define EEPROM_BASE      0x50
+#define WRITE_CYCLE_NS   5000000ULL   // tWR
+#define WIRE_OVERHEAD_NS (40 * NS_PER_CYCLE)  // TWI interrupt per byte
+
+#define TW_ACK   0
+#define TW_NACK  1
+
+#define EEPROM_COUNT     2
+
+struct Eeprom {
+  byte* data;
+  unsigned long pointer;  // Internal address counter
+  uint64_t busyUntil;
+};
+
+static Eeprom eeproms[EEPROM_COUNT];
+static unsigned long eepromSize;
+static long failAddress = -1;  // The next write to its page fails
+
+static uint32_t wireClock = 100000;
+static byte sigSCL, sigSDA, sigByte;
+
+static byte txAddress;
+static byte txBuffer[BUFFER_LENGTH];
+static byte txLength = 0;
+static byte rxBuffer[BUFFER_LENGTH];
+static byte rxLength = 0, rxIndex = 0;
+
+void i2cEepromInit(unsigned long size) {
+  eepromSize = size;
+  for (byte i = 0; i < EEPROM_COUNT; i++) {
+    eeproms[i].data = (byte*)malloc(size);
+    memset(eeproms[i].data, 0xFF, size);
+  }
+
+  sigSCL = vcdSignal("i2c", "scl", 1);
+  sigSDA = vcdSignal("i2c", "sda", 1);
+  sigByte = vcdSignal("i2c", "byte", 8);
+  vcdChange(sigSCL, HIGH);
+  vcdChange(sigSDA, HIGH);
+}
+
+void i2cEepromFailOnce(unsigned long address) {
+  failAddress = address;
+}
+
+static unsigned int eepromPageSize() {
+  if (eepromSize <= 256) return 8;
+  if (eepromSize <= 2048) return 16;
+  if (eepromSize <= 8192) return 32;
+  if (eepromSize <= 32768) return 64;
+  if (eepromSize <= 65536) return 128;
+  return 256;
+}
+
+static byte addressBytes() {
+  return eepromSize <= 2048 ? 1 : 2;
+}
+
+// The chip a device address selects and the high address bits it carries;
+// NULL if no chip answers
+static Eeprom* selectChip(byte device, long& high) {
+  if ((device & 0xF8) != EEPROM_BASE) {
+    return NULL;
+  }
+
+  byte bits = device & 0x07;
+  high = 0;
+  if (eepromSize <= 2048) {
+    high = (long)bits << 8;
+    return &eeproms[0];
+  }
+  if (eepromSize > 65536) {
+    high = (long)bits << 16;
+    return &eeproms[0];
+  }
+  return bits < EEPROM_COUNT ? &eeproms[bits] : NULL;
+}
+
+// ===== BUS TIMING =====
+
+static uint64_t halfPeriod() {
+  return 500000000ULL / wireClock;
+}
+
+static void sendBit(byte level) {
+  if (!vcdEnabled()) {
+    simAdvance(2 * halfPeriod());
+    return;
+  }
+  vcdChange(sigSCL, LOW);
+  vcdChange(sigSDA, level);
+  simAdvance(halfPeriod());
+  vcdChange(sigSCL, HIGH);
+  simAdvance(halfPeriod());
+}
+
+static void sendStart() {
+  vcdChange(sigSDA, LOW);
+  simAdvance(halfPeriod());
+}
+
+static void sendStop() {
+  sendBit(LOW);
+  vcdChange(sigSDA, HIGH);
+  simAdvance(halfPeriod());
+}
+
+// Eight data bits and the acknowledge bit
+static void sendByte(byte value, byte ack) {
+  simAdvance(WIRE_OVERHEAD_NS);
+  vcdChange(sigByte, value);
+  for (int bitIndex = 7; bitIndex >= 0; bitIndex--) {
+    sendBit((value >> bitIndex) & 1);
+  }
+  sendBit(ack);
+}
+
+// ===== WIRE LIBRARY =====
+
+TwoWire Wire;
+
+void TwoWire::begin() {
+  rxLength = rxIndex = 0;
+}
+
+void TwoWire::setClock(uint32_t clock) {
+  wireClock = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  txAddress = address;
+  txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (txLength == BUFFER_LENGTH) {
+    return 0;
+  }
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+  size_t n = 0;
+  while (n < quantity && write(data[n])) {
+    n++;
+  }
+  return n;
+}
+
+// Returns 0 on success, 2 if the address was not acknowledged
+uint8_t TwoWire::endTransmission(uint8_t sendStopCondition) {
+  long high;
+  Eeprom* chip = selectChip(txAddress, high);
+  bool present = chip != NULL && chip->busyUntil <= simNow();
+
+  sendStart();
+  sendByte(txAddress << 1, present ? TW_ACK : TW_NACK);
+  if (!present) {
+    sendStop();
+    return 2;
+  }
+
+  // Address bytes set the pointer; the rest goes into the page
+  byte count = min(txLength, addressBytes());
+  unsigned long address = 0;
+  for (byte i = 0; i < txLength; i++) {
+    sendByte(txBuffer[i], TW_ACK);
+    if (i < count) {
+      address = (address << 8) | txBuffer[i];
+    }
+  }
+  if (sendStopCondition) {
+    sendStop();
+  }
+
+  if (txLength >= count && count == addressBytes()) {
+    chip->pointer = (address | high) % eepromSize;
+  }
+
+  if (txLength > count) {
+    unsigned int pageSize = eepromPageSize();
+    unsigned long pointer = chip->pointer;
+    unsigned long page = pointer - pointer % pageSize;
+    bool fail = chip == &eeproms[0] && failAddress >= 0 && (unsigned long)failAddress / pageSize == page / pageSize;
+    for (byte i = count; i < txLength; i++) {
+      chip->data[page + (pointer + i - count) % pageSize] = fail ? 0 : txBuffer[i];
+    }
+    if (fail) {
+      failAddress = -1;
+    }
+    chip->pointer = page + (pointer + txLength - count) % pageSize;
+    chip->busyUntil = simNow() + WRITE_CYCLE_NS;
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStopCondition) {
+  quantity = min(quantity, (uint8_t)BUFFER_LENGTH);
+  long high;
+  Eeprom* chip = selectChip(address, high);
+  bool present = chip != NULL && chip->busyUntil <= simNow();
+
+  rxLength = rxIndex = 0;
+  sendStart();
+  sendByte((address << 1) | 1, present ? TW_ACK : TW_NACK);
+  if (!present) {
+    sendStop();
+    return 0;
+  }
+
+  // The last byte is not acknowledged by the master
+  for (byte i = 0; i < quantity; i++) {
+    byte value = chip->data[chip->pointer];
+    chip->pointer = (chip->pointer + 1) % eepromSize;
+    rxBuffer[rxLength++] = value;
+    sendByte(value, i + 1 < quantity ? TW_ACK : TW_NACK);
+  }
+  sendStop();
+  return rxLength;
+}
+
+int TwoWire::available() {
+  return rxLength - rxIndex;
+}
+
+int TwoWire::read() {
+  return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1;
+}
+
+int TwoWire::peek() {
+  return rxIndex < rxLength ? rxBuffer[rxIndex] : -1;
+}
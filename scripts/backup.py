@@ -0,0 +1,157 @@
+"""
+Incremental chip backup
+
+Keeps a backup file in step with the chip on the programmer while reading
+as little as possible. The programmer's 'H' command hashes every erase unit
+in one pass at bus speed; the tool compares each CRC-32 with the same unit
+of the backup file and reads only the units that differ (adjacent ones in
+one 'r' dump), checks them against the map and writes the file back. The
+first backup of a chip reads it all.
+
+Needs pyserial.
+
+Usage: python scripts/backup.py /dev/ttyUSB0 backup.bin [--mode 2]
+"""
+
+import argparse
+import os
+import re
+import sys
+import time
+import zlib
+
+import serial
+
+SERIAL_BAUD = 115200   # SERIAL_BAUD in include/config.h
+LINE_TIMEOUT = 5.0     # Longest silence while a command runs
+NAND_TIMEOUT = 600.0   # A full NAND map takes minutes
+
+MAP_HEADER = re.compile(r"^Hash map: (\d+) units of (\d+) bytes")
+MAP_LINE = re.compile(r"^([0-9A-F]{8}) ([0-9A-F]{8})$")
+DUMP_LINE = re.compile(r"^0x([0-9A-F]+):((?: [0-9A-F]{2})+)")
+DUMP_END = re.compile(r"^0x([0-9A-F]+)$")
+
+
+def read_line(port, timeout=LINE_TIMEOUT):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        line = port.readline().decode(errors="replace").strip()
+        if line:
+            return line
+    raise RuntimeError("programmer not responding")
+
+
+def hash_map(port):
+    """Run 'H'; returns (unit size, [CRC per unit])."""
+    port.write(b"H")
+    line = read_line(port)
+    while not MAP_HEADER.match(line):
+        if line.startswith("Please select"):
+            raise RuntimeError("no memory type selected; use --mode")
+        line = read_line(port)
+    units, unit = (int(n) for n in MAP_HEADER.match(line).groups())
+
+    crcs = []
+    while True:
+        line = read_line(port, NAND_TIMEOUT)
+        match = MAP_LINE.match(line)
+        if match:
+            if int(match.group(1), 16) != len(crcs) * unit:
+                raise RuntimeError("hash map out of order at " + line)
+            crcs.append(int(match.group(2), 16))
+        elif line.startswith("Hash map done"):
+            break
+        elif line.startswith("Hash map failed") or line.startswith("Aborted"):
+            raise RuntimeError(line)
+
+    if len(crcs) != units:
+        raise RuntimeError("hash map has %d of %d units" % (len(crcs), units))
+    return unit, crcs
+
+
+def read_range(port, address, length):
+    """Read a range with 'r', undoing folded dump lines ('*')."""
+    port.write(b"r\n%x\n%d\n" % (address, length))
+    data = bytearray()
+    last = b""
+    folded = False
+    while len(data) < length:
+        line = read_line(port)
+        if line == "*":
+            folded = True
+            continue
+
+        match = DUMP_LINE.match(line) or DUMP_END.match(line)
+        if not match:
+            continue
+        # A folded run repeats the line before it up to the next address
+        if folded:
+            while address + len(data) < int(match.group(1), 16):
+                data += last
+            folded = False
+        if match.re is DUMP_LINE:
+            last = bytes(int(h, 16) for h in match.group(2).split())
+            data += last
+    return bytes(data[:length])
+
+
+def changed_runs(unit, crcs, backup):
+    """(first unit, count) for each run of units whose CRC differs."""
+    runs = []
+    for i, crc in enumerate(crcs):
+        old = backup[i * unit:(i + 1) * unit]
+        if len(old) == unit and zlib.crc32(old) == crc:
+            continue
+        if runs and runs[-1][0] + runs[-1][1] == i:
+            runs[-1][1] += 1
+        else:
+            runs.append([i, 1])
+    return runs
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Incremental chip backup")
+    parser.add_argument("port", help="serial port, e.g. /dev/ttyUSB0 or COM3")
+    parser.add_argument("backup", help="backup file, created or brought up to date")
+    parser.add_argument("--baud", type=int, default=SERIAL_BAUD)
+    parser.add_argument("--mode", choices=("1", "2", "3"), help="select NAND (1), SPI (2) or I2C (3) first")
+    options = parser.parse_args()
+
+    backup = b""
+    if os.path.exists(options.backup):
+        with open(options.backup, "rb") as f:
+            backup = f.read()
+
+    port = serial.Serial(options.port, options.baud, timeout=0.5)
+    try:
+        if options.mode:
+            port.write(options.mode.encode())
+            time.sleep(0.5)
+            port.reset_input_buffer()
+
+        start = time.monotonic()
+        unit, crcs = hash_map(port)
+        image = bytearray(backup[:unit * len(crcs)].ljust(unit * len(crcs), b"\xff"))
+
+        fetched = 0
+        for first, count in changed_runs(unit, crcs, backup):
+            address = first * unit
+            data = read_range(port, address, count * unit)
+            for i in range(count):
+                if zlib.crc32(data[i * unit:(i + 1) * unit]) != crcs[first + i]:
+                    raise RuntimeError("unit at 0x%X read back with a different CRC" % (address + i * unit))
+            image[address:address + len(data)] = data
+            fetched += count
+    except RuntimeError as error:
+        sys.exit(str(error))
+    finally:
+        port.close()
+
+    with open(options.backup, "wb") as f:
+        f.write(image)
+    print("%d of %d units of %d bytes changed, %d bytes read in %.1f s"
+          % (fetched, len(crcs), unit, fetched * unit, time.monotonic() - start))
+
+
+if __name__ == "__main__":
+    main()
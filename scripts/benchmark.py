@@ -0,0 +1,270 @@
+"""
+Throughput benchmarks on the native build
+
+Runs the host build of the firmware (pio run -e native) against its
+simulated SPI flash, NAND and I2C EEPROM and measures bytes per second of
+simulated time for erase, program, verify, read and diff-program. Each
+combination of device, image size and content mix is one session:
+
+  random     fresh random data on an erased range
+  erased     all 0xFF, so diff-program skips every page
+  identical  diff-program over a random image that differs in a few pages
+
+Erase and read run as one-step job scripts (read is a CRC verify, so it
+measures the bus rather than the serial link); program, verify and
+diff-program send the image over the simulated serial link. Simulated time
+makes the results repeatable, so any change is a real change.
+
+Every session runs once per link rate (--rates, as if negotiated with 'b')
+and once more with checkpoints kept in EEPROM ('k'). The simulated host is
+paced (--paced): it sends image data only as the programmer grants it and
+the programmer's RX buffer drops what does not fit, as on the board. A
+session that drops a byte, times out or reports a failure fails the run.
+
+Usage:
+  python scripts/benchmark.py [-o results.json]
+  python scripts/benchmark.py --baseline scripts/benchmark_baseline.json
+  python scripts/benchmark.py --update-baseline scripts/benchmark_baseline.json
+
+With --baseline the run also fails when a metric drops more than
+--threshold below the baseline.
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+import zlib
+
+DEFAULT_PROGRAM = os.path.join(".pio", "build", "native", "program")
+
+# Mode key, capacity and erase unit of each simulated chip
+DEVICES = {
+    "spi": ("2", 1 << 20, 4 << 10),
+    "nand": ("1", 32 << 20, 16 << 10),
+    "i2c": ("3", 32 << 10, 256),
+}
+
+MIXES = ("random", "erased", "identical")
+OPERATIONS = ("erase", "program", "verify", "read", "diff")
+RATES = (115200, 250000, 500000, 1000000)
+
+LINE = re.compile(r"^\[(\d+)\] (.*)$")
+DROPPED = re.compile(r"^RX overflow: (\d+) bytes dropped")
+
+
+class SessionError(Exception):
+    pass
+
+
+def make_images(mix, size, rng):
+    """Return (base, image): base is on the chip before diff-program."""
+    erased = bytes([0xFF]) * size
+    if mix == "erased":
+        return erased, erased
+
+    image = bytearray(rng.getrandbits(8) for _ in range(size))
+    # The programmer drops line endings queued before the first byte
+    if image[0] in (0x0A, 0x0D):
+        image[0] = 0
+    if mix == "random":
+        return erased, bytes(image)
+
+    # Clear bits in one page of sixteen so no erase is needed
+    base = bytes(image)
+    for page in range(0, size, 256 * 16):
+        for i in range(page, min(page + 256, size)):
+            image[i] &= rng.getrandbits(8)
+    if image[0] in (0x0A, 0x0D):
+        image[0] = 0
+    return base, bytes(image)
+
+
+class Session:
+    """Command lines and image data for one run; counts the operations that
+    report a result."""
+
+    def __init__(self, mode, persist):
+        self.commands = ""
+        self.images = bytearray()
+        self.operations = 0
+        self.commands += mode + "\n"
+        if persist:
+            self.commands += "k\n"
+
+    def script(self, step):
+        self.commands += "S\n%s\nend\nx\n" % step
+        self.operations += 1
+
+    def image(self, command, length, data):
+        self.commands += "%s\n0\n%d\n" % (command, length)
+        self.images += data
+        self.operations += 1
+
+
+def build_session(device, size, mix, persist, rng):
+    mode, _, unit = DEVICES[device]
+    base, image = make_images(mix, size, rng)
+    s = Session(mode, persist)
+
+    # Scripts erase whole units only
+    erase = "erase 0 %x" % (-(-size // unit) * unit)
+    s.script(erase)
+    s.image("p", size, image)
+    s.image("V", size, image)
+    s.script("verify 0 %x %08X" % (size, zlib.crc32(image) & 0xFFFFFFFF))
+
+    s.script(erase)
+    if base != bytes([0xFF]) * size:
+        s.image("p", size, base)
+    s.image("d", size, image)
+    return s
+
+
+def parse_times(output, log):
+    """(seconds, succeeded, result line) for each operation, in session order."""
+    lines = []
+    for raw in output.splitlines() + log.splitlines():
+        match = LINE.match(raw)
+        if match:
+            lines.append((int(match.group(1)), match.group(2).strip()))
+    lines.sort(key=lambda line: line[0])
+
+    # Each timed operation starts with one line and ends with another: a
+    # script when the host's 'x' has arrived, an image transfer at "Send"
+    spans = []
+    start = None
+    for time, text in lines:
+        if text == "< x" or text.startswith("Send "):
+            start = time
+        elif start is not None and text.startswith(("Script passed", "Script failed", "Write", "Verify", "Error")):
+            ok = "passed" in text or "complete" in text or "OK" in text
+            spans.append(((time - start) / 1e6, ok, text))
+            start = None
+    return spans
+
+
+def run_session(program, device, size, mix, baud, persist, seed):
+    rng = random.Random("%s/%d/%s/%d" % (device, size, mix, seed))
+    session = build_session(device, size, mix, persist, rng)
+
+    with tempfile.NamedTemporaryFile(suffix=".bin") as images:
+        images.write(session.images)
+        images.flush()
+        result = subprocess.run([program, "--timestamps", "--idle-ms", "1000", "--baud", str(baud),
+                                 "--paced", "--image", images.name],
+                                input=session.commands.encode(), stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    output = result.stdout.decode(errors="replace")
+    log = result.stderr.decode(errors="replace")
+    spans = parse_times(output, log)
+
+    # erase, program, verify, read, erase, [program base], diff
+    dropped = [line for line in log.splitlines() if DROPPED.match(line)]
+    failed = [text for _, ok, text in spans if not ok]
+    if dropped or failed or len(spans) != session.operations or result.returncode not in (0, 3):
+        raise SessionError("; ".join(dropped + failed) or "%d of %d operations reported" % (len(spans), session.operations))
+
+    seconds = {
+        "erase": spans[0][0],
+        "program": spans[1][0],
+        "verify": spans[2][0],
+        "read": spans[3][0],
+        "diff": spans[-1][0],
+    }
+    return {op: {"seconds": round(t, 6), "bytes_per_sec": round(size / t, 1) if t > 0 else None}
+            for op, t in seconds.items()}
+
+
+def compare(results, baseline, threshold):
+    failures = []
+    for key, metrics in sorted(baseline["results"].items()):
+        if key not in results:
+            continue
+        old = metrics["bytes_per_sec"]
+        new = results[key]["bytes_per_sec"]
+        if old and new is not None and new < old * (1 - threshold):
+            failures.append("%s: %.1f B/s, baseline %.1f B/s (%+.1f%%)" % (key, new, old, (new / old - 1) * 100))
+    return failures
+
+
+def session_key(device, size, mix, baud, persist):
+    return "%s/%d/%s/%d%s" % (device, size, mix, baud, "/persist" if persist else "")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Throughput benchmarks on the native build")
+    parser.add_argument("--program", default=DEFAULT_PROGRAM, help="native firmware (default: %(default)s)")
+    parser.add_argument("--devices", default=",".join(DEVICES), help="comma-separated: spi,nand,i2c")
+    parser.add_argument("--sizes", default="4096,32768,262144", help="comma-separated image sizes in bytes")
+    parser.add_argument("--mixes", default=",".join(MIXES), help="comma-separated: random,erased,identical")
+    parser.add_argument("--rates", default=",".join(str(r) for r in RATES), help="comma-separated link rates")
+    parser.add_argument("--persist", default="off,on", help="checkpoints in EEPROM: off, on or off,on")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("-o", "--output", help="write the results as JSON")
+    parser.add_argument("--baseline", help="fail on regressions against this JSON file")
+    parser.add_argument("--threshold", type=float, default=0.05, help="allowed slowdown (default: %(default)s)")
+    parser.add_argument("--update-baseline", metavar="FILE", help="write the results as the new baseline")
+    options = parser.parse_args()
+
+    if not os.path.exists(options.program):
+        sys.exit("%s not found; build it with: pio run -e native" % options.program)
+
+    sizes = [int(s, 0) for s in options.sizes.split(",")]
+    rates = [int(r) for r in options.rates.split(",")]
+    persists = [p == "on" for p in options.persist.split(",")]
+    results = {}
+    failed = []
+    print("%-6s %8s %-10s %8s %-7s" % ("device", "size", "mix", "baud", "persist")
+          + "".join("%12s" % op for op in OPERATIONS) + "   (bytes/s)")
+    for device in options.devices.split(","):
+        for size in sizes:
+            if size > DEVICES[device][1]:
+                continue
+            for mix in options.mixes.split(","):
+                for baud in rates:
+                    for persist in persists:
+                        row = "%-6s %8d %-10s %8d %-7s" % (device, size, mix, baud, "on" if persist else "off")
+                        key = session_key(device, size, mix, baud, persist)
+                        try:
+                            metrics = run_session(options.program, device, size, mix, baud, persist, options.seed)
+                        except SessionError as error:
+                            failed.append("%s: %s" % (key, error))
+                            print(row + "   FAILED")
+                            continue
+                        for op in OPERATIONS:
+                            results[key.replace("/", "/%s/" % op, 1)] = metrics[op]
+                            row += "%12.0f" % (metrics[op]["bytes_per_sec"] or 0)
+                        print(row)
+
+    report = {"seed": options.seed, "unit": "bytes per second of simulated time", "results": results}
+    for path in (options.output, options.update_baseline):
+        if path:
+            with open(path, "w") as f:
+                json.dump(report, f, indent=2, sort_keys=True)
+                f.write("\n")
+
+    if failed:
+        print("\nFailed sessions:")
+        for line in failed:
+            print("  " + line)
+
+    if options.baseline:
+        with open(options.baseline) as f:
+            failures = compare(results, json.load(f), options.threshold)
+        if failures:
+            print("\nRegressions beyond %.0f%%:" % (options.threshold * 100))
+            for line in failures:
+                print("  " + line)
+            sys.exit(1)
+        print("\nNo regressions beyond %.0f%%" % (options.threshold * 100))
+
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
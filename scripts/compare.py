@@ -0,0 +1,128 @@
+"""
+Compare a chip with an image file on the programmer
+
+Streams the image to the programmer's 'V' command, which reads the same
+range from the chip and compares it at bus speed. Only the result comes
+back: the number of differing bytes and the first ranges that differ, each
+with its first differing bytes as read and as expected. With --packed the
+image is sent PackBits-encoded ('Z'), which saves link time on images with
+long runs such as erased areas.
+
+Needs pyserial.
+
+Usage: python scripts/compare.py /dev/ttyUSB0 image.bin [--address 0x1000] [--packed]
+"""
+
+import argparse
+import sys
+import time
+
+import serial
+
+SERIAL_BAUD = 115200  # SERIAL_BAUD in include/config.h
+RESULT_TIMEOUT = 5.0  # Longest wait for a request or the result
+
+
+def packbits(data):
+    """PackBits-encode data; runs of three or more equal bytes become runs."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        j = i
+        while j < len(data) and j - i < 128 and data[j] == data[i]:
+            j += 1
+        if j - i >= 3:
+            out += bytes([257 - (j - i), data[i]])
+            i = j
+            continue
+
+        j = i
+        while j < len(data) and j - i < 128 and not (j + 2 < len(data) and data[j] == data[j + 1] == data[j + 2]):
+            j += 1
+        out.append(j - i - 1)
+        out += data[i:j]
+        i = j
+    return bytes(out)
+
+
+def read_line(port, timeout=RESULT_TIMEOUT):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        line = port.readline().decode(errors="replace").rstrip("\r\n")
+        if line:
+            return line
+    return None
+
+
+def set_packed(port, packed):
+    """Toggle 'Z' until image transfers are packed or not, as asked."""
+    for _ in range(2):
+        port.write(b"Z")
+        line = read_line(port)
+        while line is not None and not line.startswith("PackBits"):
+            line = read_line(port)
+        if line is None:
+            raise RuntimeError("programmer not responding")
+        if line.endswith("enabled") == packed:
+            return
+    raise RuntimeError("unexpected answer: " + line)
+
+
+def compare(port, address, image, packed):
+    """Run 'V'; returns the result lines."""
+    set_packed(port, packed)
+    port.write(b"V\n%x\n%d\n" % (address, len(image)))
+
+    sent = 0
+    while True:
+        line = read_line(port)
+        if line is None:
+            raise RuntimeError("no answer after %d bytes" % sent)
+        if line.startswith(">"):
+            chunk = image[sent:sent + int(line[1:])]
+            # A leading no-op header keeps the first byte clear of line endings
+            port.write(b"\x80" + packbits(chunk) if packed else chunk)
+            sent += len(chunk)
+        elif line.startswith("Verify"):
+            break
+        elif line.startswith("Error") or line.startswith("Invalid"):
+            raise RuntimeError(line)
+
+    results = [line]
+    while True:
+        line = read_line(port, 0.5)
+        if line is None or not line.startswith("  "):
+            return results
+        results.append(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare a chip with an image file on the programmer")
+    parser.add_argument("port", help="serial port, e.g. /dev/ttyUSB0 or COM3")
+    parser.add_argument("image", help="image file")
+    parser.add_argument("--address", type=lambda s: int(s, 0), default=0, help="start address (default: 0)")
+    parser.add_argument("--baud", type=int, default=SERIAL_BAUD)
+    parser.add_argument("--packed", action="store_true", help="send the image PackBits-encoded")
+    options = parser.parse_args()
+
+    with open(options.image, "rb") as f:
+        image = f.read()
+    if not image:
+        sys.exit("empty image")
+    if not options.packed and image[0] in (0x0A, 0x0D):
+        sys.exit("the image starts with a line ending; use --packed")
+
+    port = serial.Serial(options.port, options.baud, timeout=0.5)
+    try:
+        results = compare(port, options.address, image, options.packed)
+    except RuntimeError as error:
+        sys.exit(str(error))
+    finally:
+        port.close()
+
+    print("\n".join(results))
+    sys.exit(0 if results[0].startswith("Verify OK") else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,146 @@
+"""
+Serial link speed negotiation
+
+Steps the programmer's UART up from 115200 baud. Each rate is proposed
+with 'b'; both ends switch, 1024 bytes of random data are echoed back and
+checked together with the programmer's CRC, and the rate is kept if both
+match. The tool stops at the first rate that fails, which leaves the
+programmer at the fastest clean rate, and prints the measured echo
+throughput of each rate.
+
+The echo test only shows that the UART works at a rate. Image transfers
+hold up at any such rate because the programmer grants at most
+GRANT_WINDOW bytes beyond those it has read, which fits its RX buffer
+however long the chip keeps it busy.
+
+If the programmer misses the answer it returns to the previous rate on its
+own after two seconds, and a reset always brings it back at 115200, so the
+tool can always find it again. Opening the port resets most Arduino boards,
+and that also drops the link to 115200. Tools that want the faster rate
+should import negotiate() and carry on with the same open port.
+
+Needs pyserial.
+
+Usage: python scripts/link.py /dev/ttyUSB0 [--rates 115200,250000,500000,1000000,2000000]
+"""
+
+import argparse
+import os
+import sys
+import time
+import zlib
+
+import serial
+
+SERIAL_BAUD = 115200  # SERIAL_BAUD in include/config.h
+TEST_BYTES = 1024     # LINK_TEST_BYTES
+LINK_TIMEOUT = 2.0    # LINK_TIMEOUT_MS
+SWITCH_DELAY = 0.05   # Time for the programmer to switch after announcing it
+
+RATES = (115200, 250000, 500000, 1000000, 2000000)
+
+
+def read_until(port, marker, timeout):
+    """Read lines until one starts with marker; returns it, or None on timeout."""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        line = port.readline().decode(errors="replace").strip()
+        if line.startswith(marker):
+            return line
+    return None
+
+
+def find(port, rates):
+    """Find the rate the programmer is at by asking for the menu."""
+    # A board that just reset prints the menu by itself
+    port.baudrate = SERIAL_BAUD
+    if read_until(port, "==== COMMANDS", 3) is not None:
+        return SERIAL_BAUD
+
+    for baud in rates:
+        port.baudrate = baud
+        port.reset_input_buffer()
+        port.write(b"h")
+        if read_until(port, "==== COMMANDS", 1) is not None:
+            return baud
+    raise RuntimeError("programmer not responding")
+
+
+def try_rate(port, baud):
+    """Propose baud; returns echo bytes per second, or None if the link went back."""
+    previous = port.baudrate
+    port.reset_input_buffer()
+    port.write(b"b\n%d\n" % baud)
+    if read_until(port, "Switching to", 1) is None:
+        return None
+
+    time.sleep(SWITCH_DELAY)
+    port.baudrate = baud
+    port.reset_input_buffer()
+
+    data = os.urandom(TEST_BYTES)
+    start = time.monotonic()
+    port.write(b"LINK" + data)
+    echo = port.read(len(data))
+    elapsed = time.monotonic() - start
+
+    line = read_until(port, "CRC ", LINK_TIMEOUT) if echo == data else None
+    if line is not None and int(line[4:], 16) == zlib.crc32(data):
+        port.write(b"y")
+        if read_until(port, "Link at", 1) is not None:
+            return len(data) / elapsed
+
+    # Decline; the programmer also goes back by itself if it missed that
+    port.write(b"n")
+    time.sleep(SWITCH_DELAY)
+    port.baudrate = previous
+    if read_until(port, "Link back at", LINK_TIMEOUT + 1) is None:
+        find(port, (previous, baud))
+    return None
+
+
+def negotiate(port, rates=RATES):
+    """Step up through rates; returns [(baud, bytes per second or None)]."""
+    results = []
+    for baud in rates:
+        speed = try_rate(port, baud)
+        results.append((baud, speed))
+        if speed is None:
+            break
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Negotiate the programmer's serial link speed")
+    parser.add_argument("port", help="serial port, e.g. /dev/ttyUSB0 or COM3")
+    parser.add_argument("--rates", default=",".join(str(r) for r in RATES),
+                        help="comma-separated rates to try in order (default: %(default)s)")
+    options = parser.parse_args()
+
+    rates = [int(r) for r in options.rates.split(",")]
+
+    port = serial.Serial()
+    port.port = options.port
+    port.baudrate = SERIAL_BAUD
+    port.timeout = 1
+    # Keep DTR low where the driver allows it, to avoid the auto-reset
+    port.dtr = False
+    port.rts = False
+    port.open()
+
+    try:
+        find(port, rates)
+        for baud, speed in negotiate(port, rates):
+            if speed is None:
+                print("%8d baud  failed" % baud)
+            else:
+                print("%8d baud  %8.0f bytes/s echoed" % (baud, speed))
+        print("Link at %d baud" % port.baudrate)
+    except RuntimeError as error:
+        sys.exit(str(error))
+    finally:
+        port.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,89 @@
+"""
+Per-module size report (PlatformIO post-build script)
+
+After the firmware is linked, lists the flash (text + data) and SRAM
+(data + bss) taken by each source module, largest first. Framework and
+library objects are summed per library. The table is printed and written to
+size_report.txt in the environment's build directory.
+
+The linked firmware's .data + .bss must also leave room for the stack: the
+build fails when it exceeds RAM_BUDGET bytes (custom_ram_budget in the
+environment overrides it).
+"""
+
+import os
+import subprocess
+
+Import("env")
+
+# Of the ATmega328P's 2048 bytes, about 200 are left for the stack
+RAM_BUDGET = 1843
+
+
+def module_name(build_dir, path):
+    rel = os.path.relpath(path, build_dir).replace(os.sep, "/")
+    if rel.startswith("src/"):
+        return rel[len("src/"):-len(".o")]
+    return rel.split("/")[0]
+
+
+def static_ram(size_tool, elf):
+    """Bytes of .data and .bss in the linked firmware."""
+    output = subprocess.check_output([size_tool, "-A", elf]).decode()
+    total = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in (".data", ".bss", ".noinit"):
+            total += int(fields[1])
+    return total
+
+
+def size_report(source, target, env):
+    build_dir = env.subst("$BUILD_DIR")
+    size_tool = env.subst("$SIZETOOL")
+
+    objects = []
+    for root, _, files in os.walk(build_dir):
+        objects += [os.path.join(root, f) for f in files if f.endswith(".o")]
+    if not objects:
+        return
+
+    # Berkeley format: text data bss dec hex filename
+    output = subprocess.check_output([size_tool, "-B"] + objects).decode()
+
+    modules = {}
+    for line in output.splitlines()[1:]:
+        fields = line.split(None, 5)
+        text, data, bss = int(fields[0]), int(fields[1]), int(fields[2])
+        name = module_name(build_dir, fields[5])
+        flash, sram = modules.get(name, (0, 0))
+        modules[name] = (flash + text + data, sram + data + bss)
+
+    rows = sorted(modules.items(), key=lambda item: item[1][0], reverse=True)
+    lines = ["%-24s %8s %8s" % ("module", "flash", "sram")]
+    for name, (flash, sram) in rows:
+        lines.append("%-24s %8d %8d" % (name, flash, sram))
+    lines.append("%-24s %8d %8d" % ("total (objects)",
+                                    sum(m[0] for m in modules.values()),
+                                    sum(m[1] for m in modules.values())))
+
+    elf = str(target[0])
+    budget = int(env.GetProjectOption("custom_ram_budget", RAM_BUDGET))
+    ram = static_ram(size_tool, elf)
+    lines.append("%-24s %8s %8d (budget %d)" % ("total (.data + .bss)", "", ram, budget))
+
+    report = "\n".join(lines)
+    print("\nSize report (%s)\n%s\n" % (env.subst("$PIOENV"), report))
+    with open(os.path.join(build_dir, "size_report.txt"), "w") as f:
+        f.write(report + "\n")
+
+    if ram > budget:
+        print("Error: .data + .bss take %d bytes, over the %d byte budget; "
+              "the stack would run into them" % (ram, budget))
+        # Rebuild next time rather than pass on an up-to-date ELF
+        os.remove(elf)
+        return 1
+    return 0
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_report)
@@ -0,0 +1,104 @@
+"""
+Bus trace to Chrome trace / Perfetto JSON
+
+Reads a serial capture containing the output of the 'T' command (lines
+"T <start us> <duration us> <op> <address hex> <length> <result>") and
+writes a JSON timeline that chrome://tracing and ui.perfetto.dev open
+directly. Other lines in the capture are ignored, so a whole session log
+can be passed in; several dumps in one capture are joined in order.
+
+Usage: python scripts/trace2json.py capture.txt [-o trace.json]
+"""
+
+import argparse
+import json
+import sys
+
+POLL_RESULTS = {0: "busy", 1: "done", 2: "failed"}
+
+# Polls are folded into spans that overlap the calls made while the chip is
+# busy, so they get a track of their own
+TRACKS = {"poll": 2}
+BUS_TRACK = 1
+
+
+def parse(lines):
+    entries = []
+    for line in lines:
+        fields = line.split()
+        if len(fields) != 7 or fields[0] != "T":
+            continue
+        try:
+            start, duration = int(fields[1]), int(fields[2])
+            address, length = int(fields[4], 16), int(fields[5])
+            result = int(fields[6])
+        except ValueError:
+            continue
+        entries.append((start, duration, fields[3], address, length, result))
+    return entries
+
+
+def to_events(entries):
+    events = [
+        {"ph": "M", "pid": 1, "name": "process_name", "args": {"name": "programmer"}},
+        {"ph": "M", "pid": 1, "tid": BUS_TRACK, "name": "thread_name", "args": {"name": "bus"}},
+        {"ph": "M", "pid": 1, "tid": TRACKS["poll"], "name": "thread_name", "args": {"name": "status poll"}},
+    ]
+
+    # micros() wraps every 71.6 minutes; keep the timeline monotonic
+    offset = 0
+    previous = None
+    for start, duration, op, address, length, result in entries:
+        if previous is not None and start < previous and previous - start > 1 << 31:
+            offset += 1 << 32
+        previous = start
+
+        if op == "poll":
+            name = "poll " + POLL_RESULTS.get(result, str(result))
+            args = {"polls": length}
+        elif op == "status":
+            name = op
+            args = {"value": "0x%X" % address}
+        else:
+            name = op
+            args = {"address": "0x%X" % address, "bytes": length}
+            if result:
+                args["result"] = result
+
+        events.append({
+            "name": name,
+            "cat": op,
+            "ph": "X",
+            "ts": start + offset,
+            "dur": max(duration, 1),
+            "pid": 1,
+            "tid": TRACKS.get(op, BUS_TRACK),
+            "args": args,
+        })
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="serial capture (default: stdin)")
+    parser.add_argument("-o", "--output", help="JSON file (default: stdout)")
+    options = parser.parse_args()
+
+    if options.capture:
+        with open(options.capture) as f:
+            entries = parse(f)
+    else:
+        entries = parse(sys.stdin)
+
+    trace = {"traceEvents": to_events(entries), "displayTimeUnit": "ms"}
+
+    if options.output:
+        with open(options.output, "w") as f:
+            json.dump(trace, f)
+        print("%d entries written to %s" % (len(entries), options.output))
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,7 @@
+/**
+ * Static SRAM arena - see arena.h
+ */
+
+#include "arena.h"
+
+Arena arena;
@@ -0,0 +1,197 @@
+/**
+ * Content statistics map - see blockmap.h
+ */
+
+#include <math.h>
+#include "arena.h"
+#include "blockmap.h"
+#include "engine.h"
+#include "scheduler.h"
+#include "txring.h"
+
+#if FEATURE_BLOCKMAP
+
+#define MAP_LINE_SPACE    40  // "AAAAAAAA FF=100% 00=100% H=8.0 FFFF-FFFF" and CR LF
+#define MAP_LINES_MAX     (PAGE_BUFFER_SIZE / BLOCKMAP_MIN_BLOCK + 2)  // Per read chunk, with a blank run
+
+#define NO_OFFSET         0xFFFFFFFFUL
+
+static_assert(TX_RING_SIZE >= MAP_LINE_SPACE * MAP_LINES_MAX, "The TX ring must hold the map lines of a read chunk");
+
+static BlockMapJob& map = arena.job.blockMap;
+
+static char* formatHex(char* out, unsigned long value, byte digits) {
+  while (digits-- > 0) {
+    byte nibble = (value >> (4 * digits)) & 0x0F;
+    *out++ = nibble < 10 ? '0' + nibble : 'A' + nibble - 10;
+  }
+  return out;
+}
+
+static char* formatDec(char* out, byte value) {
+  if (value >= 100) {
+    *out++ = '0' + value / 100;
+  }
+  if (value >= 10) {
+    *out++ = '0' + value / 10 % 10;
+  }
+  *out++ = '0' + value % 10;
+  return out;
+}
+
+static void queueLine(char* end) {
+  *end++ = '\r';
+  *end++ = '\n';
+  txRingWrite((const byte*)arena.text, end - arena.text);
+}
+
+static void flushBlankRun(unsigned long end) {
+  if (map.inBlank) {
+    char* line = formatHex(arena.text, map.blankStart, 8);
+    *line++ = '-';
+    line = formatHex(line, end - 1, 8);
+    memcpy(line, " blank", 6);
+    queueLine(line + 6);
+    map.inBlank = false;
+  }
+}
+
+// Entropy of the nibble distribution, doubled, in tenths of a bit per byte
+static byte entropyTenths() {
+  float total = map.block * 2.0;
+  float bits = 0;
+  for (byte i = 0; i < 16; i++) {
+    if (arena.nibbles[i] > 0) {
+      float p = arena.nibbles[i] / total;
+      bits -= p * log(p);
+    }
+  }
+  return (byte)(bits * 2 / M_LN2 * 10 + 0.5);
+}
+
+static void finishBlock(unsigned long address) {
+  if (map.ff == map.block) {
+    if (!map.inBlank) {
+      map.blankStart = address;
+      map.inBlank = true;
+    }
+  } else {
+    flushBlankRun(address);
+    map.used++;
+
+    byte tenths = entropyTenths();
+    char* line = formatHex(arena.text, address, 8);
+    memcpy(line, " FF=", 4);
+    line = formatDec(line + 4, map.ff * 100 / map.block);
+    memcpy(line, "% 00=", 5);
+    line = formatDec(line + 5, map.zero * 100 / map.block);
+    memcpy(line, "% H=", 4);
+    line = formatDec(line + 4, tenths / 10);
+    *line++ = '.';
+    *line++ = '0' + tenths % 10;
+    *line++ = ' ';
+    line = formatHex(line, map.first, 4);
+    *line++ = '-';
+    line = formatHex(line, map.last, 4);
+    queueLine(line);
+  }
+
+  map.filled = 0;
+  map.ff = 0;
+  map.zero = 0;
+  map.first = NO_OFFSET;
+  memset(arena.nibbles, 0, sizeof(arena.nibbles));
+}
+
+static bool mapReady() {
+  return txRingFree() >= MAP_LINE_SPACE * MAP_LINES_MAX;
+}
+
+static void mapConsume(unsigned long address, const byte* data, unsigned int len) {
+  for (unsigned int i = 0; i < len; i++) {
+    byte b = data[i];
+    if (b == 0xFF) {
+      map.ff++;
+    } else {
+      if (map.first == NO_OFFSET) {
+        map.first = map.filled;
+      }
+      map.last = map.filled;
+      if (b == 0) {
+        map.zero++;
+      }
+    }
+    arena.nibbles[b >> 4]++;
+    arena.nibbles[b & 0x0F]++;
+
+    if (++map.filled == map.block) {
+      finishBlock(address + i + 1 - map.block);
+    }
+  }
+}
+
+static void mapFinish() {
+  flushBlankRun(map.block * map.blocks);
+}
+
+static const ReadSink mapSink PROGMEM = {
+  mapReady,
+  mapConsume,
+  mapFinish,
+  PAGE_BUFFER_SIZE
+};
+
+static bool blockMapSequence() {
+  if (!map.running) {
+    map.running = true;
+    engineRead(map.dev, 0, map.block * map.blocks, mapSink);
+    return false;
+  }
+
+  if (!engineSucceeded()) {
+    Serial.println(F("Block map failed"));
+    return true;
+  }
+
+  Serial.print(F("Block map done, "));
+  Serial.print(map.used);
+  Serial.print(F(" of "));
+  Serial.print(map.blocks);
+  Serial.print(F(" blocks used, "));
+  Serial.print(millis() - map.startTime);
+  Serial.println(F(" ms"));
+  return true;
+}
+
+void blockMapRun(const MemoryDevice& dev, unsigned long blockSize) {
+  Geometry geo;
+  DRIVER(dev, geometry)(dev.unit, geo);
+
+  if (blockSize == 0) {
+    blockSize = (geo.flags & GEO_NEEDS_ERASE) ? geo.eraseSize : geo.pageSize;
+    blockSize = min(max(blockSize, (unsigned long)BLOCKMAP_MIN_BLOCK), BLOCKMAP_MAX_BLOCK);
+  }
+
+  map.dev = dev;
+  map.block = blockSize;
+  map.blocks = geo.capacity / blockSize;
+  map.filled = 0;
+  map.ff = 0;
+  map.zero = 0;
+  map.first = NO_OFFSET;
+  map.inBlank = false;
+  map.used = 0;
+  map.running = false;
+  map.startTime = millis();
+  memset(arena.nibbles, 0, sizeof(arena.nibbles));
+
+  Serial.print(F("Block map: "));
+  Serial.print(map.blocks);
+  Serial.print(F(" blocks of "));
+  Serial.print(map.block);
+  Serial.println(F(" bytes"));
+
+  startSequence(blockMapSequence, NULL);
+}
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * SRAM page cache - see cache.h
+ */
+
+#include "arena.h"
+#include "cache.h"
+
+#if FEATURE_CACHE
+
+struct CacheTag {
+  const MemoryDriver* driver;  // NULL if the line is empty
+  byte unit;
+  unsigned long address;       // First byte of the line
+  unsigned int filled;         // Bytes read from the chip so far
+  unsigned long lastUse;
+};
+
+static CacheTag tags[PAGE_CACHE_LINES];
+static unsigned long useClock;
+static unsigned long hits;
+static unsigned long misses;
+static unsigned long prefetched;
+
+bool cacheFits(unsigned long address, unsigned long length) {
+  unsigned long first = address / PAGE_CACHE_LINE_SIZE;
+  unsigned long last = (address + length - 1) / PAGE_CACHE_LINE_SIZE;
+  return length > 0 && last - first < PAGE_CACHE_LINES;
+}
+
+// The line holding address; NO_LINE if it is not cached
+#define NO_LINE  0xFF
+
+static byte findLine(const MemoryDevice& dev, unsigned long lineAddress) {
+  for (byte i = 0; i < PAGE_CACHE_LINES; i++) {
+    const CacheTag& tag = tags[i];
+    if (tag.driver == dev.driver && tag.unit == dev.unit && tag.address == lineAddress) {
+      return i;
+    }
+  }
+  return NO_LINE;
+}
+
+// Take over an empty or the least recently used line
+static byte claimLine(const MemoryDevice& dev, unsigned long lineAddress) {
+  byte victim = 0;
+  for (byte i = 1; i < PAGE_CACHE_LINES; i++) {
+    const CacheTag& tag = tags[i];
+    if (tags[victim].driver != NULL && (tag.driver == NULL || tag.lastUse < tags[victim].lastUse)) {
+      victim = i;
+    }
+  }
+
+  CacheTag& tag = tags[victim];
+  tag.driver = dev.driver;
+  tag.unit = dev.unit;
+  tag.address = lineAddress;
+  tag.filled = 0;
+  tag.lastUse = ++useClock;
+  return victim;
+}
+
+// Read the rest of a line; a line the chip could not fill at once is
+// completed on the next call
+static bool fillLine(byte index, CacheFetch fetch) {
+  CacheTag& tag = tags[index];
+  while (tag.filled < PAGE_CACHE_LINE_SIZE) {
+    unsigned int count = fetch(tag.address + tag.filled, arena.cache[index] + tag.filled, PAGE_CACHE_LINE_SIZE - tag.filled);
+    if (count == 0) {
+      return false;
+    }
+    tag.filled += count;
+  }
+  return true;
+}
+
+static unsigned int copyLine(byte index, unsigned long address, byte* buffer, unsigned int len) {
+  CacheTag& tag = tags[index];
+  tag.lastUse = ++useClock;
+  unsigned int offset = address - tag.address;
+  len = min(len, (unsigned int)(PAGE_CACHE_LINE_SIZE - offset));
+  memcpy(buffer, arena.cache[index] + offset, len);
+  return len;
+}
+
+unsigned int cacheRead(const MemoryDevice& dev, unsigned long address, byte* buffer, unsigned int len, CacheFetch fetch) {
+  unsigned long lineAddress = address - address % PAGE_CACHE_LINE_SIZE;
+  byte index = findLine(dev, lineAddress);
+
+  if (index == NO_LINE) {
+    index = claimLine(dev, lineAddress);
+    misses++;
+  } else if (tags[index].filled == PAGE_CACHE_LINE_SIZE) {
+    hits++;
+  }
+
+  if (!fillLine(index, fetch)) {
+    return 0;
+  }
+  return copyLine(index, address, buffer, len);
+}
+
+unsigned int cachePeek(const MemoryDevice& dev, unsigned long address, byte* buffer, unsigned int len) {
+  byte index = findLine(dev, address - address % PAGE_CACHE_LINE_SIZE);
+  if (index == NO_LINE || tags[index].filled < PAGE_CACHE_LINE_SIZE) {
+    return 0;
+  }
+  hits++;
+  return copyLine(index, address, buffer, len);
+}
+
+bool cachePrefetch(const MemoryDevice& dev, unsigned long address, CacheFetch fetch) {
+  // Lines already here are renewed too, so the nearest is evicted last
+  byte index = findLine(dev, address);
+  if (index == NO_LINE) {
+    index = claimLine(dev, address);
+    prefetched++;
+  } else {
+    tags[index].lastUse = ++useClock;
+  }
+  return fillLine(index, fetch);
+}
+
+void cacheInvalidate(unsigned long address, unsigned long length) {
+  for (byte i = 0; i < PAGE_CACHE_LINES; i++) {
+    CacheTag& tag = tags[i];
+    if (tag.driver != NULL && tag.address < address + length && address < tag.address + PAGE_CACHE_LINE_SIZE) {
+      tag.driver = NULL;
+    }
+  }
+}
+
+void cacheClear() {
+  for (byte i = 0; i < PAGE_CACHE_LINES; i++) {
+    tags[i].driver = NULL;
+  }
+}
+
+void printCacheStats() {
+  byte used = 0;
+  for (byte i = 0; i < PAGE_CACHE_LINES; i++) {
+    if (tags[i].driver != NULL) {
+      used++;
+    }
+  }
+
+  Serial.print(F("Page cache: "));
+  Serial.print(hits);
+  Serial.print(F(" hits, "));
+  Serial.print(misses);
+  Serial.print(F(" misses, "));
+  Serial.print(prefetched);
+  Serial.print(F(" read ahead, "));
+  Serial.print(used);
+  Serial.print(F(" of "));
+  Serial.print(PAGE_CACHE_LINES);
+  Serial.print(F(" lines of "));
+  Serial.print(PAGE_CACHE_LINE_SIZE);
+  Serial.println(F(" bytes in use"));
+
+  hits = 0;
+  misses = 0;
+  prefetched = 0;
+}
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * Job checkpoints - see checkpoint.h
+ */
+
+#include <avr/eeprom.h>
+#include "checkpoint.h"
+#include "crc.h"
+
+#if FEATURE_CHECKPOINT
+
+#define CHECKPOINT_MAGIC  0x4A43  // "CJ"
+
+// EEPROM image; the magic also tells records of other firmware apart
+struct CheckpointRecord {
+  uint16_t magic;
+  JobCheckpoint checkpoint;
+};
+
+static_assert(sizeof(CheckpointRecord) <= CHECKPOINT_EEPROM_SIZE, "Checkpoint does not fit its EEPROM area");
+
+JobCheckpoint checkpoint;
+bool checkpointPersist = CHECKPOINT_PERSIST;
+
+static unsigned long lastSaved;  // checkpoint.done when last written to EEPROM
+
+static void saveCheckpoint() {
+  if (!checkpointPersist) {
+    return;
+  }
+
+  // Only changed bytes are written, which keeps EEPROM wear low
+  CheckpointRecord record;
+  record.magic = CHECKPOINT_MAGIC;
+  record.checkpoint = checkpoint;
+  eeprom_update_block(&record, (void*) CHECKPOINT_EEPROM_ADDR, sizeof(record));
+  lastSaved = checkpoint.done;
+}
+
+// A record written by a build with other drivers must not be trusted
+static bool knownDriver(const MemoryDriver* driver) {
+  #if FEATURE_NAND
+  if (driver == &nandDriver) return true;
+  #endif
+  #if FEATURE_SPI
+  if (driver == &spiDriver) return true;
+  #endif
+  #if FEATURE_I2C
+  if (driver == &i2cDriver) return true;
+  #endif
+  return false;
+}
+
+bool checkpointRestore() {
+  CheckpointRecord record;
+  eeprom_read_block(&record, (const void*) CHECKPOINT_EEPROM_ADDR, sizeof(record));
+
+  if (record.magic != CHECKPOINT_MAGIC || record.checkpoint.op == OP_NONE ||
+      record.checkpoint.op > OP_VERIFY || !knownDriver(record.checkpoint.dev.driver)) {
+    return false;
+  }
+
+  checkpoint = record.checkpoint;
+  return true;
+}
+
+void checkpointBegin(byte op, const MemoryDevice& dev, unsigned long start, unsigned long length) {
+  checkpoint.op = op;
+  checkpoint.finished = false;
+  checkpoint.dev = dev;
+  checkpoint.start = start;
+  checkpoint.length = length;
+  checkpoint.done = 0;
+  checkpoint.crc = 0;
+  lastSaved = 0;
+  saveCheckpoint();
+}
+
+void checkpointAdvance(const byte* data, unsigned int len) {
+  checkpoint.crc = crc32(checkpoint.crc, data, len);
+  checkpoint.done += len;
+}
+
+bool checkpointSyncDue() {
+  return checkpointPersist && checkpoint.done - lastSaved >= CHECKPOINT_SAVE_INTERVAL;
+}
+
+void checkpointSync() {
+  if (checkpointSyncDue()) {
+    saveCheckpoint();
+  }
+}
+
+void checkpointEnd() {
+  checkpoint.finished = (checkpoint.done == checkpoint.length);
+  saveCheckpoint();
+}
+
+void printCheckpoint() {
+  if (checkpoint.op == OP_NONE) {
+    Serial.println(F("No job checkpoint"));
+    return;
+  }
+
+  Serial.print(F("Job: "));
+  switch (checkpoint.op) {
+    case OP_READ:    Serial.print(F("read")); break;
+    case OP_PROGRAM: Serial.print(F("program")); break;
+    case OP_DIFF:    Serial.print(F("diff-program")); break;
+    case OP_VERIFY:  Serial.print(F("verify")); break;
+  }
+  Serial.print(F(" on "));
+  Serial.print((const __FlashStringHelper*) pgm_read_ptr(&checkpoint.dev.driver->name));
+  Serial.print(F(" at 0x"));
+  Serial.print(checkpoint.start, HEX);
+  Serial.print(F(", "));
+  Serial.print(checkpoint.length);
+  Serial.println(F(" bytes"));
+
+  Serial.print(F("Completed: "));
+  Serial.print(checkpoint.done);
+  Serial.print(F(" bytes, CRC32 0x"));
+  Serial.print(checkpoint.crc, HEX);
+  Serial.println(checkpoint.finished ? F(" (finished)") : F(" (interrupted)"));
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * On-device cloning - see clone.h
+ */
+
+#include "arena.h"
+#include "clone.h"
+#include "engine.h"
+#include "scheduler.h"
+
+#if FEATURE_CLONE
+
+// The engine job that is running
+enum CloneStage {
+  CLONE_START,
+  CLONE_ERASING,
+  CLONE_PROGRAMMING,
+  CLONE_CHECKING  // Reading back the target's CRC
+};
+
+static CloneJob& clone = arena.job.clone;
+
+static void cloneCancel() {
+  engineSetQuiet(false);
+  DRIVER(clone.source, release)(clone.source.unit);
+}
+
+static bool finishClone(bool passed) {
+  cloneCancel();
+
+  if (passed) {
+    Serial.print(F("Clone OK, "));
+    Serial.print(clone.length);
+    Serial.print(F(" bytes in "));
+    Serial.print(millis() - clone.startTime);
+    Serial.print(F(" ms, CRC 0x"));
+    Serial.println(engineDataCrc(), HEX);
+  } else {
+    Serial.print(F("Clone failed while "));
+    switch (clone.stage) {
+      case CLONE_ERASING:     Serial.println(F("erasing")); break;
+      case CLONE_PROGRAMMING: Serial.println(F("programming")); break;
+      default:                Serial.println(F("checking")); break;
+    }
+  }
+  return true;
+}
+
+static bool cloneSequence() {
+  if (clone.stage != CLONE_START && !engineSucceeded()) {
+    return finishClone(false);
+  }
+
+  switch (clone.stage) {
+    case CLONE_START: {
+      Geometry geo;
+      DRIVER(clone.target, geometry)(clone.target.unit, geo);
+      if (geo.flags & GEO_NEEDS_ERASE) {
+        engineErase(clone.target, clone.address, clone.length);
+        clone.stage = CLONE_ERASING;
+        return false;
+      }
+    }
+    // EEPROMs are written without an erase
+    // fall through
+
+    case CLONE_ERASING:
+      setDeviceSource(clone.source, clone.address);
+      engineWrite(clone.target, clone.address, clone.length, deviceSource, WRITE_PROGRAM);
+      clone.stage = CLONE_PROGRAMMING;
+      return false;
+
+    case CLONE_PROGRAMMING:
+      crcSinkBegin();
+      engineRead(clone.target, clone.address, clone.length, crcSink);
+      clone.stage = CLONE_CHECKING;
+      return false;
+  }
+
+  if (crcSinkValue() != engineDataCrc()) {
+    Serial.print(F("CRC 0x"));
+    Serial.print(crcSinkValue(), HEX);
+    Serial.print(F(", source 0x"));
+    Serial.println(engineDataCrc(), HEX);
+    return finishClone(false);
+  }
+  return finishClone(true);
+}
+
+void cloneRun(const MemoryDevice& source, const MemoryDevice& target, unsigned long address, unsigned long length) {
+  clone.source = source;
+  clone.target = target;
+  clone.address = address;
+  clone.length = length;
+  clone.stage = CLONE_START;
+  clone.startTime = millis();
+
+  Serial.println(F("Cloning..."));
+  DRIVER(target, begin)(target.unit);
+  engineSetQuiet(true);
+  startSequence(cloneSequence, cloneCancel);
+}
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * I2C EEPROM driver (24-series)
+ *
+ * Parts up to 2KB take one address byte and put the high address bits in
+ * the device address; larger parts take two address bytes.
+ */
+
+#include <Wire.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_I2C
+
+#define I2C_WIRE_CHUNK   16    // Data bytes per Wire transaction (32-byte buffer)
+#define I2C_ERASE_SECTOR 256   // "Sector" and "block" erase sizes for EEPROM
+#define I2C_ERASE_BLOCK  4096
+#define I2C_T_WR_US      5000    // Page write cycle (24C256 datasheet maximum)
+#define I2C_BYTE_NS      100000  // Nine bits at 100kHz plus the TWI interrupt
+
+unsigned long i2cEepromSize = 32UL * 1024;  // 24C256
+
+static bool writePending = false;
+static unsigned long deadline = 0;
+static unsigned long streamNext = 0xFFFFFFFF;  // EEPROM's internal address pointer
+static byte streamUnit = 0;                    // EEPROM that streamNext belongs to
+
+// Device address, including high address bits for small or very large parts
+static byte i2cDeviceAddress(byte unit, unsigned long address) {
+  if (i2cEepromSize <= 2048) {
+    return unit | ((address >> 8) & 0x07);
+  }
+  if (i2cEepromSize > 65536) {
+    return unit | ((address >> 16) & 0x07);
+  }
+  return unit;
+}
+
+static void i2cSendAddress(byte unit, unsigned long address) {
+  Wire.beginTransmission(i2cDeviceAddress(unit, address));
+
+  if (i2cEepromSize > 2048) {
+    Wire.write((address >> 8) & 0xFF); // MSB
+  }
+  Wire.write(address & 0xFF); // LSB
+}
+
+static unsigned int i2cPageSize() {
+  // EEPROM page size grows with capacity (8 bytes on 24C02, 64 on 24C256)
+  unsigned int pageSize;
+  if (i2cEepromSize <= 256) pageSize = 8;
+  else if (i2cEepromSize <= 2048) pageSize = 16;
+  else if (i2cEepromSize <= 8192) pageSize = 32;
+  else if (i2cEepromSize <= 32768) pageSize = 64;
+  else if (i2cEepromSize <= 65536) pageSize = 128;
+  else pageSize = 256;
+
+  // Writes are limited by the Wire buffer
+  return min(pageSize, (unsigned int)I2C_WIRE_CHUNK);
+}
+
+static void i2cBegin(byte unit) {
+  writePending = false;
+  streamNext = 0xFFFFFFFF;
+}
+
+static byte i2cReadID(byte unit, byte* id, byte maxLen) {
+  // 24-series EEPROMs have no ID
+  return 0;
+}
+
+static void i2cDetect(byte unit) {
+  Serial.println(F("Scanning I2C bus for devices..."));
+
+  byte count = 0;
+  for (byte addr = 0x08; addr < 0x78; addr++) {
+    Wire.beginTransmission(addr);
+    byte error = Wire.endTransmission();
+
+    if (error == 0) {
+      Serial.print(F("Device found at address 0x"));
+      if (addr < 16) Serial.print("0");
+      Serial.print(addr, HEX);
+
+      // Check if it's likely an EEPROM (most common at 0x50-0x57)
+      if (addr >= 0x50 && addr <= 0x57) {
+        Serial.println(F(" (likely EEPROM)"));
+      } else {
+        Serial.println();
+      }
+      count++;
+    }
+  }
+
+  if (count == 0) {
+    Serial.println(F("No I2C devices found!"));
+  }
+}
+
+static unsigned int i2cReadStream(byte unit, unsigned long address, byte* buffer, unsigned int len) {
+  byte bytesToRead = min(len, (unsigned int)I2C_WIRE_CHUNK);
+
+  // Sequential reads continue from the EEPROM's address pointer
+  if (address != streamNext || unit != streamUnit) {
+    i2cSendAddress(unit, address);
+    Wire.endTransmission();
+  }
+
+  Wire.requestFrom(i2cDeviceAddress(unit, address), bytesToRead);
+
+  for (byte i = 0; i < bytesToRead; i++) {
+    buffer[i] = Wire.available() ? Wire.read() : 0xFF;
+  }
+
+  streamNext = address + bytesToRead;
+  streamUnit = unit;
+  return bytesToRead;
+}
+
+static void i2cProgramPage(byte unit, unsigned long address, const byte* data, unsigned int len) {
+  i2cSendAddress(unit, address);
+
+  // Write data bytes
+  for (unsigned int i = 0; i < len; i++) {
+    Wire.write(data ? data[i] : 0xFF);
+  }
+
+  // Send data to device; the write cycle (typically 5ms) is polled
+  Wire.endTransmission();
+
+  streamNext = 0xFFFFFFFF;
+  writePending = true;
+  deadline = millis() + I2C_WRITE_TIMEOUT_MS;
+}
+
+static unsigned long i2cEraseRange(byte unit, unsigned long address, unsigned long length) {
+  // EEPROMs need no erase; a page of the range is filled with 0xFF
+  unsigned int pageSize = i2cPageSize();
+  unsigned int count = min((unsigned long)(pageSize - address % pageSize), length);
+
+  i2cProgramPage(unit, address, NULL, count);
+  return count;
+}
+
+static PollResult i2cPoll(byte unit) {
+  // The EEPROM does not acknowledge its address during the write cycle
+  Wire.beginTransmission(unit);
+  if (Wire.endTransmission() == 0) {
+    writePending = false;
+    return POLL_DONE;
+  }
+
+  if (writePending && (long)(millis() - deadline) < 0) {
+    return POLL_BUSY;
+  }
+
+  writePending = false;
+  return POLL_FAILED;
+}
+
+static void i2cRelease(byte unit) {
+  streamNext = 0xFFFFFFFF;
+}
+
+static void i2cGeometry(byte unit, Geometry& geo) {
+  geo.capacity = i2cEepromSize;
+  geo.pageSize = i2cPageSize();
+  geo.eraseSize = I2C_ERASE_SECTOR;
+  geo.blockSize = I2C_ERASE_BLOCK;
+  geo.flags = 0;
+}
+
+// Erasing writes 0xFF pages, so it costs what programming does
+static void i2cTiming(byte unit, ChipTiming& t) {
+  t.programUs = I2C_T_WR_US;
+  t.eraseUs = 0;
+  t.blockEraseUs = 0;
+  t.byteNs = I2C_BYTE_NS;
+}
+
+static void i2cStatus(byte unit) {
+  // For I2C EEPROMs, there's typically no status register to read
+  // Instead, we check if the device responds
+  Wire.beginTransmission(unit);
+  byte error = Wire.endTransmission();
+
+  Serial.print(F("Device present: "));
+  Serial.println((error == 0) ? "Yes" : "No");
+
+  if (error == 0) {
+    // Try to address location 0 to see if the device is busy
+    // When busy with internal write cycle, the device won't ACK
+    i2cSendAddress(unit, 0);
+    error = Wire.endTransmission();
+    streamNext = (error == 0) ? 0 : 0xFFFFFFFF;
+
+    Serial.print(F("Device ready: "));
+    Serial.println((error == 0) ? "Yes" : "No");
+  }
+}
+
+static bool i2cWriteStatus(byte unit, byte value) {
+  // 24-series parts are protected by the WP pin only
+  return false;
+}
+
+static const char i2cName[] PROGMEM = "I2C EEPROM";
+
+const MemoryDriver i2cDriver PROGMEM = {
+  i2cName,
+  i2cBegin,
+  i2cReadID,
+  i2cDetect,
+  i2cReadStream,
+  i2cProgramPage,
+  i2cEraseRange,
+  i2cPoll,
+  i2cRelease,
+  i2cGeometry,
+  i2cStatus,
+  i2cWriteStatus,
+  i2cTiming
+};
+
+#endif
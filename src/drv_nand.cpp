@@ -0,0 +1,372 @@
+/**
+ * Parallel NAND flash driver
+ *
+ * Data bus: D2-D7 carry bits 0-5, D8-D9 carry bits 6-7.
+ * Basic implementation for small page NAND; for modern NAND, more complex
+ * ECC would be needed.
+ */
+
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_NAND
+
+// Common NAND commands
+#define NAND_CMD_READ_ID          0x90
+#define NAND_CMD_READ_STATUS      0x70
+#define NAND_CMD_READ             0x00
+#define NAND_CMD_READ_CONFIRM     0x30
+#define NAND_CMD_PROGRAM          0x80
+#define NAND_CMD_PROGRAM_CONFIRM  0x10
+#define NAND_CMD_ERASE            0x60
+#define NAND_CMD_ERASE_CONFIRM    0xD0
+#define NAND_CMD_RESET            0xFF
+
+#define NAND_PAGE_SIZE            512          // Adjust based on your NAND flash
+#define NAND_PARTIAL_PROGRAMS     2            // NOP: programs per page between erases
+#define NAND_BLOCK_SIZE           (16 * 1024)  // 16KB blocks, adjust as needed
+#define NAND_DEFAULT_CAPACITY     (32UL * 1024 * 1024)
+
+// Typical small-page timings (K9F5608 datasheet); the bus is bit-banged
+#define NAND_T_PROG_US            200
+#define NAND_T_BERS_US            2000
+#define NAND_BYTE_NS              10000
+
+// The write engine programs at most one page buffer at a time, so a page
+// takes several programs; a retry would need one more than the chip allows
+static_assert((NAND_PAGE_SIZE + PAGE_BUFFER_SIZE - 1) / PAGE_BUFFER_SIZE <= NAND_PARTIAL_PROGRAMS,
+              "Page buffers split a NAND page into more programs than NAND_PARTIAL_PROGRAMS");
+
+// Operation awaiting R/B
+enum NandPending {
+  NAND_IDLE,
+  NAND_READING,   // tR: page moving into the data register
+  NAND_PROGRAM,   // tPROG / tBERS: status byte decides the result
+  NAND_RESET
+};
+
+static byte pending = NAND_IDLE;
+static unsigned long deadline = 0;
+static bool streamOpen = false;        // Data register holds streamPage
+static unsigned long streamPage = 0;
+static unsigned int streamColumn = 0;  // Next column the register will output
+
+static byte nandReadByte() {
+  // Configure Arduino pins as inputs for reading data
+  DDRD &= 0x03; // Set pins 2-7 as inputs (D2-D7)
+  DDRB &= 0xFC; // Set pins 8-9 as inputs (D8-D9)
+
+  // Assert read enable
+  digitalWrite(NAND_RE_PIN, LOW);
+  delayMicroseconds(1);
+
+  // Read data from pins
+  byte data = 0;
+  data |= ((PIND >> 2) & 0x3F);    // Bits 0-5 from pins D2-D7
+  data |= ((PINB & 0x03) << 6);    // Bits 6-7 from pins D8-D9
+
+  // De-assert read enable
+  digitalWrite(NAND_RE_PIN, HIGH);
+  delayMicroseconds(1);
+
+  return data;
+}
+
+static void nandWriteByte(byte data) {
+  // Configure Arduino pins as outputs for writing data
+  DDRD |= 0xFC; // Set pins 2-7 as outputs (D2-D7)
+  DDRB |= 0x03; // Set pins 8-9 as outputs (D8-D9)
+
+  // Output data to pins
+  PORTD = (PORTD & 0x03) | ((data & 0x3F) << 2); // Bits 0-5 to pins D2-D7
+  PORTB = (PORTB & 0xFC) | ((data >> 6) & 0x03); // Bits 6-7 to pins D8-D9
+
+  // Assert write enable
+  digitalWrite(NAND_WE_PIN, LOW);
+  delayMicroseconds(1);
+
+  // De-assert write enable
+  digitalWrite(NAND_WE_PIN, HIGH);
+  delayMicroseconds(1);
+}
+
+static void nandCommand(byte cmd) {
+  digitalWrite(NAND_CLE_PIN, HIGH);
+  nandWriteByte(cmd);
+  digitalWrite(NAND_CLE_PIN, LOW);
+}
+
+// Send column and row address bytes
+static void nandAddress(unsigned int column, unsigned long page) {
+  digitalWrite(NAND_ALE_PIN, HIGH);
+  nandWriteByte(column & 0xFF);        // Column address low byte
+  nandWriteByte((column >> 8) & 0xFF); // Column address high byte (if needed)
+  nandWriteByte(page & 0xFF);          // Page address low byte
+  nandWriteByte((page >> 8) & 0xFF);   // Page address high byte
+  nandWriteByte((page >> 16) & 0xFF);  // Page address highest byte (if needed)
+  digitalWrite(NAND_ALE_PIN, LOW);
+}
+
+// Start waiting for R/B after a command
+static void nandStartBusy(byte operation) {
+  pending = operation;
+  deadline = millis() + NAND_TIMEOUT_MS;
+}
+
+// True while R/B is low and the deadline has not passed
+static bool nandBusy() {
+  if (digitalRead(NAND_RB_PIN) == HIGH) {
+    return false;
+  }
+
+  if ((long)(millis() - deadline) < 0) {
+    return true;
+  }
+
+  Serial.println(F("Warning: NAND Flash timeout"));
+  return false;
+}
+
+static void nandBegin(byte unit) {
+  streamOpen = false;
+
+  // Select the chip and send RESET
+  digitalWrite(NAND_CE_PIN, LOW);
+  nandCommand(NAND_CMD_RESET);
+  nandStartBusy(NAND_RESET);
+}
+
+static byte nandReadID(byte unit, byte* id, byte maxLen) {
+  streamOpen = false;
+
+  // Select the chip
+  digitalWrite(NAND_CE_PIN, LOW);
+
+  // Send READ ID command (0x90) and address 0x00
+  nandCommand(NAND_CMD_READ_ID);
+  digitalWrite(NAND_ALE_PIN, HIGH);
+  nandWriteByte(0x00);
+  digitalWrite(NAND_ALE_PIN, LOW);
+
+  // Read ID bytes (typically 5 bytes)
+  byte count = min(maxLen, (byte)5);
+  for (byte i = 0; i < count; i++) {
+    id[i] = nandReadByte();
+  }
+
+  // Deselect the chip
+  digitalWrite(NAND_CE_PIN, HIGH);
+  return count;
+}
+
+static void nandIdentify(byte unit) {
+  byte id[5];
+  nandReadID(unit, id, sizeof(id));
+
+  Serial.print(F("Manufacturer ID: 0x"));
+  Serial.println(id[0], HEX);
+
+  Serial.print(F("Device ID: 0x"));
+  Serial.println(id[1], HEX);
+
+  Serial.print(F("Third ID byte: 0x"));
+  Serial.println(id[2], HEX);
+
+  Serial.print(F("Fourth ID byte: 0x"));
+  Serial.println(id[3], HEX);
+
+  Serial.print(F("Fifth ID byte: 0x"));
+  Serial.println(id[4], HEX);
+}
+
+static unsigned int nandReadStream(byte unit, unsigned long address, byte* buffer, unsigned int len) {
+  unsigned long page = address / NAND_PAGE_SIZE;
+  unsigned int column = address % NAND_PAGE_SIZE;
+
+  if (pending == NAND_READING) {
+    // Wait for the page to be transferred to the data register
+    if (nandBusy()) {
+      return 0;
+    }
+    pending = NAND_IDLE;
+  } else if (!streamOpen || streamPage != page || streamColumn != column) {
+    // Reads crossing into another page need a new READ cycle
+    digitalWrite(NAND_CE_PIN, LOW);
+    nandCommand(NAND_CMD_READ);
+    nandAddress(column, page);
+    nandCommand(NAND_CMD_READ_CONFIRM);
+
+    streamOpen = true;
+    streamPage = page;
+    streamColumn = column;
+    nandStartBusy(NAND_READING);
+    return 0;
+  }
+
+  // The data register only covers the current page
+  unsigned int count = min(len, (unsigned int)(NAND_PAGE_SIZE - column));
+  for (unsigned int i = 0; i < count; i++) {
+    buffer[i] = nandReadByte();
+  }
+
+  streamColumn += count;
+  if (streamColumn == NAND_PAGE_SIZE) {
+    streamOpen = false;
+  }
+  return count;
+}
+
+static void nandProgramPage(byte unit, unsigned long address, const byte* data, unsigned int len) {
+  streamOpen = false;
+
+  // Select the chip and send PROGRAM command with address
+  digitalWrite(NAND_CE_PIN, LOW);
+  nandCommand(NAND_CMD_PROGRAM);
+  nandAddress(address % NAND_PAGE_SIZE, address / NAND_PAGE_SIZE);
+
+  // Write data
+  for (unsigned int i = 0; i < len; i++) {
+    nandWriteByte(data[i]);
+  }
+
+  // Send PROGRAM confirm command
+  nandCommand(NAND_CMD_PROGRAM_CONFIRM);
+  nandStartBusy(NAND_PROGRAM);
+}
+
+static unsigned long nandEraseRange(byte unit, unsigned long address, unsigned long length) {
+  streamOpen = false;
+
+  // For NAND, we erase blocks (no sector erase); the row address is the
+  // first page of the block
+  unsigned long page = (address / NAND_BLOCK_SIZE) * (NAND_BLOCK_SIZE / NAND_PAGE_SIZE);
+
+  digitalWrite(NAND_CE_PIN, LOW);
+  nandCommand(NAND_CMD_ERASE);
+
+  digitalWrite(NAND_ALE_PIN, HIGH);
+  nandWriteByte(page & 0xFF);          // Page address low byte
+  nandWriteByte((page >> 8) & 0xFF);   // Page address high byte
+  nandWriteByte((page >> 16) & 0xFF);  // Page address highest byte (if needed)
+  digitalWrite(NAND_ALE_PIN, LOW);
+
+  nandCommand(NAND_CMD_ERASE_CONFIRM);
+  nandStartBusy(NAND_PROGRAM);
+
+  return NAND_BLOCK_SIZE - (address % NAND_BLOCK_SIZE);
+}
+
+static PollResult nandPoll(byte unit) {
+  if (pending == NAND_IDLE) {
+    return POLL_DONE;
+  }
+
+  if (nandBusy()) {
+    return POLL_BUSY;
+  }
+
+  byte operation = pending;
+  pending = NAND_IDLE;
+
+  if (operation == NAND_READING) {
+    // Data register loaded; the stream stays selected
+    return POLL_DONE;
+  }
+
+  if (operation == NAND_RESET) {
+    digitalWrite(NAND_CE_PIN, HIGH);
+    return POLL_DONE;
+  }
+
+  // Check program/erase status (bit 0 should be 0)
+  nandCommand(NAND_CMD_READ_STATUS);
+  byte status = nandReadByte();
+
+  // Deselect the chip
+  digitalWrite(NAND_CE_PIN, HIGH);
+  return (status & 0x01) ? POLL_FAILED : POLL_DONE;
+}
+
+static void nandRelease(byte unit) {
+  streamOpen = false;
+  pending = NAND_IDLE;
+  digitalWrite(NAND_CE_PIN, HIGH);
+}
+
+static void nandGeometry(byte unit, Geometry& geo) {
+  byte id[2];
+  nandReadID(unit, id, sizeof(id));
+
+  // Small page device codes
+  switch (id[1]) {
+    case 0x73: geo.capacity = 16UL * 1024 * 1024; break;
+    case 0x75: geo.capacity = 32UL * 1024 * 1024; break;
+    case 0x76: geo.capacity = 64UL * 1024 * 1024; break;
+    case 0x79: geo.capacity = 128UL * 1024 * 1024; break;
+    default:   geo.capacity = NAND_DEFAULT_CAPACITY;
+  }
+
+  geo.pageSize = NAND_PAGE_SIZE;
+  geo.eraseSize = NAND_BLOCK_SIZE;
+  geo.blockSize = NAND_BLOCK_SIZE;
+  geo.flags = GEO_NEEDS_ERASE | GEO_PROGRAM_ONCE;  // Page buffer halves use both partial programs
+}
+
+static void nandTiming(byte unit, ChipTiming& t) {
+  t.programUs = NAND_T_PROG_US;
+  t.eraseUs = NAND_T_BERS_US;
+  t.blockEraseUs = NAND_T_BERS_US;
+  t.byteNs = NAND_BYTE_NS;
+}
+
+static void nandStatus(byte unit) {
+  streamOpen = false;
+
+  // Select the chip
+  digitalWrite(NAND_CE_PIN, LOW);
+
+  // Send READ STATUS command and read status byte
+  nandCommand(NAND_CMD_READ_STATUS);
+  byte status = nandReadByte();
+
+  // Deselect the chip
+  digitalWrite(NAND_CE_PIN, HIGH);
+
+  // Display status information
+  Serial.print(F("Status: 0x"));
+  Serial.println(status, HEX);
+
+  Serial.print(F("Program/Erase Failed: "));
+  Serial.println((status & 0x01) ? "Yes" : "No");
+
+  Serial.print(F("Ready/Busy: "));
+  Serial.println((status & 0x40) ? "Ready" : "Busy");
+
+  Serial.print(F("Write Protected: "));
+  Serial.println((status & 0x80) ? "Yes" : "No");
+}
+
+static bool nandWriteStatus(byte unit, byte value) {
+  // Protection is controlled by the WP# pin
+  return false;
+}
+
+static const char nandName[] PROGMEM = "NAND Flash";
+
+const MemoryDriver nandDriver PROGMEM = {
+  nandName,
+  nandBegin,
+  nandReadID,
+  nandIdentify,
+  nandReadStream,
+  nandProgramPage,
+  nandEraseRange,
+  nandPoll,
+  nandRelease,
+  nandGeometry,
+  nandStatus,
+  nandWriteStatus,
+  nandTiming
+};
+
+#endif
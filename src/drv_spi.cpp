@@ -0,0 +1,459 @@
+/**
+ * SPI NOR flash driver (25-series command set)
+ */
+
+#include <SPI.h>
+#include "config.h"
+#include "driver.h"
+
+#if FEATURE_SPI
+
+// Commands for SPI Flash
+#define SPI_CMD_WRITE_ENABLE      0x06
+#define SPI_CMD_WRITE_DISABLE     0x04
+#define SPI_CMD_READ_STATUS       0x05
+#define SPI_CMD_WRITE_STATUS      0x01
+#define SPI_CMD_READ_DATA         0x03
+#define SPI_CMD_FAST_READ         0x0B
+#define SPI_CMD_PAGE_PROGRAM      0x02
+#define SPI_CMD_SECTOR_ERASE      0x20
+#define SPI_CMD_BLOCK_ERASE_32K   0x52
+#define SPI_CMD_BLOCK_ERASE_64K   0xD8
+#define SPI_CMD_CHIP_ERASE        0xC7
+#define SPI_CMD_READ_ID           0x9F
+
+#define SPI_PAGE_SIZE             256
+#define SPI_DEFAULT_CAPACITY      (16UL * 1024 * 1024)  // Full 24-bit address space
+
+// Typical 25-series timings (W25Q80 datasheet) and an 8-bit transfer at
+// SCK = 4MHz plus the loop around it
+#define SPI_T_PP_US               700
+#define SPI_T_SE_US               45000UL
+#define SPI_T_BE_US               150000UL
+#define SPI_BYTE_NS               2700
+
+// An open FAST READ keeps CS low so sequential reads skip the command phase
+static byte streamPin = 0;
+static unsigned long streamNext = 0;
+
+static void spiEndStream() {
+  if (streamPin != 0) {
+    digitalWrite(streamPin, HIGH);
+    streamPin = 0;
+  }
+}
+
+// Select the chip and send a command with a 24-bit address (MSB first)
+static void spiCommand(byte cs, byte cmd, unsigned long address) {
+  spiEndStream();
+  digitalWrite(cs, LOW);
+  SPI.transfer(cmd);
+  SPI.transfer((address >> 16) & 0xFF);
+  SPI.transfer((address >> 8) & 0xFF);
+  SPI.transfer(address & 0xFF);
+}
+
+static void spiWriteEnable(byte cs) {
+  // Latched on the rising edge of CS
+  spiEndStream();
+  digitalWrite(cs, LOW);
+  SPI.transfer(SPI_CMD_WRITE_ENABLE);
+  digitalWrite(cs, HIGH);
+}
+
+static byte spiReadStatusRegister(byte cs) {
+  spiEndStream();
+  digitalWrite(cs, LOW);
+  SPI.transfer(SPI_CMD_READ_STATUS);
+  byte status = SPI.transfer(0);
+  digitalWrite(cs, HIGH);
+  return status;
+}
+
+static void spiBegin(byte cs) {
+  pinMode(cs, OUTPUT);
+  digitalWrite(cs, HIGH);
+}
+
+static byte spiReadID(byte cs, byte* id, byte maxLen) {
+  spiEndStream();
+  digitalWrite(cs, LOW);
+  SPI.transfer(SPI_CMD_READ_ID);  // JEDEC ID command
+
+  byte count = min(maxLen, (byte)3);
+  for (byte i = 0; i < count; i++) {
+    id[i] = SPI.transfer(0);
+  }
+
+  digitalWrite(cs, HIGH);
+  return count;
+}
+
+static void identifySPIFlash(byte manufacturerID, byte deviceID1, byte deviceID2) {
+  Serial.print(F("Device: "));
+
+  switch (manufacturerID) {
+    case 0x01:  // Spansion/Cypress
+      Serial.print(F("Spansion/Cypress "));
+      break;
+    case 0x20:  // Micron/Numonyx/ST
+      Serial.print(F("Micron/ST "));
+      break;
+    case 0xEF:  // Winbond
+      Serial.print(F("Winbond "));
+      if (deviceID1 == 0x40) {
+        if (deviceID2 == 0x14) Serial.println(F("W25Q80 (8Mbit)"));
+        else if (deviceID2 == 0x15) Serial.println(F("W25Q16 (16Mbit)"));
+        else if (deviceID2 == 0x16) Serial.println(F("W25Q32 (32Mbit)"));
+        else if (deviceID2 == 0x17) Serial.println(F("W25Q64 (64Mbit)"));
+        else if (deviceID2 == 0x18) Serial.println(F("W25Q128 (128Mbit)"));
+        else Serial.println(F("Unknown W25Q series"));
+      } else {
+        Serial.println(F("Unknown model"));
+      }
+      break;
+    case 0xC2:  // Macronix
+      Serial.print(F("Macronix "));
+      break;
+    case 0xBF:  // SST
+      Serial.print(F("SST "));
+      break;
+    default:
+      Serial.println(F("Unknown manufacturer"));
+  }
+}
+
+static void spiIdentify(byte cs) {
+  byte id[3];
+  spiReadID(cs, id, sizeof(id));
+
+  Serial.print(F("Manufacturer ID: 0x"));
+  Serial.println(id[0], HEX);
+
+  Serial.print(F("Device ID: 0x"));
+  Serial.print(id[1], HEX);
+  Serial.println(id[2], HEX);
+
+  // Try to identify common chips
+  identifySPIFlash(id[0], id[1], id[2]);
+}
+
+static unsigned int spiReadStream(byte cs, unsigned long address, byte* buffer, unsigned int len) {
+  if (streamPin != cs || streamNext != address) {
+    // Send Fast Read command, address and dummy byte
+    spiCommand(cs, SPI_CMD_FAST_READ, address);
+    SPI.transfer(0);
+    streamPin = cs;
+  }
+
+  // MOSI content is ignored after the address, so the buffer is clocked in place
+  SPI.transfer(buffer, len);
+  streamNext = address + len;
+  return len;
+}
+
+static void spiProgramPage(byte cs, unsigned long address, const byte* data, unsigned int len) {
+  spiWriteEnable(cs);
+
+  // Send Page Program command and data
+  spiCommand(cs, SPI_CMD_PAGE_PROGRAM, address);
+  for (unsigned int i = 0; i < len; i++) {
+    SPI.transfer(data[i]);
+  }
+
+  // Programming starts when CS goes high
+  digitalWrite(cs, HIGH);
+}
+
+// Capacity from the last ID read, kept for the erases of the job that
+// asked for the geometry; release forgets it in case the chip is swapped
+static byte capacityPin = 0;
+static unsigned long capacity;
+
+static unsigned long spiCapacity(byte cs) {
+  if (capacityPin != cs) {
+    byte id[3];
+    spiReadID(cs, id, sizeof(id));
+
+    // The third JEDEC byte is log2(capacity) on most 25-series parts
+    capacity = (id[2] >= 0x10 && id[2] <= 0x18) ? (1UL << id[2]) : SPI_DEFAULT_CAPACITY;
+    capacityPin = cs;
+  }
+  return capacity;
+}
+
+static void spiGeometry(byte cs, Geometry& geo) {
+  capacityPin = 0;
+  geo.capacity = spiCapacity(cs);
+  geo.pageSize = SPI_PAGE_SIZE;
+  geo.eraseSize = 4096;
+  geo.blockSize = 65536;
+  geo.flags = GEO_NEEDS_ERASE;
+}
+
+static void spiTiming(byte cs, ChipTiming& t) {
+  t.programUs = SPI_T_PP_US;
+  t.eraseUs = SPI_T_SE_US;
+  t.blockEraseUs = SPI_T_BE_US;
+  t.byteNs = SPI_BYTE_NS;
+}
+
+// Erase on a chip of the given capacity
+static unsigned long spiEraseUnit(byte cs, unsigned long size, unsigned long address, unsigned long length) {
+  byte cmd;
+  unsigned long unit;
+
+  // Pick the largest aligned erase that stays inside the range
+  if (address == 0 && length >= size) {
+    spiWriteEnable(cs);
+    digitalWrite(cs, LOW);
+    SPI.transfer(SPI_CMD_CHIP_ERASE);
+    digitalWrite(cs, HIGH);
+    return size;
+  } else if (address % 65536 == 0 && length >= 65536) {
+    cmd = SPI_CMD_BLOCK_ERASE_64K;
+    unit = 65536;
+  } else if (address % 32768 == 0 && length >= 32768) {
+    cmd = SPI_CMD_BLOCK_ERASE_32K;
+    unit = 32768;
+  } else {
+    cmd = SPI_CMD_SECTOR_ERASE;
+    unit = 4096;
+  }
+
+  spiWriteEnable(cs);
+  spiCommand(cs, cmd, address);
+  digitalWrite(cs, HIGH);
+
+  return unit - (address % unit);
+}
+
+static unsigned long spiEraseRange(byte cs, unsigned long address, unsigned long length) {
+  return spiEraseUnit(cs, spiCapacity(cs), address, length);
+}
+
+static PollResult spiPoll(byte cs) {
+  // Busy while the WIP bit is set
+  return (spiReadStatusRegister(cs) & 0x01) ? POLL_BUSY : POLL_DONE;
+}
+
+static void spiRelease(byte cs) {
+  spiEndStream();
+  capacityPin = 0;
+}
+
+static void spiStatus(byte cs) {
+  byte status = spiReadStatusRegister(cs);
+
+  // Display status information
+  Serial.print(F("Status Register: 0x"));
+  Serial.println(status, HEX);
+
+  Serial.print(F("Busy: "));
+  Serial.println((status & 0x01) ? "Yes" : "No");
+
+  Serial.print(F("Write Enable Latch: "));
+  Serial.println((status & 0x02) ? "Enabled" : "Disabled");
+
+  Serial.print(F("Block Protection: "));
+  Serial.println((status >> 2) & 0x0F, BIN);
+
+  Serial.print(F("Write Protect Enable: "));
+  Serial.println((status & 0x80) ? "Yes" : "No");
+}
+
+static bool spiWriteStatus(byte cs, byte value) {
+  spiWriteEnable(cs);
+  digitalWrite(cs, LOW);
+  SPI.transfer(SPI_CMD_WRITE_STATUS);
+  SPI.transfer(value);
+  digitalWrite(cs, HIGH);
+  return true;
+}
+
+static const char spiName[] PROGMEM = "SPI Flash";
+
+const MemoryDriver spiDriver PROGMEM = {
+  spiName,
+  spiBegin,
+  spiReadID,
+  spiIdentify,
+  spiReadStream,
+  spiProgramPage,
+  spiEraseRange,
+  spiPoll,
+  spiRelease,
+  spiGeometry,
+  spiStatus,
+  spiWriteStatus,
+  spiTiming
+};
+
+#if FEATURE_GANG
+
+// ===== GANG =====
+
+SpiGang spiGang;
+
+static byte gangBusy;                // Chips still working on the last operation
+static unsigned long gangIssued;     // millis() when it was started on all chips
+static unsigned long gangFirstDone;  // ms the quickest chip took; 0 until one finished
+
+static bool gangHealthy(byte i) {
+  return !(spiGang.failed & (1 << i));
+}
+
+// First chip still in the gang, which answers for all of them
+static byte gangLead() {
+  for (byte i = 0; i < spiGang.count; i++) {
+    if (gangHealthy(i)) {
+      return spiGang.pins[i];
+    }
+  }
+  return spiGang.pins[0];
+}
+
+static void gangStarted() {
+  gangBusy = 0;
+  for (byte i = 0; i < spiGang.count; i++) {
+    if (gangHealthy(i)) {
+      gangBusy |= 1 << i;
+    }
+  }
+  gangIssued = millis();
+  gangFirstDone = 0;
+}
+
+static void gangBegin(byte unit) {
+  spiGang.failed = 0;
+  gangBusy = 0;
+
+  // A missing chip reads all 0s or all 1s
+  for (byte i = 0; i < spiGang.count; i++) {
+    byte id[3];
+    spiBegin(spiGang.pins[i]);
+    spiReadID(spiGang.pins[i], id, sizeof(id));
+    if (id[0] == 0x00 || id[0] == 0xFF) {
+      spiGang.failed |= 1 << i;
+    }
+  }
+}
+
+static byte gangReadID(byte unit, byte* id, byte maxLen) {
+  return spiReadID(gangLead(), id, maxLen);
+}
+
+static void gangIdentify(byte unit) {
+  for (byte i = 0; i < spiGang.count; i++) {
+    Serial.print(F("CS "));
+    Serial.print(spiGang.pins[i]);
+    Serial.println(gangHealthy(i) ? F(":") : F(": dropped"));
+    spiIdentify(spiGang.pins[i]);
+  }
+}
+
+static unsigned int gangReadStream(byte unit, unsigned long address, byte* buffer, unsigned int len) {
+  return spiReadStream(gangLead(), address, buffer, len);
+}
+
+// Each chip starts programming as soon as its page is loaded, so it works
+// while the next one is being loaded
+static void gangProgramPage(byte unit, unsigned long address, const byte* data, unsigned int len) {
+  for (byte i = 0; i < spiGang.count; i++) {
+    if (gangHealthy(i)) {
+      spiProgramPage(spiGang.pins[i], address, data, len);
+    }
+  }
+  gangStarted();
+}
+
+// The chips are identical, so the lead's capacity stands for all of them
+static unsigned long gangEraseRange(byte unit, unsigned long address, unsigned long length) {
+  unsigned long size = spiCapacity(gangLead());
+  unsigned long covered = 0;
+  for (byte i = 0; i < spiGang.count; i++) {
+    if (gangHealthy(i)) {
+      covered = spiEraseUnit(spiGang.pins[i], size, address, length);
+    }
+  }
+  gangStarted();
+  return covered;
+}
+
+// Done when every chip is; a chip still busy long after the quickest one
+// finished is dropped so the others carry on
+static PollResult gangPoll(byte unit) {
+  for (byte i = 0; i < spiGang.count; i++) {
+    if ((gangBusy & (1 << i)) && spiPoll(spiGang.pins[i]) == POLL_DONE) {
+      gangBusy &= ~(1 << i);
+      if (gangFirstDone == 0) {
+        gangFirstDone = millis() - gangIssued + 1;
+      }
+    }
+  }
+
+  if (gangBusy && gangFirstDone != 0 && millis() - gangIssued > 2 * gangFirstDone + GANG_SLACK_MS) {
+    spiGang.failed |= gangBusy;
+    gangBusy = 0;
+  }
+
+  if (gangBusy) {
+    return POLL_BUSY;
+  }
+  for (byte i = 0; i < spiGang.count; i++) {
+    if (gangHealthy(i)) {
+      return POLL_DONE;
+    }
+  }
+  return POLL_FAILED;
+}
+
+static void gangGeometry(byte unit, Geometry& geo) {
+  spiGeometry(gangLead(), geo);
+}
+
+// Programming overlaps, so the gang takes about as long as one chip
+static void gangTiming(byte unit, ChipTiming& t) {
+  spiTiming(gangLead(), t);
+}
+
+static void gangStatus(byte unit) {
+  for (byte i = 0; i < spiGang.count; i++) {
+    Serial.print(F("CS "));
+    Serial.print(spiGang.pins[i]);
+    Serial.println(gangHealthy(i) ? F(":") : F(": dropped"));
+    spiStatus(spiGang.pins[i]);
+  }
+}
+
+static bool gangWriteStatus(byte unit, byte value) {
+  for (byte i = 0; i < spiGang.count; i++) {
+    if (gangHealthy(i)) {
+      spiWriteStatus(spiGang.pins[i], value);
+    }
+  }
+  gangStarted();
+  return true;
+}
+
+static const char gangName[] PROGMEM = "SPI Flash gang";
+
+const MemoryDriver spiGangDriver PROGMEM = {
+  gangName,
+  gangBegin,
+  gangReadID,
+  gangIdentify,
+  gangReadStream,
+  gangProgramPage,
+  gangEraseRange,
+  gangPoll,
+  spiRelease,
+  gangGeometry,
+  gangStatus,
+  gangWriteStatus,
+  gangTiming
+};
+
+#endif
+
+#endif
@@ -0,0 +1,1100 @@
+/**
+ * Generic memory engines - see engine.h
+ */
+
+#include "arena.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "crc.h"
+#include "engine.h"
+#include "estimate.h"
+#include "hexdump.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "trace.h"
+#include "txring.h"
+
+#define READY_TIMEOUT_MS  1000  // Device must become idle before a job starts
+#define NO_SLOT           0xFF
+
+// Room for a PackBits header and the no-op byte a host may send first
+static_assert(GRANT_WINDOW + 2 < SERIAL_RX_BUFFER_SIZE, "GRANT_WINDOW does not fit the RX buffer");
+
+enum EnginePhase {
+  PHASE_READY_WAIT,  // Waiting for the device to finish earlier work
+  PHASE_RUN,
+  PHASE_READ_AHEAD   // Read engine: filling cache lines past the end
+};
+
+enum SlotState {
+  SLOT_FREE,
+  SLOT_FILLING,  // Receiving data from the source
+  SLOT_FULL,     // Waiting to be compared or programmed
+  SLOT_BUSY,     // Being programmed
+  SLOT_CHECKING  // Programmed, being read back (verify-on-write)
+};
+
+// A page buffer and the part of the image it holds
+struct PageSlot {
+  unsigned long address;
+  unsigned int length;
+  unsigned int filled;   // Bytes received from the source
+  unsigned int checked;  // Bytes compared with the chip
+  bool differs;          // Chip content differs from the buffer
+  bool needsErase;       // Chip content has a 0 where the image has a 1
+  byte retries;          // Reprograms after a failed read-back
+  byte state;
+};
+
+// State of the running engine; only one job runs at a time
+static struct {
+  MemoryDevice dev;
+  Geometry geo;
+  byte phase;
+  byte mode;
+  unsigned long deadline;
+  unsigned long address;    // Next address to read, assign or erase
+  unsigned long remaining;  // Bytes not yet read, assigned or erased
+  unsigned long total;
+  unsigned long errors;
+  unsigned long firstError;
+  unsigned long skipped;    // Pages left alone by diff-program
+  unsigned long rewritten;  // Pages programmed again after a failed read-back
+  unsigned long mismatchEnd;  // Verify: last differing byte + 1
+  byte ranges;              // Verify: ranges kept in arena.mismatch
+  unsigned long unlisted;   // Verify: further ranges, only counted
+  unsigned long lastInput;  // millis() of the last source data
+  unsigned long ungranted;  // Bytes assigned to slots, not yet asked for
+  unsigned int owed;        // Bytes asked for, not yet received
+  uint32_t dataCrc;         // CRC-32 of the data taken from the source
+  const ReadSink* sink;      // Points into PROGMEM
+  const DataSource* source;  // Points into PROGMEM
+  unsigned int chunkFill;   // Read engine: bytes collected for the sink
+  bool checkpointed;        // Progress is recorded in the job checkpoint
+#if FEATURE_CACHE
+  bool cached;              // Read engine: short read, through the page cache
+  bool sequential;          // Read engine: starts where the last read ended
+  MemoryDevice lastRead;    // Device and end of the last read
+  unsigned long lastReadEnd;
+  unsigned long aheadStart; // Lines read ahead for the next read
+  unsigned long aheadEnd;
+#endif
+  bool quiet;               // Report failures only
+  bool inFlight;            // Erase engine: erase in progress
+  unsigned long inFlightAddress;
+  byte nextAssign;          // Slot that takes the next part of the image
+  byte nextFill;            // Slot receiving source data
+  byte nextProcess;         // Slot to compare or program next
+  byte busySlot;            // Slot being programmed or read back, or NO_SLOT
+  PageSlot slot[PAGE_BUFFER_COUNT];
+#if FEATURE_STATS
+  unsigned long busySince;  // micros() when the last program or erase was issued
+#endif
+} eng;
+
+// Entries of the job's sink and source tables, read like DRIVER()
+#define SINK(fn) \
+  ((decltype(ReadSink::fn)) pgm_read_ptr(&eng.sink->fn))
+#define SINK_CHUNK() \
+  ((unsigned int) pgm_read_word(&eng.sink->chunk))
+#define SOURCE(fn) \
+  ((decltype(DataSource::fn)) pgm_read_ptr(&eng.source->fn))
+
+bool writeVerify = VERIFY_ON_WRITE;
+
+// Driver calls on the hot paths, timed when FEATURE_STATS is set and
+// traced when FEATURE_TRACE is set
+static PollResult pollDevice() {
+  STATS_BEGIN(start);
+  TRACE_START(traceStart);
+  PollResult result = DRIVER(eng.dev, poll)(eng.dev.unit);
+  STATS_END(STAT_POLL, start, 0);
+  TRACE_END(TRACE_POLL, traceStart, 0, 0, result);
+  return result;
+}
+
+static unsigned int readDevice(unsigned long address, byte* buffer, unsigned int len) {
+  STATS_BEGIN(start);
+  TRACE_START(traceStart);
+  unsigned int count = DRIVER(eng.dev, readStream)(eng.dev.unit, address, buffer, len);
+  STATS_END(STAT_READ, start, count);
+  ESTIMATE_LEARN(LEARN_READ, start, count);
+  TRACE_END(TRACE_READ, traceStart, address, count, 0);
+  return count;
+}
+
+// Small reads go through the page cache, longer ones stream past it
+static unsigned int readThrough(unsigned long address, byte* buffer, unsigned int len) {
+#if FEATURE_CACHE
+  if (eng.cached) {
+    return cacheRead(eng.dev, address, buffer, len, readDevice);
+  }
+  if (address >= eng.aheadStart && address < eng.aheadEnd) {
+    unsigned int count = cachePeek(eng.dev, address, buffer, len);
+    if (count > 0) {
+      return count;
+    }
+  }
+#endif
+  return readDevice(address, buffer, len);
+}
+
+static void programDevice(const PageSlot& s, const byte* data) {
+#if FEATURE_CACHE
+  cacheInvalidate(s.address, s.length);
+#endif
+  STATS_BEGIN(start);
+  TRACE_START(traceStart);
+  DRIVER(eng.dev, programPage)(eng.dev.unit, s.address, data, s.length);
+  STATS_END(STAT_PROGRAM, start, s.length);
+  ESTIMATE_LEARN(LEARN_WRITE, start, s.length);
+  TRACE_END(TRACE_PROGRAM, traceStart, s.address, s.length, 0);
+  STATS_MARK(eng.busySince);
+}
+
+static unsigned long eraseDevice(unsigned long address, unsigned long length) {
+  STATS_BEGIN(start);
+  TRACE_START(traceStart);
+  unsigned long covered = DRIVER(eng.dev, eraseRange)(eng.dev.unit, address, length);
+  STATS_END(STAT_ERASE, start, 0);
+  TRACE_END(TRACE_ERASE, traceStart, address, covered, covered == 0);
+  STATS_MARK(eng.busySince);
+#if FEATURE_CACHE
+  // The unit starts at or before address; drop all of it
+  unsigned long lead = address % eng.geo.eraseSize;
+  cacheInvalidate(address - lead, lead + covered);
+#endif
+  return covered;
+}
+
+static void printDriverName() {
+  Serial.print((const __FlashStringHelper*) pgm_read_ptr(&eng.dev.driver->name));
+}
+
+// End the job: release the bus and save how far it got
+static void engineStop() {
+  DRIVER(eng.dev, release)(eng.dev.unit);
+#if FEATURE_CHECKPOINT
+  if (eng.checkpointed) {
+    checkpointEnd();
+  }
+#endif
+}
+
+static void engineStart(const MemoryDevice& dev, JobStep step, byte flags) {
+  eng.dev = dev;
+  eng.phase = PHASE_READY_WAIT;
+  eng.deadline = millis() + READY_TIMEOUT_MS;
+  eng.errors = 0;
+  eng.skipped = 0;
+  eng.rewritten = 0;
+  startJob(step, engineStop, flags);
+}
+
+static void recordError(unsigned long address) {
+  if (eng.errors == 0) {
+    eng.firstError = address;
+  }
+  eng.errors++;
+}
+
+// Wait for the device to become idle before touching it, then read its
+// geometry (a busy chip does not answer an ID read); returns true if the
+// job has to end because the device never became ready
+static bool waitReady() {
+  PollResult result = pollDevice();
+
+  if (result == POLL_DONE) {
+    DRIVER(eng.dev, geometry)(eng.dev.unit, eng.geo);
+    eng.phase = PHASE_RUN;
+    return false;
+  }
+
+  if (result == POLL_BUSY && (long)(millis() - eng.deadline) < 0) {
+    return false;
+  }
+
+  Serial.print(F("Error: "));
+  printDriverName();
+  Serial.println(F(" busy or not responding"));
+  recordError(eng.address);
+  engineStop();
+  return true;
+}
+
+static void printFirstError() {
+  Serial.print(F(", first at 0x"));
+  Serial.println(eng.firstError, HEX);
+}
+
+// ===== BEGIN =====
+
+static bool beginStep() {
+  PollResult result = pollDevice();
+
+  if (result == POLL_BUSY) {
+    return false;
+  }
+
+  printDriverName();
+  Serial.println(result == POLL_DONE ? F(" ready") : F(" not responding"));
+  return true;
+}
+
+void engineSetQuiet(bool quiet) {
+  eng.quiet = quiet;
+}
+
+bool engineSucceeded() {
+  return eng.errors == 0;
+}
+
+uint32_t engineDataCrc() {
+  return eng.dataCrc;
+}
+
+void engineBegin(const MemoryDevice& dev) {
+  eng.dev = dev;
+  eng.checkpointed = false;
+#if FEATURE_CACHE
+  cacheClear();
+  eng.lastRead.driver = NULL;
+#endif
+#if FEATURE_ESTIMATE
+  estimateReset();
+#endif
+  DRIVER(dev, begin)(dev.unit);
+  startJob(beginStep, engineStop, 0);
+}
+
+// ===== STREAMING READ =====
+
+#if FEATURE_CACHE
+// After a read that continued the previous one, the host is likely to ask
+// for what follows next. Fetch it into the page cache while the output is
+// still draining, and stop once it has gone so the next command never waits
+static bool startReadAhead() {
+  eng.lastRead = eng.dev;
+  eng.lastReadEnd = eng.address;
+  if (!eng.sequential || txRingEmpty() || eng.address >= eng.geo.capacity) {
+    return false;
+  }
+
+  eng.aheadStart = eng.address - eng.address % PAGE_CACHE_LINE_SIZE;
+  eng.aheadEnd = min(eng.aheadStart + PAGE_CACHE_LINES * PAGE_CACHE_LINE_SIZE, eng.geo.capacity);
+  eng.address = eng.aheadStart;
+  eng.checkpointed = false;  // Already ended
+  eng.phase = PHASE_READ_AHEAD;
+  return true;
+}
+
+static bool readAheadStep() {
+  if (eng.address < eng.aheadEnd && !txRingEmpty()) {
+    if (cachePrefetch(eng.dev, eng.address, readDevice)) {
+      eng.address += PAGE_CACHE_LINE_SIZE;
+    }
+    return false;
+  }
+
+  // Lines not reached are not read ahead
+  eng.aheadEnd = eng.address;
+  DRIVER(eng.dev, release)(eng.dev.unit);
+  return true;
+}
+#endif
+
+static bool readStep() {
+  if (eng.phase == PHASE_READY_WAIT) {
+    return waitReady();
+  }
+#if FEATURE_CACHE
+  if (eng.phase == PHASE_READ_AHEAD) {
+    return readAheadStep();
+  }
+#endif
+
+  // The sink also needs room for its closing output
+  if (!SINK(ready)()) {
+    return false;
+  }
+
+  if (eng.remaining > 0) {
+    // Collect a chunk; drivers may return less than asked, or nothing yet
+    byte* buffer = arena.reader.chunk;
+    unsigned int chunk = SINK_CHUNK();
+    while (eng.chunkFill < chunk && eng.remaining > 0) {
+      unsigned int want = min((unsigned long)(chunk - eng.chunkFill), eng.remaining);
+      unsigned int count = readThrough(eng.address, buffer + eng.chunkFill, want);
+
+      if (count == 0) {
+        return false;
+      }
+
+      eng.address += count;
+      eng.remaining -= count;
+      eng.chunkFill += count;
+    }
+
+    SINK(consume)(eng.address - eng.chunkFill, buffer, eng.chunkFill);
+#if FEATURE_CHECKPOINT
+    if (eng.checkpointed) {
+      checkpointAdvance(buffer, eng.chunkFill);
+      checkpointSync();
+    }
+#endif
+    eng.chunkFill = 0;
+    return false;
+  }
+
+  engineStop();
+  void (*finish)() = SINK(finish);
+  if (finish != NULL) {
+    finish();
+  }
+#if FEATURE_CACHE
+  return !startReadAhead();
+#else
+  return true;
+#endif
+}
+
+static void startRead(const MemoryDevice& dev, unsigned long address, unsigned long length, const ReadSink& sink) {
+  eng.address = address;
+  eng.remaining = length;
+  eng.sink = &sink;
+  eng.chunkFill = 0;
+#if FEATURE_CACHE
+  eng.cached = cacheFits(address, length);
+  eng.sequential = dev.driver == eng.lastRead.driver && dev.unit == eng.lastRead.unit && address == eng.lastReadEnd;
+#endif
+  engineStart(dev, readStep, 0);
+}
+
+void engineRead(const MemoryDevice& dev, unsigned long address, unsigned long length, const ReadSink& sink) {
+  eng.checkpointed = false;
+
+#if FEATURE_CHECKPOINT
+  // Only a dump can be continued where it stopped
+  if (&sink == &hexDumpSink) {
+    checkpointBegin(OP_READ, dev, address, length);
+    eng.checkpointed = true;
+  }
+#endif
+
+  startRead(dev, address, length, sink);
+}
+
+// ===== PROGRAM / DIFF-PROGRAM / VERIFY =====
+
+static byte nextSlot(byte index) {
+  return (index + 1 < PAGE_BUFFER_COUNT) ? index + 1 : 0;
+}
+
+// Free a slot that has been programmed or checked; the checkpoint only
+// advances while the whole job is error-free
+static void completeSlot(byte index) {
+#if FEATURE_CHECKPOINT
+  if (eng.checkpointed && eng.errors == 0) {
+    checkpointAdvance(arena.page[index], eng.slot[index].length);
+  }
+#endif
+  eng.slot[index].state = SLOT_FREE;
+}
+
+// Give free slots the next parts of the image, in address order
+static void assignSlots() {
+  while (eng.remaining > 0 && eng.slot[eng.nextAssign].state == SLOT_FREE) {
+    PageSlot& s = eng.slot[eng.nextAssign];
+
+    // Program units must not cross a chip page
+    unsigned long limit = PAGE_BUFFER_SIZE;
+    if (eng.mode != WRITE_VERIFY) {
+      limit = min(limit, (unsigned long)(eng.geo.pageSize - eng.address % eng.geo.pageSize));
+    }
+
+    s.address = eng.address;
+    s.length = min(limit, eng.remaining);
+    s.filled = 0;
+    s.checked = 0;
+    s.differs = false;
+    s.needsErase = false;
+    s.retries = 0;
+    s.state = SLOT_FILLING;
+
+    eng.address += s.length;
+    eng.remaining -= s.length;
+    eng.ungranted += s.length;
+    eng.nextAssign = nextSlot(eng.nextAssign);
+  }
+}
+
+// Ask for the assigned bytes a window at a time, topped up once half of
+// it has arrived
+static void grantSource() {
+  void (*grant)(unsigned int) = SOURCE(grant);
+  if (grant == NULL) {
+    return;
+  }
+#if FEATURE_CHECKPOINT
+  // A checkpoint save waits until everything asked for has arrived
+  if (eng.checkpointed && checkpointSyncDue()) {
+    if (eng.owed > 0) {
+      return;
+    }
+    checkpointSync();
+  }
+#endif
+  if (eng.ungranted == 0 || eng.owed > GRANT_WINDOW / 2) {
+    return;
+  }
+
+  unsigned int len = min(eng.ungranted, (unsigned long)(GRANT_WINDOW - eng.owed));
+  grant(len);
+  eng.owed += len;
+  eng.ungranted -= len;
+}
+
+// Returns false if the source has stalled for too long
+static bool fillSlot() {
+  PageSlot& s = eng.slot[eng.nextFill];
+  if (s.state != SLOT_FILLING) {
+    return true;
+  }
+
+  byte* buffer = arena.page[eng.nextFill] + s.filled;
+  unsigned int count = SOURCE(fill)(buffer, s.length - s.filled);
+  if (count > 0) {
+    if (SOURCE(grant) != NULL) {
+      eng.owed -= count;
+    }
+    eng.dataCrc = crc32(eng.dataCrc, buffer, count);
+    eng.lastInput = millis();
+    s.filled += count;
+    if (s.filled == s.length) {
+      s.state = SLOT_FULL;
+      eng.nextFill = nextSlot(eng.nextFill);
+    }
+  }
+
+  return millis() - eng.lastInput < STREAM_TIMEOUT_MS;
+}
+
+// Extend the last mismatch range or start a new one; only the first
+// MISMATCH_RANGES are kept, and the rest counted
+static void noteMismatch(unsigned long address, byte chip, byte wanted) {
+  bool newRange = eng.errors == 1 || address >= eng.mismatchEnd + MISMATCH_GAP;
+  eng.mismatchEnd = address + 1;
+
+  if (newRange) {
+    if (eng.ranges == MISMATCH_RANGES || eng.unlisted > 0) {
+      eng.unlisted++;
+      return;
+    }
+    MismatchRange& r = arena.mismatch[eng.ranges++];
+    r.start = address;
+    r.differ = 0;
+  } else if (eng.unlisted > 0) {
+    return;
+  }
+
+  MismatchRange& r = arena.mismatch[eng.ranges - 1];
+  if (r.differ < sizeof(r.chip)) {
+    r.chip[r.differ] = chip;
+    r.image[r.differ] = wanted;
+  }
+  r.differ++;
+  r.end = address + 1;
+}
+
+static void printBytes(const __FlashStringHelper* label, const byte* data, byte count) {
+  Serial.print(label);
+  for (byte i = 0; i < count; i++) {
+    Serial.print(' ');
+    if (data[i] < 0x10) {
+      Serial.print('0');
+    }
+    Serial.print(data[i], HEX);
+  }
+}
+
+static void printMismatches() {
+  for (byte i = 0; i < eng.ranges; i++) {
+    const MismatchRange& r = arena.mismatch[i];
+    byte shown = min(r.differ, (unsigned long)sizeof(r.chip));
+
+    Serial.print(F("  0x"));
+    Serial.print(r.start, HEX);
+    if (r.end - r.start > 1) {
+      Serial.print(F("-0x"));
+      Serial.print(r.end - 1, HEX);
+    }
+    Serial.print(F(": "));
+    Serial.print(r.differ);
+    printBytes(F(" bytes differ, chip"), r.chip, shown);
+    printBytes(F(", image"), r.image, shown);
+    Serial.println(r.differ > shown ? F(" ...") : F(""));
+  }
+
+  if (eng.unlisted > 0) {
+    Serial.print(F("  and "));
+    Serial.print(eng.unlisted);
+    Serial.println(F(" more ranges"));
+  }
+}
+
+// Compare a full slot with the chip; returns true once the whole slot is checked
+static bool compareSlot(byte index) {
+  PageSlot& s = eng.slot[index];
+  const byte* data = arena.page[index];
+  byte* chip = arena.scratch;
+
+  while (s.checked < s.length) {
+    unsigned int want = min((unsigned int)COMPARE_CHUNK, s.length - s.checked);
+    unsigned int count = readDevice(s.address + s.checked, chip, want);
+
+    if (count == 0) {
+      return false;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+      byte wanted = data[s.checked + i];
+      if (chip[i] != wanted) {
+        if (eng.mode == WRITE_VERIFY) {
+          recordError(s.address + s.checked + i);
+          noteMismatch(s.address + s.checked + i, chip[i], wanted);
+        }
+        s.differs = true;
+        if ((chip[i] & wanted) != wanted) {
+          s.needsErase = true;
+        }
+      }
+    }
+    s.checked += count;
+  }
+  return true;
+}
+
+static void reportWrite() {
+  unsigned long total = eng.total;
+
+  if (eng.quiet && eng.errors == 0) {
+    return;
+  }
+
+  switch (eng.mode) {
+    case WRITE_VERIFY:
+      if (eng.errors == 0) {
+        Serial.print(F("Verify OK, "));
+        Serial.print(total);
+        Serial.println(F(" bytes"));
+      } else {
+        Serial.print(F("Verify failed: "));
+        Serial.print(eng.errors);
+        Serial.print(F(" bytes differ"));
+        printFirstError();
+        printMismatches();
+      }
+      return;
+    case WRITE_DIFF:
+      Serial.print(F("Skipped "));
+      Serial.print(eng.skipped);
+      Serial.println(F(" unchanged pages"));
+      break;
+  }
+
+  if (eng.errors == 0) {
+    Serial.print(F("Write complete, "));
+    Serial.print(total);
+    if (writeVerify) {
+      Serial.print(F(" bytes verified, CRC 0x"));
+      Serial.print(eng.dataCrc, HEX);
+      if (eng.rewritten > 0) {
+        Serial.print(F(", "));
+        Serial.print(eng.rewritten);
+        Serial.print(F(" pages programmed twice"));
+      }
+      Serial.println();
+    } else {
+      Serial.println(F(" bytes"));
+    }
+  } else {
+    Serial.print(F("Write failed: "));
+    Serial.print(eng.errors);
+    Serial.print(eng.mode == WRITE_DIFF ? F(" pages failed or need erase") : F(" pages failed"));
+    printFirstError();
+  }
+}
+
+// Retire the page being programmed, reading it back first with
+// verify-on-write; the buffer stays in use until it checks out
+static void retireSlot() {
+  byte index = eng.busySlot;
+  PageSlot& s = eng.slot[index];
+
+  if (s.state == SLOT_BUSY) {
+    PollResult result = pollDevice();
+    if (result == POLL_BUSY) {
+      return;
+    }
+    STATS_END(STAT_BUSY, eng.busySince, 0);
+    ESTIMATE_LEARN(LEARN_PAGE, eng.busySince, 1);
+    if (result == POLL_FAILED) {
+      recordError(s.address);
+    } else if (writeVerify) {
+      s.state = SLOT_CHECKING;
+      s.checked = 0;
+      s.differs = false;
+      s.needsErase = false;
+    }
+  }
+
+  if (s.state == SLOT_CHECKING) {
+    if (!compareSlot(index)) {
+      return;
+    }
+    if (s.differs) {
+      // Flash can still program bits left at 1 but needs an erase for the
+      // rest; a chip without erase just takes the page again. NAND has no
+      // partial program left for a retry (GEO_PROGRAM_ONCE)
+      if (!(s.needsErase && (eng.geo.flags & GEO_NEEDS_ERASE)) && s.retries < WRITE_RETRIES && !(eng.geo.flags & GEO_PROGRAM_ONCE)) {
+        s.retries++;
+        eng.rewritten++;
+        programDevice(s, arena.page[index]);
+        s.state = SLOT_BUSY;
+        return;
+      }
+      recordError(s.address);
+    }
+  }
+
+  completeSlot(index);
+  eng.busySlot = NO_SLOT;
+}
+
+static bool writeStep() {
+  if (eng.phase == PHASE_READY_WAIT) {
+    if (waitReady()) {
+      return true;
+    }
+    void (*begin)() = SOURCE(begin);
+    if (eng.phase == PHASE_RUN && begin != NULL) {
+      begin();
+    }
+    eng.lastInput = millis();
+    return false;
+  }
+
+  if (eng.busySlot != NO_SLOT) {
+    retireSlot();
+  }
+
+  // Keep the source flowing into the other buffer meanwhile
+  assignSlots();
+  grantSource();
+  if (!fillSlot()) {
+    Serial.println(F("Error: Timeout waiting for data"));
+    recordError(eng.address);
+    engineStop();
+    return true;
+  }
+
+  // Compare and/or program the oldest full slot once the chip is idle
+  PageSlot& s = eng.slot[eng.nextProcess];
+  if (s.state == SLOT_FULL && eng.busySlot == NO_SLOT) {
+    if (eng.mode != WRITE_PROGRAM && !compareSlot(eng.nextProcess)) {
+      return false;
+    }
+
+    bool program = true;
+    if (eng.mode == WRITE_VERIFY) {
+      program = false;
+    } else if (eng.mode == WRITE_DIFF) {
+      if (!s.differs) {
+        eng.skipped++;
+        program = false;
+      } else if (s.needsErase && (eng.geo.flags & GEO_NEEDS_ERASE)) {
+        recordError(s.address);
+        program = false;
+      }
+    }
+
+    if (program) {
+      programDevice(s, arena.page[eng.nextProcess]);
+      s.state = SLOT_BUSY;
+      eng.busySlot = eng.nextProcess;
+    } else {
+      completeSlot(eng.nextProcess);
+    }
+    eng.nextProcess = nextSlot(eng.nextProcess);
+  }
+
+  // Finished when every slot has drained
+  if (eng.remaining > 0) {
+    return false;
+  }
+  for (byte i = 0; i < PAGE_BUFFER_COUNT; i++) {
+    if (eng.slot[i].state != SLOT_FREE) {
+      return false;
+    }
+  }
+
+  engineStop();
+  reportWrite();
+  return true;
+}
+
+static void startWrite(const MemoryDevice& dev, unsigned long address, unsigned long length, const DataSource& source, byte mode) {
+  eng.address = address;
+  eng.remaining = length;
+  eng.total = length;
+  eng.source = &source;
+  eng.mode = mode;
+  eng.dataCrc = 0;
+  eng.ranges = 0;
+  eng.unlisted = 0;
+  eng.nextAssign = 0;
+  eng.nextFill = 0;
+  eng.nextProcess = 0;
+  eng.busySlot = NO_SLOT;
+  eng.ungranted = 0;
+  eng.owed = 0;
+  for (byte i = 0; i < PAGE_BUFFER_COUNT; i++) {
+    eng.slot[i].state = SLOT_FREE;
+  }
+
+#if FEATURE_IMAGE
+  // Binary image data must not be mistaken for abort keys
+  engineStart(dev, writeStep, (&source == &hostSource) ? JOB_RAW_INPUT : 0);
+#else
+  engineStart(dev, writeStep, 0);
+#endif
+}
+
+void engineWrite(const MemoryDevice& dev, unsigned long address, unsigned long length, const DataSource& source, byte mode) {
+  eng.checkpointed = false;
+
+#if FEATURE_CHECKPOINT && FEATURE_IMAGE
+  // Only a host image can be sent again from where it stopped
+  if (&source == &hostSource) {
+    // JobOp lists the write modes in WriteMode order
+    checkpointBegin(OP_PROGRAM + mode, dev, address, length);
+    eng.checkpointed = true;
+  }
+#endif
+
+  startWrite(dev, address, length, source, mode);
+}
+
+#if FEATURE_CHECKPOINT
+bool engineResume(const MemoryDevice& dev) {
+  unsigned long address = checkpoint.start + checkpoint.done;
+  unsigned long length = checkpoint.length - checkpoint.done;
+
+  checkpoint.finished = false;
+  eng.checkpointed = true;
+
+  switch (checkpoint.op) {
+    case OP_READ:
+      startRead(dev, address, length, hexDumpSink);
+      return true;
+#if FEATURE_IMAGE
+    case OP_PROGRAM:
+      startWrite(dev, address, length, hostSource, WRITE_PROGRAM);
+      return true;
+    case OP_DIFF:
+      startWrite(dev, address, length, hostSource, WRITE_DIFF);
+      return true;
+    case OP_VERIFY:
+      startWrite(dev, address, length, hostSource, WRITE_VERIFY);
+      return true;
+#endif
+  }
+  return false;
+}
+#endif
+
+// ===== ERASE =====
+
+// Only whole units are typical; EEPROMs write a page of 0xFF
+static void learnErase() {
+#if FEATURE_ESTIMATE
+  unsigned long covered = eng.address - eng.inFlightAddress;
+  if (!(eng.geo.flags & GEO_NEEDS_ERASE)) {
+    ESTIMATE_LEARN(LEARN_PAGE, eng.busySince, 1);
+  } else if (covered == eng.geo.eraseSize) {
+    ESTIMATE_LEARN(LEARN_SECTOR, eng.busySince, 1);
+  } else if (covered == eng.geo.blockSize) {
+    ESTIMATE_LEARN(LEARN_BLOCK, eng.busySince, 1);
+  }
+#endif
+}
+
+static bool eraseStep() {
+  if (eng.phase == PHASE_READY_WAIT) {
+    return waitReady();
+  }
+
+  if (eng.inFlight) {
+    PollResult result = pollDevice();
+    if (result == POLL_BUSY) {
+      return false;
+    }
+    STATS_END(STAT_BUSY, eng.busySince, 0);
+    if (result == POLL_FAILED) {
+      recordError(eng.inFlightAddress);
+    } else {
+      learnErase();
+    }
+    eng.inFlight = false;
+  }
+
+  if (eng.remaining > 0) {
+    unsigned long covered = eraseDevice(eng.address, eng.remaining);
+    if (covered == 0) {
+      Serial.println(F("\nErase not supported"));
+      recordError(eng.address);
+      engineStop();
+      return true;
+    }
+
+    eng.inFlightAddress = eng.address;
+    eng.address += covered;
+    eng.remaining -= min(covered, eng.remaining);
+    eng.inFlight = true;
+    return false;
+  }
+
+  engineStop();
+
+  if (eng.errors == 0) {
+    if (!eng.quiet) {
+      Serial.println(F("\nErase complete"));
+    }
+  } else {
+    Serial.print(F("\nErase failed: "));
+    Serial.print(eng.errors);
+    Serial.print(F(" units"));
+    printFirstError();
+  }
+  return true;
+}
+
+void engineErase(const MemoryDevice& dev, unsigned long address, unsigned long length) {
+  eng.address = address;
+  eng.remaining = length;
+  eng.inFlight = false;
+  eng.checkpointed = false;
+
+  if (eng.quiet) {
+    engineStart(dev, eraseStep, 0);
+  } else {
+    Serial.print(F("Erasing"));
+    engineStart(dev, eraseStep, JOB_PROGRESS);
+  }
+}
+
+// ===== SOURCES AND SINKS =====
+
+static HexDumpState dumpState;
+static bool dumpStarted;
+
+static bool hexDumpReady() {
+  return txRingFree() >= HEX_DUMP_SPACE;
+}
+
+static void hexDumpConsume(unsigned long address, const byte* data, unsigned int len) {
+  if (!dumpStarted) {
+    hexDumpBegin(dumpState, address);
+    dumpStarted = true;
+  }
+  STATS_BEGIN(start);
+  hexDumpLine(dumpState, data, len);
+  STATS_END(STAT_OUTPUT, start, len);
+}
+
+static void hexDumpFinish() {
+  if (dumpStarted) {
+    hexDumpEnd(dumpState);
+  }
+  dumpStarted = false;
+}
+
+const ReadSink hexDumpSink PROGMEM = {
+  hexDumpReady,
+  hexDumpConsume,
+  hexDumpFinish,
+  16
+};
+
+static uint32_t crcValue;
+
+void crcSinkBegin() {
+  crcValue = 0;
+}
+
+uint32_t crcSinkValue() {
+  return crcValue;
+}
+
+static bool crcReady() {
+  return true;
+}
+
+static void crcConsume(unsigned long address, const byte* data, unsigned int len) {
+  crcValue = crc32(crcValue, data, len);
+}
+
+const ReadSink crcSink PROGMEM = {
+  crcReady,
+  crcConsume,
+  NULL,
+  PAGE_BUFFER_SIZE
+};
+
+#if FEATURE_IMAGE
+
+bool imagePacked = false;
+
+// PackBits packet in progress
+static struct {
+  byte literal;  // Literal bytes still to come
+  byte run;      // Repeats of value still to write
+  byte pending;  // Run length whose value byte has not arrived yet
+  byte value;
+} packet;
+
+static unsigned int unpack(byte* buffer, unsigned int len) {
+  unsigned int count = 0;
+  unsigned int received = 0;
+  while (count < len) {
+    if (packet.run > 0) {
+      byte n = min((unsigned int)packet.run, len - count);
+      memset(buffer + count, packet.value, n);
+      packet.run -= n;
+      count += n;
+      continue;
+    }
+    if (!Serial.available()) {
+      break;
+    }
+
+    byte c = Serial.read();
+    received++;
+    if (packet.pending > 0) {
+      packet.value = c;
+      packet.run = packet.pending;
+      packet.pending = 0;
+    } else if (packet.literal > 0) {
+      buffer[count++] = c;
+      packet.literal--;
+    } else if (c < 0x80) {
+      packet.literal = c + 1;
+    } else if (c > 0x80) {
+      packet.pending = 257 - c;
+    }
+  }
+
+#if FEATURE_ESTIMATE
+  if (count > 0) {
+    estimateLearn(LEARN_PACKED, received, count);
+  }
+#endif
+  return count;
+}
+
+static unsigned int hostFill(byte* buffer, unsigned int len) {
+  STATS_BEGIN(start);
+  unsigned int count = 0;
+  if (imagePacked) {
+    count = unpack(buffer, len);
+  } else {
+    while (count < len && Serial.available()) {
+      buffer[count++] = Serial.read();
+    }
+  }
+
+  // Calls that find nothing queued are not counted
+  if (count > 0) {
+    STATS_END(STAT_INPUT, start, count);
+  }
+  return count;
+}
+
+// The line ending of the command that started the transfer may still be
+// queued; the host sends nothing else before the first request
+static void hostBegin() {
+  memset(&packet, 0, sizeof(packet));
+  while (Serial.peek() == '\r' || Serial.peek() == '\n') {
+    Serial.read();
+  }
+}
+
+static void hostGrant(unsigned int len) {
+  Serial.print('>');
+  Serial.println(len);
+}
+
+const DataSource hostSource PROGMEM = {
+  hostBegin,
+  hostFill,
+  hostGrant
+};
+
+#endif
+
+#if FEATURE_CLONE
+
+static MemoryDevice sourceDev;
+static unsigned long sourceAddress;
+
+void setDeviceSource(const MemoryDevice& dev, unsigned long address) {
+  sourceDev = dev;
+  sourceAddress = address;
+}
+
+// Called while the target programs the previous page, so the source read
+// is hidden behind the program time
+static unsigned int deviceFill(byte* buffer, unsigned int len) {
+  STATS_BEGIN(start);
+  TRACE_START(traceStart);
+  unsigned int count = 0;
+  while (count < len) {
+    unsigned int n = DRIVER(sourceDev, readStream)(sourceDev.unit, sourceAddress + count, buffer + count, len - count);
+    if (n == 0) {
+      break;
+    }
+    count += n;
+  }
+  STATS_END(STAT_INPUT, start, count);
+  TRACE_END(TRACE_READ, traceStart, sourceAddress, count, 0);
+
+  sourceAddress += count;
+  return count;
+}
+
+const DataSource deviceSource PROGMEM = {
+  NULL,
+  deviceFill,
+  NULL
+};
+
+#endif
+
+static const byte* memoryData;
+
+void setMemorySource(const byte* data) {
+  memoryData = data;
+}
+
+static unsigned int memoryFill(byte* buffer, unsigned int len) {
+  memcpy(buffer, memoryData, len);
+  memoryData += len;
+  return len;
+}
+
+const DataSource memorySource PROGMEM = {
+  NULL,
+  memoryFill,
+  NULL
+};
@@ -0,0 +1,280 @@
+/**
+ * Dry-run time estimates - see estimate.h
+ */
+
+#include "engine.h"
+#include "estimate.h"
+#include "link.h"
+#include "script.h"
+
+#if FEATURE_ESTIMATE
+
+// Phases of a step; a program step's link time overlaps the others
+enum EstimatePhase {
+  PHASE_ERASE,
+  PHASE_BUS,
+  PHASE_BUSY,
+  PHASE_LINK,
+  PHASES
+};
+
+struct Measure {
+  unsigned long total;
+  unsigned long count;
+};
+
+static Measure learned[LEARN_COUNT];
+
+// Per-unit figures of the model
+struct Model {
+  Geometry geo;
+  float unit[LEARN_COUNT];  // Learned average, or the typical value
+  float linkUs;             // Per image byte on the serial link
+};
+
+void estimateLearn(byte what, unsigned long total, unsigned long count) {
+  Measure& m = learned[what];
+
+  // Halving keeps the average while making room for more
+  if (m.total >= 0x80000000UL || m.count >= 0x80000000UL) {
+    m.total /= 2;
+    m.count /= 2;
+  }
+  m.total += total;
+  m.count += count;
+}
+
+void estimateReset() {
+  memset(learned, 0, sizeof(learned));
+}
+
+static void buildModel(const MemoryDevice& dev, Model& model) {
+  ChipTiming typical;
+  DRIVER(dev, geometry)(dev.unit, model.geo);
+  DRIVER(dev, timing)(dev.unit, typical);
+
+  const float typicalUnit[LEARN_COUNT] = {
+    typical.byteNs / 1000.0f,
+    typical.byteNs / 1000.0f,
+    (float)typical.programUs,
+    (float)typical.eraseUs,
+    (float)typical.blockEraseUs,
+    1.0f
+  };
+  for (byte i = 0; i < LEARN_COUNT; i++) {
+    model.unit[i] = learned[i].count > 0 ? (float)learned[i].total / learned[i].count : typicalUnit[i];
+  }
+
+  // Ten bits per byte on the wire
+#if FEATURE_LINK
+  model.linkUs = 10000000.0 / linkBaud;
+#else
+  model.linkUs = 10000000.0 / SERIAL_BAUD;
+#endif
+#if FEATURE_IMAGE
+  if (imagePacked) {
+    model.linkUs *= model.unit[LEARN_PACKED];
+  }
+#endif
+}
+
+static unsigned long pagesIn(const Model& model, unsigned long address, unsigned long length) {
+  unsigned int size = model.geo.pageSize;
+  return (address + length - 1) / size - address / size + 1;
+}
+
+// Erase the way the drivers do: the large unit where it is aligned and
+// fits, the small one elsewhere
+static float eraseTime(const Model& model, unsigned long address, unsigned long length) {
+  unsigned long sector = model.geo.eraseSize;
+  unsigned long block = model.geo.blockSize;
+  float time = 0;
+
+  while (length > 0) {
+    bool large = block != sector && address % block == 0 && length >= block;
+    unsigned long unit = large ? block : sector;
+    unsigned long covered = unit - address % unit;
+
+    time += model.unit[large ? LEARN_BLOCK : LEARN_SECTOR];
+    address += covered;
+    length -= min(covered, length);
+  }
+  return time;
+}
+
+// Microseconds per phase; returns the step's total
+static float estimateStep(const Model& model, const ScriptStep& step, float* phase) {
+  for (byte i = 0; i < PHASES; i++) {
+    phase[i] = 0;
+  }
+
+  switch (step.op) {
+    case SCRIPT_STATUS:
+      phase[PHASE_BUSY] = ESTIMATE_STATUS_US;
+      break;
+
+    case SCRIPT_ERASE:
+      if (model.geo.flags & GEO_NEEDS_ERASE) {
+        phase[PHASE_ERASE] = eraseTime(model, step.address, step.length);
+      } else {
+        // EEPROMs are erased by writing 0xFF pages
+        phase[PHASE_BUS] = step.length * model.unit[LEARN_WRITE];
+        phase[PHASE_BUSY] = pagesIn(model, step.address, step.length) * model.unit[LEARN_PAGE];
+      }
+      break;
+
+    case SCRIPT_PROGRAM: {
+      unsigned long pages = pagesIn(model, step.address, step.length);
+      phase[PHASE_BUS] = step.length * model.unit[LEARN_WRITE];
+      if (writeVerify) {
+        phase[PHASE_BUS] += step.length * model.unit[LEARN_READ];
+      }
+      phase[PHASE_BUSY] = pages * model.unit[LEARN_PAGE];
+      phase[PHASE_LINK] = step.length * model.linkUs;
+
+      // The page buffers overlap the link with the chip; only the first
+      // page of the faster side adds to the slower one
+      float chip = phase[PHASE_BUS] + phase[PHASE_BUSY];
+      float link = phase[PHASE_LINK];
+      return max(chip, link) + min(chip, link) / pages;
+    }
+
+    case SCRIPT_VERIFY:
+      phase[PHASE_BUS] = step.length * model.unit[LEARN_READ];
+      break;
+  }
+
+  return phase[PHASE_ERASE] + phase[PHASE_BUS] + phase[PHASE_BUSY];
+}
+
+static void printColumn(unsigned long value, byte width) {
+  byte digits = 1;
+  for (unsigned long v = value; v >= 10; v /= 10) {
+    digits++;
+  }
+  while (digits++ < width) {
+    Serial.print(' ');
+  }
+  Serial.print(value);
+}
+
+static unsigned long toMs(float us) {
+  return (unsigned long)(us / 1000 + 0.5);
+}
+
+static void printStepName(byte op) {
+  static const char names[][8] PROGMEM = { "id", "status", "erase", "program", "verify" };
+  const char* name = names[op];
+  Serial.print((const __FlashStringHelper*) name);
+  for (byte pad = strlen_P(name); pad < 8; pad++) {
+    Serial.print(' ');
+  }
+}
+
+static void printPhaseName(byte phase) {
+  switch (phase) {
+    case PHASE_ERASE: Serial.print(F("erase")); break;
+    case PHASE_BUS:   Serial.print(F("bus transfer")); break;
+    case PHASE_BUSY:  Serial.print(F("chip busy")); break;
+    default:          Serial.print(F("serial link")); break;
+  }
+}
+
+static void printFigure(const Model& model, const __FlashStringHelper* name, byte what, float scale, const __FlashStringHelper* unit) {
+  Serial.print(name);
+  Serial.print((unsigned long)(model.unit[what] * scale + 0.5));
+  Serial.print(unit);
+  if (learned[what].count > 0) {
+    Serial.print('*');
+  }
+}
+
+static void printModel(const Model& model) {
+  printFigure(model, F("Model: page "), LEARN_PAGE, 1, F(" us"));
+  if (model.geo.flags & GEO_NEEDS_ERASE) {
+    printFigure(model, F(", sector "), LEARN_SECTOR, 1, F(" us"));
+    printFigure(model, F(", block "), LEARN_BLOCK, 1, F(" us"));
+  }
+  printFigure(model, F(", read "), LEARN_READ, 1000, F(" ns/byte"));
+  printFigure(model, F(", write "), LEARN_WRITE, 1000, F(" ns/byte"));
+  Serial.print(F(", link "));
+  Serial.print((unsigned long)(model.linkUs * 1000 + 0.5));
+  Serial.println(F(" ns/byte (* measured)"));
+}
+
+bool estimateRun(const MemoryDevice& dev, char* line) {
+  ScriptStep single;
+  byte count = 1;
+  bool stored = strcmp_P(line, PSTR("script")) == 0;
+
+  if (stored) {
+    count = scriptLength();
+    if (count == 0) {
+      Serial.println(F("No job script stored"));
+      return true;
+    }
+  } else if (scriptParseLine(line, single) != SCRIPT_LINE_OK) {
+    return false;
+  }
+
+  Model model;
+  buildModel(dev, model);
+
+  Serial.print(F("Estimate for "));
+  Serial.print((const __FlashStringHelper*) pgm_read_ptr(&dev.driver->name));
+  if (writeVerify) {
+    Serial.print(F(", verify-on-write"));
+  }
+#if FEATURE_IMAGE
+  if (imagePacked) {
+    Serial.print(F(", PackBits"));
+  }
+#endif
+  Serial.println();
+  Serial.println(F("step op            bytes   erase     bus    busy    link   total ms"));
+
+  float phaseTotal[PHASES] = { 0, 0, 0, 0 };
+  float total = 0;
+  for (byte i = 0; i < count; i++) {
+    ScriptStep step;
+    if (stored) {
+      scriptLoadStep(i, step);
+    } else {
+      step = single;
+    }
+
+    float phase[PHASES];
+    float time = estimateStep(model, step, phase);
+    total += time;
+
+    printColumn(i + 1, 4);
+    Serial.print(' ');
+    printStepName(step.op);
+    printColumn(step.op >= SCRIPT_ERASE ? step.length : 0, 10);
+    for (byte p = 0; p < PHASES; p++) {
+      phaseTotal[p] += phase[p];
+      printColumn(toMs(phase[p]), 8);
+    }
+    printColumn(toMs(time), 8);
+    Serial.println();
+  }
+
+  byte slowest = 0;
+  for (byte p = 1; p < PHASES; p++) {
+    if (phaseTotal[p] > phaseTotal[slowest]) {
+      slowest = p;
+    }
+  }
+
+  Serial.print(F("Total "));
+  Serial.print(toMs(total));
+  Serial.print(F(" ms, bottleneck: "));
+  printPhaseName(slowest);
+  Serial.print(F(" ("));
+  Serial.print(toMs(phaseTotal[slowest]));
+  Serial.println(F(" ms)"));
+  printModel(model);
+  return true;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * Gang programming - see gang.h
+ */
+
+#include "arena.h"
+#include "driver.h"
+#include "engine.h"
+#include "gang.h"
+#include "scheduler.h"
+
+#if FEATURE_GANG
+
+// The engine job that is running
+enum GangStage {
+  GANG_START,
+  GANG_ERASING,
+  GANG_PROGRAMMING,
+  GANG_CHECKING  // Reading back one chip's CRC
+};
+
+static const MemoryDevice gangDevice = { &spiGangDriver, 0 };
+
+static GangJob& gang = arena.job.gang;
+
+static void gangCancel() {
+  engineSetQuiet(false);
+  DRIVER(gangDevice, release)(gangDevice.unit);
+}
+
+static void printChip(byte i) {
+  Serial.print(F("CS "));
+  Serial.print(spiGang.pins[i]);
+  Serial.print(F(": "));
+}
+
+static bool finishGang() {
+  gangCancel();
+
+  byte passed = 0;
+  for (byte i = 0; i < spiGang.count; i++) {
+    if (gang.dropped & (1 << i)) {
+      printChip(i);
+      Serial.println(F("FAILED, not responding"));
+    } else if (!(spiGang.failed & (1 << i))) {
+      passed++;
+    }
+  }
+
+  Serial.print(F("Gang: "));
+  Serial.print(passed);
+  Serial.print(F(" of "));
+  Serial.print(spiGang.count);
+  Serial.print(F(" chips OK, "));
+  Serial.print(gang.length);
+  Serial.print(F(" bytes in "));
+  Serial.print(millis() - gang.startTime);
+  Serial.println(F(" ms"));
+  return true;
+}
+
+static bool gangSequence() {
+  if ((gang.stage == GANG_ERASING || gang.stage == GANG_PROGRAMMING) && !engineSucceeded()) {
+    // Every chip has dropped out
+    gang.dropped = spiGang.failed;
+    return finishGang();
+  }
+
+  switch (gang.stage) {
+    case GANG_START:
+      engineErase(gangDevice, gang.address, gang.length);
+      gang.stage = GANG_ERASING;
+      return false;
+
+    case GANG_ERASING:
+      engineWrite(gangDevice, gang.address, gang.length, hostSource, WRITE_PROGRAM);
+      gang.stage = GANG_PROGRAMMING;
+      return false;
+
+    case GANG_PROGRAMMING:
+      gang.dropped = spiGang.failed;
+      gang.chip = 0;
+      gang.stage = GANG_CHECKING;
+      break;
+
+    case GANG_CHECKING: {
+      bool passed = engineSucceeded() && crcSinkValue() == engineDataCrc();
+      printChip(gang.chip);
+      Serial.print(passed ? F("OK, CRC 0x") : F("FAILED, CRC 0x"));
+      Serial.println(crcSinkValue(), HEX);
+      if (!passed) {
+        spiGang.failed |= 1 << gang.chip;
+      }
+      gang.chip++;
+      break;
+    }
+  }
+
+  // Read back the next chip that is still in the gang
+  while (gang.chip < spiGang.count && (gang.dropped & (1 << gang.chip))) {
+    gang.chip++;
+  }
+  if (gang.chip == spiGang.count) {
+    return finishGang();
+  }
+
+  MemoryDevice chip = { &spiDriver, spiGang.pins[gang.chip] };
+  crcSinkBegin();
+  engineRead(chip, gang.address, gang.length, crcSink);
+  return false;
+}
+
+void gangRun(unsigned long address, unsigned long length) {
+  gang.address = address;
+  gang.length = length;
+  gang.stage = GANG_START;
+  gang.startTime = millis();
+
+  DRIVER(gangDevice, begin)(gangDevice.unit);
+  gang.dropped = spiGang.failed;
+  if (spiGang.failed == (1 << spiGang.count) - 1) {
+    Serial.println(F("No chip in the gang is responding"));
+    return;
+  }
+
+  Serial.print(F("Send "));
+  Serial.print(length);
+  Serial.println(F(" bytes of image data as requested"));
+  engineSetQuiet(true);
+  startSequence(gangSequence, gangCancel);
+}
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * Per-sector hash map - see hashmap.h
+ */
+
+#include "arena.h"
+#include "crc.h"
+#include "engine.h"
+#include "hashmap.h"
+#include "scheduler.h"
+#include "txring.h"
+
+#if FEATURE_HASHMAP
+
+#define HASH_LINE_SPACE   19  // "AAAAAAAA CCCCCCCC" and CR LF
+#define HASH_LINES_MAX    (PAGE_BUFFER_SIZE / HASHMAP_MIN_UNIT + 1)  // Per read chunk
+
+static_assert(TX_RING_SIZE >= HASH_LINE_SPACE * HASH_LINES_MAX, "The TX ring must hold the hash lines of a read chunk");
+
+static HashMapJob& map = arena.job.hashMap;
+
+static char* formatHex(char* out, uint32_t value) {
+  for (byte d = 0; d < 8; d++) {
+    byte nibble = (value >> (28 - 4 * d)) & 0x0F;
+    *out++ = nibble < 10 ? '0' + nibble : 'A' + nibble - 10;
+  }
+  return out;
+}
+
+static void queueUnit(unsigned long address) {
+  char* line = formatHex(arena.text, address);
+  *line++ = ' ';
+  line = formatHex(line, map.crc);
+  *line++ = '\r';
+  *line++ = '\n';
+  txRingWrite((const byte*)arena.text, line - arena.text);
+}
+
+static bool hashReady() {
+  return txRingFree() >= HASH_LINE_SPACE * HASH_LINES_MAX;
+}
+
+// Chunks do not line up with units on EEPROMs, so split them here
+static void hashConsume(unsigned long address, const byte* data, unsigned int len) {
+  while (len > 0) {
+    unsigned int n = min((unsigned long)len, map.unit - map.filled);
+    map.crc = crc32(map.crc, data, n);
+    map.filled += n;
+    address += n;
+    data += n;
+    len -= n;
+
+    if (map.filled == map.unit) {
+      queueUnit(address - map.unit);
+      map.filled = 0;
+      map.crc = 0;
+    }
+  }
+}
+
+static const ReadSink hashSink PROGMEM = {
+  hashReady,
+  hashConsume,
+  NULL,
+  PAGE_BUFFER_SIZE
+};
+
+static bool hashMapSequence() {
+  if (!map.running) {
+    map.running = true;
+    engineRead(map.dev, 0, map.unit * map.units, hashSink);
+    return false;
+  }
+
+  if (engineSucceeded()) {
+    Serial.print(F("Hash map done, "));
+    Serial.print(map.units);
+    Serial.print(F(" units in "));
+    Serial.print(millis() - map.startTime);
+    Serial.println(F(" ms"));
+  } else {
+    Serial.println(F("Hash map failed"));
+  }
+  return true;
+}
+
+void hashMapRun(const MemoryDevice& dev) {
+  Geometry geo;
+  DRIVER(dev, geometry)(dev.unit, geo);
+
+  map.dev = dev;
+  map.unit = (geo.flags & GEO_NEEDS_ERASE) ? geo.eraseSize : max((unsigned long)geo.pageSize, (unsigned long)HASHMAP_MIN_UNIT);
+  map.units = geo.capacity / map.unit;
+  map.filled = 0;
+  map.crc = 0;
+  map.running = false;
+  map.startTime = millis();
+
+  Serial.print(F("Hash map: "));
+  Serial.print(map.units);
+  Serial.print(F(" units of "));
+  Serial.print(map.unit);
+  Serial.println(F(" bytes"));
+
+  startSequence(hashMapSequence, NULL);
+}
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * Human-readable hex dump output
+ *
+ * Lines are formatted into a buffer and written in one call. With folding
+ * enabled, a full line identical to the previous one is replaced by a single
+ * '*' marker for the whole run (like `hexdump -C`); callers keep reading the
+ * bus at full speed while suppressed lines cost no link time.
+ */
+
+#include "arena.h"
+#include "hexdump.h"
+#include "txring.h"
+
+static const byte lineEnd[] = { '\r', '\n' };
+static const byte foldMarker[] = { '*', '\r', '\n' };
+
+// "0x" + 8 digits + ": " + 16 * "XX " + " | " + 16 chars
+static_assert(TEXT_BUFFER_SIZE >= 10 + 2 + 48 + 3 + 16, "TEXT_BUFFER_SIZE too small for a dump line");
+
+bool dumpFolding = true;
+
+void hexDumpBegin(HexDumpState& state, unsigned long address) {
+  state.address = address;
+  state.haveLast = false;
+  state.folded = false;
+}
+
+// Append "0x" and the address, zero padded to at least 4 hex digits
+static byte formatDumpAddress(char* out, unsigned long address) {
+  byte digits = 4;
+  while (digits < 8 && (address >> (4 * digits)) != 0) {
+    digits++;
+  }
+  
+  out[0] = '0';
+  out[1] = 'x';
+  for (byte d = 0; d < digits; d++) {
+    byte nibble = (address >> (4 * (digits - 1 - d))) & 0x0F;
+    out[2 + d] = nibble < 10 ? '0' + nibble : 'A' + nibble - 10;
+  }
+  return 2 + digits;
+}
+
+void hexDumpLine(HexDumpState& state, const byte* data, byte len) {
+  // Fold full lines that repeat the previous one
+  if (dumpFolding && len == sizeof(state.lastLine)) {
+    if (state.haveLast && memcmp(state.lastLine, data, len) == 0) {
+      if (!state.folded) {
+        txRingWrite(foldMarker, sizeof(foldMarker));
+        state.folded = true;
+      }
+      state.address += len;
+      return;
+    }
+    memcpy(state.lastLine, data, len);
+    state.haveLast = true;
+  }
+  state.folded = false;
+  
+  char* line = arena.text;
+  byte pos = formatDumpAddress(line, state.address);
+  line[pos++] = ':';
+  line[pos++] = ' ';
+  
+  // Print hex values, padded with spaces if not a full line
+  for (byte i = 0; i < 16; i++) {
+    if (i < len) {
+      byte hi = data[i] >> 4;
+      byte lo = data[i] & 0x0F;
+      line[pos++] = hi < 10 ? '0' + hi : 'A' + hi - 10;
+      line[pos++] = lo < 10 ? '0' + lo : 'A' + lo - 10;
+    } else {
+      line[pos++] = ' ';
+      line[pos++] = ' ';
+    }
+    line[pos++] = ' ';
+  }
+  
+  line[pos++] = ' ';
+  line[pos++] = '|';
+  line[pos++] = ' ';
+  
+  // Print ASCII chars if printable
+  for (byte i = 0; i < len; i++) {
+    line[pos++] = (data[i] >= 32 && data[i] <= 126) ? data[i] : '.';
+  }
+  
+  txRingWrite((const byte*)line, pos);
+  txRingWrite(lineEnd, sizeof(lineEnd));
+  state.address += len;
+}
+
+void hexDumpEnd(HexDumpState& state) {
+  // A dump ending inside a folded run prints its end address, like hexdump
+  if (state.folded) {
+    char* line = arena.text;
+    byte pos = formatDumpAddress(line, state.address);
+    txRingWrite((const byte*)line, pos);
+    txRingWrite(lineEnd, sizeof(lineEnd));
+  }
+}
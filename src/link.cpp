@@ -0,0 +1,149 @@
+/**
+ * Serial link speed negotiation - see link.h
+ */
+
+#include "arena.h"
+#include "crc.h"
+#include "link.h"
+#include "scheduler.h"
+
+#if FEATURE_LINK
+
+static const char syncWord[] = "LINK";
+
+enum LinkState {
+  LINK_DRAIN,    // Announcement still going out at the old rate
+  LINK_SYNC,     // Waiting for the host's sync word at the new rate
+  LINK_ECHO,     // Echoing test data
+  LINK_CONFIRM,  // Waiting for the host to accept the rate
+  LINK_REVERT    // Going back to the previous rate
+};
+
+unsigned long linkBaud = SERIAL_BAUD;
+
+static LinkNegotiation& negotiation = arena.job.link;
+
+// The Arduino core uses double speed mode: UBRR = (F_CPU / 4 / baud - 1) / 2
+bool linkRateSupported(unsigned long baud) {
+  if (baud < 9600 || baud > F_CPU / 8) {
+    return false;
+  }
+
+  unsigned long ubrr = (F_CPU / 4 / baud - 1) / 2;
+  unsigned long actual = F_CPU / 8 / (ubrr + 1);
+  unsigned long error = actual > baud ? actual - baud : baud - actual;
+  return error * 40 <= baud;
+}
+
+static bool txDrained() {
+  return Serial.availableForWrite() >= SERIAL_TX_BUFFER_SIZE - 1;
+}
+
+static void switchRate(unsigned long baud) {
+  Serial.flush();  // Only the last byte is still shifting out
+  Serial.begin(baud);
+  linkBaud = baud;
+  negotiation.lastActivity = millis();
+}
+
+static bool linkStep() {
+  switch (negotiation.state) {
+    case LINK_DRAIN:
+      if (txDrained()) {
+        switchRate(negotiation.baud);
+        negotiation.state = LINK_SYNC;
+      }
+      return false;
+
+    case LINK_SYNC:
+      // Bytes received around the switch are noise until the sync word
+      while (Serial.available()) {
+        char c = Serial.read();
+        if (c == syncWord[negotiation.matched]) {
+          negotiation.matched++;
+        } else {
+          negotiation.matched = (c == syncWord[0]) ? 1 : 0;
+        }
+
+        if (negotiation.matched == sizeof(syncWord) - 1) {
+          negotiation.state = LINK_ECHO;
+          negotiation.lastActivity = millis();
+          return false;
+        }
+      }
+      break;
+
+    case LINK_ECHO: {
+      unsigned int before = negotiation.count;
+      while (negotiation.count < LINK_TEST_BYTES && Serial.available() && Serial.availableForWrite() > 0) {
+        byte c = Serial.read();
+        Serial.write(c);
+        negotiation.crc = crc32(negotiation.crc, &c, 1);
+        negotiation.count++;
+      }
+      if (negotiation.count != before) {
+        negotiation.lastActivity = millis();
+      }
+
+      if (negotiation.count == LINK_TEST_BYTES && outputReady()) {
+        Serial.print(F("\nCRC "));
+        Serial.println(negotiation.crc, HEX);
+        negotiation.state = LINK_CONFIRM;
+        negotiation.lastActivity = millis();
+      }
+      break;
+    }
+
+    case LINK_CONFIRM:
+      while (Serial.available()) {
+        char c = Serial.read();
+        if (c == '\n' || c == '\r') {
+          continue;
+        }
+        if (c == 'y') {
+          Serial.print(F("Link at "));
+          Serial.print(linkBaud);
+          Serial.println(F(" baud"));
+          return true;
+        }
+        negotiation.state = LINK_REVERT;
+        return false;
+      }
+      break;
+
+    case LINK_REVERT:
+      if (!txDrained()) {
+        return false;
+      }
+      switchRate(negotiation.previous);
+      Serial.print(F("Link back at "));
+      Serial.print(linkBaud);
+      Serial.println(F(" baud"));
+      return true;
+  }
+
+  // The host never followed, or stopped part way
+  if (millis() - negotiation.lastActivity > LINK_TIMEOUT_MS) {
+    negotiation.state = LINK_REVERT;
+  }
+  return false;
+}
+
+void linkNegotiate(unsigned long baud) {
+  Serial.print(F("Switching to "));
+  Serial.print(baud);
+  Serial.println(F(" baud"));
+
+  negotiation.baud = baud;
+  negotiation.previous = linkBaud;
+  negotiation.state = LINK_DRAIN;
+  negotiation.matched = 0;
+  negotiation.count = 0;
+  negotiation.crc = 0;
+  negotiation.lastActivity = millis();
+
+  // The test data is raw input, so ESC must not abort the job
+  startJob(linkStep, NULL, JOB_RAW_INPUT);
+}
+
+#endif
@@ -13,44 +13,26 @@
  #include <Arduino.h>
  #include <SPI.h>
  #include <Wire.h>
- 
- // Define pin configurations
- #define SPI_CS_PIN      10  // SPI Chip Select
- #define NAND_CLE_PIN    A0  // NAND Command Latch Enable
- #define NAND_ALE_PIN    A1  // NAND Address Latch Enable
- #define NAND_WE_PIN     A2  // NAND Write Enable
- #define NAND_RE_PIN     A3  // NAND Read Enable
- #define NAND_CE_PIN     A4  // NAND Chip Enable
- #define NAND_RB_PIN     A5  // NAND Ready/Busy
- 
- // Debug settings
- #define DEBUG_MODE      1   // Set to 0 to disable debug messages
- #define SERIAL_BAUD     115200
- 
- // Commands for SPI Flash
- #define SPI_CMD_WRITE_ENABLE      0x06
- #define SPI_CMD_WRITE_DISABLE     0x04
- #define SPI_CMD_READ_STATUS       0x05
- #define SPI_CMD_WRITE_STATUS      0x01
- #define SPI_CMD_READ_DATA         0x03
- #define SPI_CMD_FAST_READ         0x0B
- #define SPI_CMD_PAGE_PROGRAM      0x02
- #define SPI_CMD_SECTOR_ERASE      0x20
- #define SPI_CMD_BLOCK_ERASE_32K   0x52
- #define SPI_CMD_BLOCK_ERASE_64K   0xD8
- #define SPI_CMD_CHIP_ERASE        0xC7
- #define SPI_CMD_READ_ID           0x9F
- 
- // Common NAND commands
- #define NAND_CMD_READ_ID          0x90
- #define NAND_CMD_READ_STATUS      0x70
- #define NAND_CMD_READ             0x00
- #define NAND_CMD_READ_CONFIRM     0x30
- #define NAND_CMD_PROGRAM          0x80
- #define NAND_CMD_PROGRAM_CONFIRM  0x10
- #define NAND_CMD_ERASE            0x60
- #define NAND_CMD_ERASE_CONFIRM    0xD0
- #define NAND_CMD_RESET            0xFF
+ #include "blockmap.h"
+ #include "cache.h"
+ #include "checkpoint.h"
+ #include "clone.h"
+ #include "config.h"
+ #include "driver.h"
+ #include "engine.h"
+ #include "estimate.h"
+ #include "gang.h"
+ #include "hashmap.h"
+ #include "hexdump.h"
+ #include "link.h"
+ #include "memtest.h"
+ #include "parse.h"
+ #include "pattern.h"
+ #include "scheduler.h"
+ #include "script.h"
+ #include "search.h"
+ #include "stats.h"
+ #include "trace.h"
  
  // Memory interface types
  enum MemoryType {
@@ -62,57 +44,125 @@
  
  // Global variables
  MemoryType currentMemoryType = MEM_UNKNOWN;
+ MemoryDevice activeDevice = { NULL, 0 };
  byte i2cAddress = 0x50;  // Default I2C EEPROM address
-
+ 
+ // Values collected by the prompts of the current command
+ struct CommandArgs {
+   char option;             // Erase option ('1'-'3')
+   byte mode;               // WriteMode of an image transfer
+   unsigned long address;   // Start address
+   byte unit;               // Target chip of a clone
+   byte pattern;            // PatternKind of a fill or check
+   unsigned long seed;      // Pattern seed
+   unsigned long length;    // Bytes of a memory test
+ };
+ 
+ CommandArgs args;
+ 
+ #define MAX_WRITE_BYTES  32  // Data bytes accepted by the write prompt
+ 
  // Function prototypes
- void hexDump(byte (*readFunc)(), unsigned int numBytes);
  void printMenu();
  void handleCommand(char cmd);
  void setMemoryType(MemoryType type);
+ bool memoryTypeSelected();
  void readDeviceID();
- void nandReadID();
- void spiReadID();
- void identifySPIFlash(byte manufacturerID, byte deviceID1, byte deviceID2);
- void i2cDetect();
  void readData();
- void nandReadData(unsigned long address, unsigned int numBytes);
- void spiReadData(unsigned long address, unsigned int numBytes);
- void i2cReadData(unsigned long address, unsigned int numBytes);
+ void onReadAddress(char* line);
+ void onReadCount(char* line);
  void writeData();
- void nandWriteData(unsigned long address, byte* data, unsigned int numBytes);
- void spiWriteData(unsigned long address, byte* data, unsigned int numBytes);
- void spiWritePage(unsigned long address, byte* data, unsigned int numBytes);
- void i2cWriteData(unsigned long address, byte* data, unsigned int numBytes);
+ void onWriteAddress(char* line);
+ void onWriteData(char* line);
+ #if FEATURE_IMAGE
+ void transferImage(byte mode);
+ void onImageAddress(char* line);
+ void onImageLength(char* line);
+ #endif
  void eraseMemory();
- void nandErase(char option, unsigned long address);
- void spiErase(char option, unsigned long address);
- void i2cErase(char option, unsigned long address);
+ void onEraseOption(char* line);
+ void onEraseAddress(char* line);
+ void onEraseConfirm(char* line);
+ #if FEATURE_CLONE
+ void cloneMemory();
+ void onCloneTarget(char* line);
+ void onCloneAddress(char* line);
+ void onCloneLength(char* line);
+ #endif
+ #if FEATURE_GANG
+ void gangProgram();
+ void onGangPins(char* line);
+ void onGangAddress(char* line);
+ void onGangLength(char* line);
+ #endif
+ #if FEATURE_PATTERN
+ void testPattern(char option);
+ void onPatternKind(char* line);
+ void onPatternSeed(char* line);
+ void onPatternAddress(char* line);
+ void onPatternLength(char* line);
+ #endif
+ #if FEATURE_BLOCKMAP
+ void mapMemory();
+ void onMapBlockSize(char* line);
+ #endif
+ #if FEATURE_SEARCH
+ void searchMemory();
+ void onSearchPatterns(char* line);
+ void onSearchAddress(char* line);
+ void onSearchLength(char* line);
+ #endif
+ #if FEATURE_MEMTEST
+ void memoryTest();
+ void onTestAddress(char* line);
+ void onTestLength(char* line);
+ void onTestCycles(char* line);
+ #endif
+ #if FEATURE_CHECKPOINT
+ void resumeJob();
+ void toggleCheckpointPersist();
+ #endif
+ #if FEATURE_SCRIPT
+ void uploadScript();
+ void onScriptLine(char* line);
+ void runScript();
+ #endif
+ #if FEATURE_ESTIMATE
+ void estimateJob();
+ void onEstimateStep(char* line);
+ #endif
  void readStatus();
- void nandReadStatus();
- void spiReadStatus();
- void i2cReadStatus();
- byte nandReadByte();
- void nandWriteByte(byte data);
- void nandReset();
- void waitForNandReady();
- bool waitForSpiReady();
+ #if FEATURE_LINK
+ void negotiateLink();
+ void onLinkBaud(char* line);
+ #endif
+ #if FEATURE_I2C
  void setI2CAddress();
- unsigned long readHexValue();
- unsigned int readDecValue();
+ void onI2CAddress(char* line);
+ void setEepromSize();
+ void onEepromSize(char* line);
+ #endif
+ bool parseHexArg(const char* text, unsigned long& value);
+ bool parseDecArg(const char* text, unsigned long& value);
+ bool validChipSelect(unsigned long pin);
+ bool wholeEraseUnits(const Geometry& geo, unsigned long address, unsigned long length);
  
  void setup() {
    // Initialize serial communication
    Serial.begin(SERIAL_BAUD);
    while (!Serial && millis() < 3000); // Wait for serial port to connect (max 3 seconds)
-   
+ 
    Serial.println(F("\nUniversal Hardware Programmer"));
    Serial.println(F("v1.0 - NAND/SPI/I2C Memory"));
-   
+ 
+   #if FEATURE_SPI
    // Configure SPI
    SPI.begin();
    pinMode(SPI_CS_PIN, OUTPUT);
    digitalWrite(SPI_CS_PIN, HIGH);
-   
+   #endif
+ 
+   #if FEATURE_NAND
    // Configure NAND pins
    pinMode(NAND_CLE_PIN, OUTPUT);
    pinMode(NAND_ALE_PIN, OUTPUT);
@@ -120,72 +170,270 @@
    pinMode(NAND_RE_PIN, OUTPUT);
    pinMode(NAND_CE_PIN, OUTPUT);
    pinMode(NAND_RB_PIN, INPUT);
-   
+ 
    // Initialize pins to safe state
    digitalWrite(NAND_CLE_PIN, LOW);
    digitalWrite(NAND_ALE_PIN, LOW);
    digitalWrite(NAND_WE_PIN, HIGH);
    digitalWrite(NAND_RE_PIN, HIGH);
    digitalWrite(NAND_CE_PIN, HIGH);
-   
+   #endif
+ 
+   #if FEATURE_I2C
    // Initialize I2C
    Wire.begin();
-   
+   #endif
+ 
+   schedulerInit(handleCommand);
+ 
    Serial.println(F("Hardware initialized\n"));
    printMenu();
+ 
+   #if FEATURE_CHECKPOINT
+   // A job cut short by a reset left its checkpoint in EEPROM
+   if (checkpointRestore()) {
+     checkpointPersist = true;
+     printCheckpoint();
+     if (!checkpoint.finished) {
+       Serial.println(F("Select the memory type and press R to resume\n"));
+     }
+   }
+   #endif
  }
  
  void loop() {
-   if (Serial.available()) {
-     char cmd = Serial.read();
-     handleCommand(cmd);
-   }
+   // Serial RX, the active memory job and progress output each get a turn
+   schedulerRun();
  }
  
  void printMenu() {
    Serial.println(F("==== COMMANDS ===="));
+   #if FEATURE_NAND
    Serial.println(F("1: Set NAND Flash mode"));
+   #endif
+   #if FEATURE_SPI
    Serial.println(F("2: Set SPI Flash mode"));
+   #endif
+   #if FEATURE_I2C
    Serial.println(F("3: Set I2C EEPROM mode"));
+   #endif
    Serial.println(F("i: Read device ID"));
    Serial.println(F("r: Read data"));
+   #if FEATURE_HASHMAP
+   Serial.println(F("H: Print CRC-32 of every erase unit"));
+   #endif
+   #if FEATURE_BLOCKMAP
+   Serial.println(F("u: Map blank, fill and entropy per block"));
+   #endif
+   #if FEATURE_SEARCH
+   Serial.println(F("/: Search for byte patterns"));
+   #endif
    Serial.println(F("w: Write data"));
+   #if FEATURE_IMAGE
+   Serial.println(F("p: Program image from host"));
+   Serial.println(F("d: Program image, skipping unchanged pages"));
+   Serial.println(F("V: Verify against image from host"));
+   Serial.println(F("Z: Toggle PackBits-compressed image transfers"));
+   #endif
+   Serial.println(F("W: Toggle verify-on-write"));
    Serial.println(F("e: Erase"));
+   #if FEATURE_PATTERN
+   Serial.println(F("f: Fill with test pattern"));
+   Serial.println(F("F: Check test pattern"));
+   #endif
+   #if FEATURE_MEMTEST
+   Serial.println(F("M: Memory test (March / endurance cycles)"));
+   #endif
+   #if FEATURE_CLONE
+   Serial.println(F("c: Clone onto a second chip"));
+   #endif
+   #if FEATURE_GANG
+   Serial.println(F("g: Gang program image into several SPI flashes"));
+   #endif
+   #if FEATURE_CHECKPOINT
+   Serial.println(F("j: Show job checkpoint"));
+   Serial.println(F("R: Resume interrupted job"));
+   Serial.println(F("k: Toggle keeping checkpoints in EEPROM"));
+   #endif
+   #if FEATURE_SCRIPT
+   Serial.println(F("S: Upload job script"));
+   Serial.println(F("x: Run job script"));
+   #endif
+   #if FEATURE_ESTIMATE
+   Serial.println(F("E: Estimate the time of a script step or the stored script"));
+   #endif
    Serial.println(F("s: Read status"));
+   #if FEATURE_STATS
+   Serial.println(F("t: Show and reset operation timings"));
+   #endif
+   #if FEATURE_CACHE
+   Serial.println(F("C: Show and reset page cache counters"));
+   #endif
+   #if FEATURE_TRACE
+   Serial.println(F("T: Dump and clear bus trace"));
+   #endif
+   #if FEATURE_LINK
+   Serial.println(F("b: Negotiate serial link speed"));
+   #endif
+   #if FEATURE_I2C
    Serial.println(F("a: Set I2C address (EEPROM mode)"));
+   Serial.println(F("z: Set I2C EEPROM size"));
+   #endif
+   Serial.println(F("v: Toggle duplicate-line folding in dumps"));
    Serial.println(F("h: Show this menu"));
    Serial.println();
  }
  
  void handleCommand(char cmd) {
    switch (cmd) {
+     #if FEATURE_NAND
      case '1':
        setMemoryType(MEM_NAND_FLASH);
        break;
+     #endif
+     #if FEATURE_SPI
      case '2':
        setMemoryType(MEM_SPI_FLASH);
        break;
+     #endif
+     #if FEATURE_I2C
      case '3':
        setMemoryType(MEM_I2C_EEPROM);
        break;
+     #endif
      case 'i':
        readDeviceID();
        break;
      case 'r':
        readData();
        break;
+     #if FEATURE_HASHMAP
+     case 'H':
+       if (memoryTypeSelected()) {
+         hashMapRun(activeDevice);
+       }
+       break;
+     #endif
+     #if FEATURE_BLOCKMAP
+     case 'u':
+       mapMemory();
+       break;
+     #endif
+     #if FEATURE_SEARCH
+     case '/':
+       searchMemory();
+       break;
+     #endif
      case 'w':
        writeData();
        break;
+     #if FEATURE_IMAGE
+     case 'p':
+       transferImage(WRITE_PROGRAM);
+       break;
+     case 'd':
+       transferImage(WRITE_DIFF);
+       break;
+     case 'V':
+       transferImage(WRITE_VERIFY);
+       break;
+     #endif
+     #if FEATURE_IMAGE
+     case 'Z':
+       imagePacked = !imagePacked;
+       Serial.print(F("PackBits image transfers "));
+       Serial.println(imagePacked ? F("enabled") : F("disabled"));
+       break;
+     #endif
+     case 'W':
+       writeVerify = !writeVerify;
+       Serial.print(F("Verify-on-write "));
+       Serial.println(writeVerify ? F("enabled") : F("disabled"));
+       break;
      case 'e':
        eraseMemory();
        break;
+     #if FEATURE_PATTERN
+     case 'f':
+     case 'F':
+       testPattern(cmd);
+       break;
+     #endif
+     #if FEATURE_MEMTEST
+     case 'M':
+       memoryTest();
+       break;
+     #endif
+     #if FEATURE_CLONE
+     case 'c':
+       cloneMemory();
+       break;
+     #endif
+     #if FEATURE_GANG
+     case 'g':
+       gangProgram();
+       break;
+     #endif
+     #if FEATURE_CHECKPOINT
+     case 'j':
+       printCheckpoint();
+       break;
+     case 'R':
+       resumeJob();
+       break;
+     case 'k':
+       toggleCheckpointPersist();
+       break;
+     #endif
+     #if FEATURE_SCRIPT
+     case 'S':
+       uploadScript();
+       break;
+     case 'x':
+       runScript();
+       break;
+     #endif
+     #if FEATURE_ESTIMATE
+     case 'E':
+       estimateJob();
+       break;
+     #endif
      case 's':
        readStatus();
        break;
+     #if FEATURE_STATS
+     case 't':
+       printStats();
+       break;
+     #endif
+     #if FEATURE_CACHE
+     case 'C':
+       printCacheStats();
+       break;
+     #endif
+     #if FEATURE_TRACE
+     case 'T':
+       printTrace();
+       break;
+     #endif
+     #if FEATURE_LINK
+     case 'b':
+       negotiateLink();
+       break;
+     #endif
+     #if FEATURE_I2C
      case 'a':
        setI2CAddress();
        break;
+     case 'z':
+       setEepromSize();
+       break;
+     #endif
+     case 'v':
+       dumpFolding = !dumpFolding;
+       Serial.print(F("Dump line folding "));
+       Serial.println(dumpFolding ? F("enabled") : F("disabled"));
+       break;
      case 'h':
        printMenu();
        break;
@@ -199,1089 +447,794 @@
  }
  
  void setMemoryType(MemoryType type) {
-   currentMemoryType = type;
-   
    // Initialize the selected interface
    switch (type) {
+     #if FEATURE_NAND
      case MEM_NAND_FLASH:
        Serial.println(F("NAND Flash mode selected"));
-       nandReset();
+       activeDevice.driver = &nandDriver;
+       activeDevice.unit = 0;
        break;
+     #endif
+     #if FEATURE_SPI
      case MEM_SPI_FLASH:
        Serial.println(F("SPI Flash mode selected"));
+       activeDevice.driver = &spiDriver;
+       activeDevice.unit = SPI_CS_PIN;
        break;
+     #endif
+     #if FEATURE_I2C
      case MEM_I2C_EEPROM:
        Serial.println(F("I2C EEPROM mode selected"));
        Serial.print(F("Current I2C address: 0x"));
        Serial.println(i2cAddress, HEX);
+       activeDevice.driver = &i2cDriver;
+       activeDevice.unit = i2cAddress;
        break;
+     #endif
      default:
        Serial.println(F("Unknown memory type!"));
+       return;
+   }
+ 
+   currentMemoryType = type;
+   engineBegin(activeDevice);
+ }
+ 
+ bool memoryTypeSelected() {
+   if (currentMemoryType == MEM_UNKNOWN) {
+     Serial.println(F("Please select memory type first!"));
+     return false;
    }
+   return true;
  }
  
  // ===== DEVICE ID FUNCTIONS =====
  
  void readDeviceID() {
-   if (currentMemoryType == MEM_UNKNOWN) {
-     Serial.println(F("Please select memory type first!"));
+   if (!memoryTypeSelected()) {
      return;
    }
-   
+ 
    Serial.println(F("Reading device ID..."));
-   
-   switch (currentMemoryType) {
-     case MEM_NAND_FLASH:
-       nandReadID();
-       break;
-     case MEM_SPI_FLASH:
-       spiReadID();
-       break;
-     case MEM_I2C_EEPROM:
-       i2cDetect();
-       break;
-     default:
-       Serial.println(F("Unknown memory type!"));
+   DRIVER(activeDevice, identify)(activeDevice.unit);
+ }
+ 
+ // ===== DATA READ/WRITE FUNCTIONS =====
+ 
+ void readData() {
+   if (!memoryTypeSelected()) {
+     return;
    }
+ 
+   promptLine(F("Enter start address (in hex):"), onReadAddress);
  }
  
- void nandReadID() {
-   // Select the chip
-   digitalWrite(NAND_CE_PIN, LOW);
-   
-   // Send READ ID command (0x90)
-   digitalWrite(NAND_CLE_PIN, HIGH);
-   nandWriteByte(NAND_CMD_READ_ID);
-   digitalWrite(NAND_CLE_PIN, LOW);
-   
-   // Send address 0x00
-   digitalWrite(NAND_ALE_PIN, HIGH);
-   nandWriteByte(0x00);
-   digitalWrite(NAND_ALE_PIN, LOW);
-   
-   // Read ID bytes (typically 5 bytes)
-   Serial.print(F("Manufacturer ID: 0x"));
-   Serial.println(nandReadByte(), HEX);
-   
-   Serial.print(F("Device ID: 0x"));
-   Serial.println(nandReadByte(), HEX);
-   
-   Serial.print(F("Third ID byte: 0x"));
-   Serial.println(nandReadByte(), HEX);
-   
-   Serial.print(F("Fourth ID byte: 0x"));
-   Serial.println(nandReadByte(), HEX);
-   
-   Serial.print(F("Fifth ID byte: 0x"));
-   Serial.println(nandReadByte(), HEX);
-   
-   // Deselect the chip
-   digitalWrite(NAND_CE_PIN, HIGH);
+ void onReadAddress(char* line) {
+   if (parseHexArg(line, args.address)) {
+     promptLine(F("Enter number of bytes to read:"), onReadCount);
+   }
  }
  
- void spiReadID() {
-   digitalWrite(SPI_CS_PIN, LOW);
-   SPI.transfer(SPI_CMD_READ_ID);  // JEDEC ID command
-   
-   byte manufacturerID = SPI.transfer(0);
-   byte deviceID1 = SPI.transfer(0);
-   byte deviceID2 = SPI.transfer(0);
-   
-   digitalWrite(SPI_CS_PIN, HIGH);
-   
-   Serial.print(F("Manufacturer ID: 0x"));
-   Serial.println(manufacturerID, HEX);
-   
-   Serial.print(F("Device ID: 0x"));
-   Serial.print(deviceID1, HEX);
-   Serial.println(deviceID2, HEX);
-   
-   // Try to identify common chips
-   identifySPIFlash(manufacturerID, deviceID1, deviceID2);
+ void onReadCount(char* line) {
+   unsigned long numBytes;
+   if (!parseDecArg(line, numBytes)) {
+     return;
+   }
+ 
+   Serial.print(F("Reading "));
+   Serial.print(numBytes);
+   Serial.print(F(" bytes from address 0x"));
+   Serial.println(args.address, HEX);
+ 
+   engineRead(activeDevice, args.address, numBytes, hexDumpSink);
  }
  
- void identifySPIFlash(byte manufacturerID, byte deviceID1, byte deviceID2) {
-   Serial.print(F("Device: "));
-   
-   switch (manufacturerID) {
-     case 0x01:  // Spansion/Cypress
-       Serial.print(F("Spansion/Cypress "));
-       break;
-     case 0x20:  // Micron/Numonyx/ST
-       Serial.print(F("Micron/ST "));
-       break;
-     case 0xEF:  // Winbond
-       Serial.print(F("Winbond "));
-       if (deviceID1 == 0x40) {
-         if (deviceID2 == 0x14) Serial.println(F("W25Q80 (8Mbit)"));
-         else if (deviceID2 == 0x15) Serial.println(F("W25Q16 (16Mbit)"));
-         else if (deviceID2 == 0x16) Serial.println(F("W25Q32 (32Mbit)"));
-         else if (deviceID2 == 0x17) Serial.println(F("W25Q64 (64Mbit)"));
-         else if (deviceID2 == 0x18) Serial.println(F("W25Q128 (128Mbit)"));
-         else Serial.println(F("Unknown W25Q series"));
-       } else {
-         Serial.println(F("Unknown model"));
-       }
-       break;
-     case 0xC2:  // Macronix
-       Serial.print(F("Macronix "));
-       break;
-     case 0xBF:  // SST
-       Serial.print(F("SST "));
-       break;
-     default:
-       Serial.println(F("Unknown manufacturer"));
+ void writeData() {
+   if (!memoryTypeSelected()) {
+     return;
    }
+ 
+   promptLine(F("Enter start address (in hex):"), onWriteAddress);
  }
  
- void i2cDetect() {
-   Serial.println(F("Scanning I2C bus for devices..."));
-   
-   byte count = 0;
-   for (byte addr = 0x08; addr < 0x78; addr++) {
-     Wire.beginTransmission(addr);
-     byte error = Wire.endTransmission();
-     
-     if (error == 0) {
-       Serial.print(F("Device found at address 0x"));
-       if (addr < 16) Serial.print("0");
-       Serial.print(addr, HEX);
-       
-       // Check if it's likely an EEPROM (most common at 0x50-0x57)
-       if (addr >= 0x50 && addr <= 0x57) {
-         Serial.println(F(" (likely EEPROM)"));
-       } else {
-         Serial.println();
-       }
-       count++;
+ void onWriteAddress(char* line) {
+   if (parseHexArg(line, args.address)) {
+     promptLine(F("Enter data (hex bytes separated by spaces, max 32 bytes):"), onWriteData);
+   }
+ }
+ 
+ void onWriteData(char* line) {
+   // Convert hex tokens to bytes in place: byte n is stored at line[n],
+   // which is never past the start of token n
+   byte* data = (byte*) line;
+   unsigned int numBytes = 0;
+   char* cursor = line;
+   char* token;
+ 
+   while (numBytes < MAX_WRITE_BYTES && (token = nextToken(cursor)) != NULL) {
+     unsigned long value;
+     if (!parseHex(token, value) || value > 0xFF) {
+       Serial.println(F("Invalid data byte"));
+       return;
      }
+     data[numBytes++] = value;
    }
-   
-   if (count == 0) {
-     Serial.println(F("No I2C devices found!"));
+ 
+   Serial.print(F("Writing "));
+   Serial.print(numBytes);
+   Serial.print(F(" bytes to address 0x"));
+   Serial.println(args.address, HEX);
+ 
+   setMemorySource(data);
+   engineWrite(activeDevice, args.address, numBytes, memorySource, WRITE_PROGRAM);
+ }
+ 
+ #if FEATURE_IMAGE
+ // Program, diff-program or verify with raw image bytes sent by the host
+ void transferImage(byte mode) {
+   if (!memoryTypeSelected()) {
+     return;
    }
+ 
+   args.mode = mode;
+   promptLine(F("Enter start address (in hex):"), onImageAddress);
  }
  
- // ===== DATA READ/WRITE FUNCTIONS =====
+ void onImageAddress(char* line) {
+   if (parseHexArg(line, args.address)) {
+     promptLine(F("Enter image length in bytes:"), onImageLength);
+   }
+ }
  
- void readData() {
-   if (currentMemoryType == MEM_UNKNOWN) {
-     Serial.println(F("Please select memory type first!"));
+ void onImageLength(char* line) {
+   unsigned long length;
+   if (!parseDecArg(line, length)) {
      return;
    }
-   
-   Serial.println(F("Enter start address (in hex):"));
-   unsigned long startAddr = readHexValue();
-   
-   Serial.println(F("Enter number of bytes to read:"));
-   unsigned int numBytes = readDecValue();
-   
-   if (numBytes > 256) {
-     Serial.println(F("Warning: Limiting to 256 bytes"));
-     numBytes = 256;
-   }
-   
-   Serial.print(F("Reading "));
-   Serial.print(numBytes);
-   Serial.print(F(" bytes from address 0x"));
-   Serial.println(startAddr, HEX);
-   
-   switch (currentMemoryType) {
-     case MEM_NAND_FLASH:
-       nandReadData(startAddr, numBytes);
+ 
+   Serial.print(F("Send "));
+   Serial.print(length);
+   Serial.println(F(" bytes of image data as requested"));
+ 
+   engineWrite(activeDevice, args.address, length, hostSource, args.mode);
+ }
+ #endif
+ 
+ // ===== ERASE FUNCTIONS =====
+ 
+ void eraseMemory() {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
+   Serial.println(F("Erase options:"));
+   Serial.println(F("1. Sector erase"));
+   Serial.println(F("2. Block erase"));
+   Serial.println(F("3. Chip erase"));
+   promptLine(F("Select option:"), onEraseOption);
+ }
+ 
+ void onEraseOption(char* line) {
+   // ESC leaves the prompt; anything but 1, 2 or 3 asks again
+   unsigned long option;
+   if (!parseDec(line, option) || option < 1 || option > 3) {
+     Serial.println(F("Invalid option"));
+     promptLine(F("Select option:"), onEraseOption);
+     return;
+   }
+   args.option = '0' + option;
+ 
+   switch (args.option) {
+     case '1':
+     case '2':
+       promptLine(F("Enter start address (in hex):"), onEraseAddress);
        break;
-     case MEM_SPI_FLASH:
-       spiReadData(startAddr, numBytes);
+     case '3':
+       Serial.println(F("WARNING: This will erase the entire chip!"));
+       promptLine(F("Type 'YES' to confirm:"), onEraseConfirm);
        break;
-     case MEM_I2C_EEPROM:
-       i2cReadData(startAddr, numBytes);
+   }
+ }
+ 
+ void onEraseAddress(char* line) {
+   Geometry geo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+ 
+   // Erase the whole sector or block containing the address
+   unsigned long size = (args.option == '1') ? geo.eraseSize : geo.blockSize;
+   unsigned long address;
+   if (!parseHexArg(line, address)) {
+     return;
+   }
+   address -= address % size;
+ 
+   Serial.print(args.option == '1' ? F("Erasing sector at 0x") : F("Erasing block at 0x"));
+   Serial.println(address, HEX);
+   engineErase(activeDevice, address, size);
+ }
+ 
+ void onEraseConfirm(char* line) {
+   if (strcmp(line, "YES") != 0) {
+     Serial.println(F("Erase aborted!"));
+     return;
+   }
+ 
+   Geometry geo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+ 
+   Serial.println(F("Erasing entire chip..."));
+   engineErase(activeDevice, 0, geo.capacity);
+ }
+ 
+ // ===== TEST PATTERN FUNCTIONS =====
+ 
+ #if FEATURE_PATTERN
+ // Fill ('f') or check ('F') a range with generated data
+ void testPattern(char option) {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
+   args.option = option;
+   printPatterns();
+   promptLine(F("Select pattern:"), onPatternKind);
+ }
+ 
+ void onPatternKind(char* line) {
+   unsigned long kind;
+   if (!parseDecArg(line, kind)) {
+     return;
+   }
+   if (kind < 1 || kind > PATTERN_COUNT) {
+     Serial.println(F("Invalid option"));
+     return;
+   }
+ 
+   args.pattern = kind - 1;
+   args.seed = 0;
+   switch (args.pattern) {
+     case PATTERN_CONSTANT:
+     case PATTERN_INCREMENT:
+     case PATTERN_RANDOM:
+       promptLine(F("Enter seed (in hex):"), onPatternSeed);
        break;
      default:
-       Serial.println(F("Unknown memory type!"));
+       promptLine(F("Enter start address (in hex):"), onPatternAddress);
    }
  }
  
- void nandReadData(unsigned long address, unsigned int numBytes) {
-   // Basic implementation for small page NAND
-   // For modern NAND, more complex ECC would be needed
-   
-   unsigned int pageSize = 512;  // Adjust based on your NAND flash
-   unsigned int page = address / pageSize;
-   unsigned int offset = address % pageSize;
-   
-   // Select the chip
-   digitalWrite(NAND_CE_PIN, LOW);
-   
-   // Send READ command
-   digitalWrite(NAND_CLE_PIN, HIGH);
-   nandWriteByte(NAND_CMD_READ);
-   digitalWrite(NAND_CLE_PIN, LOW);
-   
-   // Send address bytes
-   digitalWrite(NAND_ALE_PIN, HIGH);
-   nandWriteByte(offset & 0xFF);        // Column address low byte
-   nandWriteByte((offset >> 8) & 0xFF); // Column address high byte (if needed)
-   nandWriteByte(page & 0xFF);          // Page address low byte
-   nandWriteByte((page >> 8) & 0xFF);   // Page address high byte
-   nandWriteByte((page >> 16) & 0xFF);  // Page address highest byte (if needed)
-   digitalWrite(NAND_ALE_PIN, LOW);
-   
-   // Send READ confirm command
-   digitalWrite(NAND_CLE_PIN, HIGH);
-   nandWriteByte(NAND_CMD_READ_CONFIRM);
-   digitalWrite(NAND_CLE_PIN, LOW);
-   
-   // Wait for the device to be ready
-   waitForNandReady();
-   
-   // Read and display data
-   hexDump(nandReadByte, numBytes);
-   
-   // Deselect the chip
-   digitalWrite(NAND_CE_PIN, HIGH);
+ void onPatternSeed(char* line) {
+   if (parseHexArg(line, args.seed)) {
+     promptLine(F("Enter start address (in hex):"), onPatternAddress);
+   }
  }
  
- void spiReadData(unsigned long address, unsigned int numBytes) {
-   digitalWrite(SPI_CS_PIN, LOW);
-   
-   // Send Fast Read command
-   SPI.transfer(SPI_CMD_FAST_READ);
-   
-   // Send 24-bit address (MSB first)
-   SPI.transfer((address >> 16) & 0xFF);
-   SPI.transfer((address >> 8) & 0xFF);
-   SPI.transfer(address & 0xFF);
-   
-   // Dummy byte for fast read
-   SPI.transfer(0);
-   
-   // Read and display data
-   byte buffer[16];
-   for (unsigned int i = 0; i < numBytes; i++) {
-     if (i % 16 == 0) {
-       // Print address at start of line
-       if (i > 0) {
-         Serial.println();
-       }
-       Serial.print("0x");
-       if ((address + i) < 0x1000) Serial.print("0");
-       if ((address + i) < 0x100) Serial.print("0");
-       if ((address + i) < 0x10) Serial.print("0");
-       Serial.print(address + i, HEX);
-       Serial.print(": ");
-     }
-     
-     // Read byte
-     buffer[i % 16] = SPI.transfer(0);
-     
-     // Print hex value
-     if (buffer[i % 16] < 0x10) Serial.print("0");
-     Serial.print(buffer[i % 16], HEX);
-     Serial.print(" ");
-     
-     // Print ASCII representation at end of line
-     if ((i % 16 == 15) || (i == numBytes - 1)) {
-       // Pad with spaces if not a full line
-       for (int j = (i % 16) + 1; j < 16; j++) {
-         Serial.print("   ");
-       }
-       
-       Serial.print(" | ");
-       
-       // Print ASCII chars if printable
-       for (int j = 0; j <= (i % 16); j++) {
-         if (buffer[j] >= 32 && buffer[j] <= 126) {
-           Serial.write(buffer[j]);
-         } else {
-           Serial.print(".");
-         }
-       }
-     }
+ void onPatternAddress(char* line) {
+   if (parseHexArg(line, args.address)) {
+     promptLine(F("Enter number of bytes:"), onPatternLength);
    }
-   
-   digitalWrite(SPI_CS_PIN, HIGH);
-   Serial.println();
  }
  
- void i2cReadData(unsigned long address, unsigned int numBytes) {
-   // Check if device is present
-   Wire.beginTransmission(i2cAddress);
-   byte error = Wire.endTransmission();
-   
-   if (error != 0) {
-     Serial.print(F("Error: Device at address 0x"));
-     Serial.print(i2cAddress, HEX);
-     Serial.println(F(" not responding"));
+ void onPatternLength(char* line) {
+   unsigned long length;
+   if (!parseDecArg(line, length)) {
      return;
    }
-   
-   // For larger EEPROMs, handle 16-bit addressing
-   bool use16bitAddr = (address > 0xFF); 
-   
-   // Read data in chunks (Wire library typically has a 32-byte buffer)
-   const byte chunkSize = 16;
-   byte buffer[chunkSize];
-   
-   for (unsigned int i = 0; i < numBytes; i += chunkSize) {
-     unsigned int bytesToRead = min(chunkSize, numBytes - i);
-     unsigned long currentAddr = address + i;
-     
-     // Start write operation to set address pointer in EEPROM
-     Wire.beginTransmission(i2cAddress);
-     
-     if (use16bitAddr) {
-       Wire.write((currentAddr >> 8) & 0xFF); // MSB
-     }
-     
-     Wire.write(currentAddr & 0xFF); // LSB
-     Wire.endTransmission();
-     
-     // Read data
-     Wire.requestFrom(i2cAddress, bytesToRead);
-     
-     for (unsigned int j = 0; j < bytesToRead && Wire.available(); j++) {
-       buffer[j] = Wire.read();
-     }
-     
-     // Print data
-     for (unsigned int j = 0; j < bytesToRead; j++) {
-       if ((i + j) % 16 == 0) {
-         if (i + j > 0) Serial.println();
-         Serial.print("0x");
-         if ((address + i + j) < 0x1000) Serial.print("0");
-         if ((address + i + j) < 0x100) Serial.print("0");
-         if ((address + i + j) < 0x10) Serial.print("0");
-         Serial.print(address + i + j, HEX);
-         Serial.print(": ");
-       }
-       
-       if (buffer[j] < 0x10) Serial.print("0");
-       Serial.print(buffer[j], HEX);
-       Serial.print(" ");
-       
-       if ((i + j) % 16 == 15 || (i + j == numBytes - 1)) {
-         // Pad for alignment
-         for (int k = ((i + j) % 16) + 1; k < 16; k++) {
-           Serial.print("   ");
-         }
-         
-         Serial.print(" | ");
-         
-         // Print ASCII chars
-         for (int k = 0; k <= ((i + j) % 16); k++) {
-           if (k < bytesToRead) {
-             if (buffer[k] >= 32 && buffer[k] <= 126) {
-               Serial.write(buffer[k]);
-             } else {
-               Serial.print(".");
-             }
-           }
-         }
-       }
-     }
+ 
+   if (args.option == 'f') {
+     Serial.println(F("Filling..."));
+     patternFill(activeDevice, args.address, length, args.pattern, args.seed);
+   } else {
+     Serial.println(F("Checking..."));
+     patternCheck(activeDevice, args.address, length, args.pattern, args.seed);
    }
-   
-   Serial.println();
  }
+ #endif
  
- void writeData() {
-   if (currentMemoryType == MEM_UNKNOWN) {
-     Serial.println(F("Please select memory type first!"));
+ // ===== BLOCK MAP FUNCTIONS =====
+ 
+ #if FEATURE_BLOCKMAP
+ void mapMemory() {
+   if (!memoryTypeSelected()) {
      return;
    }
-   
-   Serial.println(F("Enter start address (in hex):"));
-   unsigned long startAddr = readHexValue();
-   
-   Serial.println(F("Enter data (hex bytes separated by spaces, max 32 bytes):"));
-   
-   // Wait for input
-   while (!Serial.available()) {
-     delay(100);
-   }
-   
-   // Parse hex bytes from input
-   String input = Serial.readStringUntil('\n');
-   input.trim();
-   
-   // Convert string to bytes
-   byte data[32];
-   unsigned int numBytes = 0;
-   
-   char* token = strtok((char*)input.c_str(), " ,");
-   while (token != NULL && numBytes < 32) {
-     // Convert hex string to byte
-     data[numBytes++] = strtol(token, NULL, 16);
-     token = strtok(NULL, " ,");
-   }
-   
-   Serial.print(F("Writing "));
-   Serial.print(numBytes);
-   Serial.print(F(" bytes to address 0x"));
-   Serial.println(startAddr, HEX);
-   
+ 
+   promptLine(F("Enter block size in bytes (0 for the erase unit):"), onMapBlockSize);
+ }
+ 
+ void onMapBlockSize(char* line) {
+   unsigned long blockSize;
+   if (!parseDecArg(line, blockSize)) {
+     return;
+   }
+ 
+   Geometry geo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+   if (blockSize % BLOCKMAP_MIN_BLOCK != 0 || blockSize > BLOCKMAP_MAX_BLOCK || blockSize > geo.capacity) {
+     Serial.print(F("Block size must be a multiple of "));
+     Serial.print(BLOCKMAP_MIN_BLOCK);
+     Serial.print(F(" up to "));
+     Serial.println(min(BLOCKMAP_MAX_BLOCK, geo.capacity));
+     return;
+   }
+ 
+   blockMapRun(activeDevice, blockSize);
+ }
+ #endif
+ 
+ // ===== SEARCH FUNCTIONS =====
+ 
+ #if FEATURE_SEARCH
+ void searchMemory() {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
+   promptLine(F("Enter patterns in hex, each with an optional /mask (e.g. 27051956 55AA/FF0F):"), onSearchPatterns);
+ }
+ 
+ void onSearchPatterns(char* line) {
+   if (!searchSetPatterns(line)) {
+     Serial.println(F("Invalid pattern"));
+     return;
+   }
+   promptLine(F("Enter start address (in hex):"), onSearchAddress);
+ }
+ 
+ void onSearchAddress(char* line) {
+   if (parseHexArg(line, args.address)) {
+     promptLine(F("Enter number of bytes (0 for the rest of the chip):"), onSearchLength);
+   }
+ }
+ 
+ void onSearchLength(char* line) {
+   unsigned long length;
+   if (!parseDecArg(line, length)) {
+     return;
+   }
+ 
+   Geometry geo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+   if (args.address >= geo.capacity) {
+     Serial.println(F("Address beyond the end of the chip"));
+     return;
+   }
+   if (length == 0 || length > geo.capacity - args.address) {
+     length = geo.capacity - args.address;
+   }
+ 
+   searchRun(activeDevice, args.address, length);
+ }
+ #endif
+ 
+ // ===== MEMORY TEST FUNCTIONS =====
+ 
+ #if FEATURE_MEMTEST
+ void memoryTest() {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
+   Serial.println(F("WARNING: The range will be erased and overwritten!"));
+   promptLine(F("Enter start address (in hex):"), onTestAddress);
+ }
+ 
+ void onTestAddress(char* line) {
+   if (parseHexArg(line, args.address)) {
+     promptLine(F("Enter number of bytes (0 for the rest of the chip):"), onTestLength);
+   }
+ }
+ 
+ void onTestLength(char* line) {
+   if (!parseDecArg(line, args.length)) {
+     return;
+   }
+ 
+   Geometry geo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+   if (args.address >= geo.capacity) {
+     Serial.println(F("Address beyond the end of the chip"));
+     return;
+   }
+   if (args.length == 0 || args.length > geo.capacity - args.address) {
+     args.length = geo.capacity - args.address;
+   }
+ 
+   if (!wholeEraseUnits(geo, args.address, args.length)) {
+     return;
+   }
+ 
+   promptLine(F("Enter number of cycles:"), onTestCycles);
+ }
+ 
+ void onTestCycles(char* line) {
+   unsigned long cycles;
+   if (!parseDecArg(line, cycles)) {
+     return;
+   }
+   if (cycles < 1 || cycles > 65535) {
+     Serial.println(F("Invalid number of cycles"));
+     return;
+   }
+ 
+   memTestRun(activeDevice, args.address, args.length, cycles);
+ }
+ #endif
+ 
+ // ===== CLONE FUNCTIONS =====
+ 
+ #if FEATURE_CLONE
+ void cloneMemory() {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
    switch (currentMemoryType) {
-     case MEM_NAND_FLASH:
-       nandWriteData(startAddr, data, numBytes);
-       break;
+     #if FEATURE_SPI
      case MEM_SPI_FLASH:
-       spiWriteData(startAddr, data, numBytes);
+       promptLine(F("Enter target chip select pin:"), onCloneTarget);
        break;
+     #endif
+     #if FEATURE_I2C
      case MEM_I2C_EEPROM:
-       i2cWriteData(startAddr, data, numBytes);
+       promptLine(F("Enter target I2C address (in hex):"), onCloneTarget);
        break;
+     #endif
      default:
-       Serial.println(F("Unknown memory type!"));
+       Serial.println(F("Cloning needs a second chip; NAND mode drives only one"));
    }
  }
  
- void nandWriteData(unsigned long address, byte* data, unsigned int numBytes) {
-   // Basic implementation for small page NAND
-   unsigned int pageSize = 512;  // Adjust based on your NAND flash
-   unsigned int page = address / pageSize;
-   unsigned int offset = address % pageSize;
-   
-   // Check if write crosses page boundary
-   if (offset + numBytes > pageSize) {
-     Serial.println(F("Error: Write crosses page boundary!"));
-     return;
-   }
-   
-   // Select the chip
-   digitalWrite(NAND_CE_PIN, LOW);
-   
-   // Send PROGRAM command
-   digitalWrite(NAND_CLE_PIN, HIGH);
-   nandWriteByte(NAND_CMD_PROGRAM);
-   digitalWrite(NAND_CLE_PIN, LOW);
-   
-   // Send address bytes
-   digitalWrite(NAND_ALE_PIN, HIGH);
-   nandWriteByte(offset & 0xFF);        // Column address low byte
-   nandWriteByte((offset >> 8) & 0xFF); // Column address high byte (if needed)
-   nandWriteByte(page & 0xFF);          // Page address low byte
-   nandWriteByte((page >> 8) & 0xFF);   // Page address high byte
-   nandWriteByte((page >> 16) & 0xFF);  // Page address highest byte (if needed)
-   digitalWrite(NAND_ALE_PIN, LOW);
-   
-   // Write data
-   for (unsigned int i = 0; i < numBytes; i++) {
-     nandWriteByte(data[i]);
-   }
-   
-   // Send PROGRAM confirm command
-   digitalWrite(NAND_CLE_PIN, HIGH);
-   nandWriteByte(NAND_CMD_PROGRAM_CONFIRM);
-   digitalWrite(NAND_CLE_PIN, LOW);
-   
-   // Wait for the device to be ready
-   waitForNandReady();
-   
-   // Check for program status
-   digitalWrite(NAND_CLE_PIN, HIGH);
-   nandWriteByte(NAND_CMD_READ_STATUS);
-   digitalWrite(NAND_CLE_PIN, LOW);
-   
-   byte status = nandReadByte();
-   
-   // Deselect the chip
-   digitalWrite(NAND_CE_PIN, HIGH);
-   
-   // Check if program was successful (bit 0 should be 0)
-   if (status & 0x01) {
-     Serial.println(F("Program failed!"));
+ void onCloneTarget(char* line) {
+   unsigned long unit;
+   bool valid;
+ 
+   if (currentMemoryType == MEM_SPI_FLASH) {
+     if (!parseDecArg(line, unit)) {
+       return;
+     }
+     valid = validChipSelect(unit);
    } else {
-     Serial.println(F("Program successful"));
+     if (!parseHexArg(line, unit)) {
+       return;
+     }
+     valid = unit >= 0x08 && unit <= 0x77;
    }
+ 
+   if (!valid || unit == activeDevice.unit) {
+     Serial.println(F("Invalid target! It must differ from the source"));
+     return;
+   }
+ 
+   args.unit = unit;
+   promptLine(F("Enter start address (in hex):"), onCloneAddress);
  }
  
- void spiWriteData(unsigned long address, byte* data, unsigned int numBytes) {
-   // Check if we're crossing page boundary (typically 256 bytes)
-   unsigned int pageSize = 256;
-   unsigned int offset = address % pageSize;
-   
-   if (offset + numBytes > pageSize) {
-     Serial.println(F("Warning: Write crosses page boundary!"));
-     
-     // Calculate bytes that fit in first page
-     unsigned int firstPageBytes = pageSize - offset;
-     
-     // Write first page
-     spiWritePage(address, data, firstPageBytes);
-     
-     // Write remaining bytes in next page
-     spiWritePage(address + firstPageBytes, data + firstPageBytes, numBytes - firstPageBytes);
-   } else {
-     // Write fits in a single page
-     spiWritePage(address, data, numBytes);
+ void onCloneAddress(char* line) {
+   if (parseHexArg(line, args.address)) {
+     promptLine(F("Enter number of bytes (0 for the rest of the chip):"), onCloneLength);
    }
  }
  
- void spiWritePage(unsigned long address, byte* data, unsigned int numBytes) {
-   // Enable write operations
-   digitalWrite(SPI_CS_PIN, LOW);
-   SPI.transfer(SPI_CMD_WRITE_ENABLE);
-   digitalWrite(SPI_CS_PIN, HIGH);
-   delay(1);
-   
-   // Send Page Program command
-   digitalWrite(SPI_CS_PIN, LOW);
-   SPI.transfer(SPI_CMD_PAGE_PROGRAM);
-   
-   // Send 24-bit address (MSB first)
-   SPI.transfer((address >> 16) & 0xFF);
-   SPI.transfer((address >> 8) & 0xFF);
-   SPI.transfer(address & 0xFF);
-   
-   // Send data
-   for (unsigned int i = 0; i < numBytes; i++) {
-     SPI.transfer(data[i]);
-   }
-   
-   digitalWrite(SPI_CS_PIN, HIGH);
-   
-   // Wait for write to complete
-   waitForSpiReady();
-   
-   Serial.println(F("Write complete"));
+ void onCloneLength(char* line) {
+   unsigned long length;
+   if (!parseDecArg(line, length)) {
+     return;
+   }
+ 
+   // The range has to fit on both chips
+   MemoryDevice target = { activeDevice.driver, args.unit };
+   Geometry geo, targetGeo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+   DRIVER(target, begin)(target.unit);
+   DRIVER(target, geometry)(target.unit, targetGeo);
+   unsigned long capacity = min(geo.capacity, targetGeo.capacity);
+   if (args.address >= capacity) {
+     Serial.println(F("Address beyond the end of the chip"));
+     return;
+   }
+   if (length == 0 || length > capacity - args.address) {
+     length = capacity - args.address;
+   }
+ 
+   if (!wholeEraseUnits(targetGeo, args.address, length)) {
+     return;
+   }
+ 
+   cloneRun(activeDevice, target, args.address, length);
  }
+ #endif
+ 
+ // ===== GANG PROGRAMMING FUNCTIONS =====
  
- void i2cWriteData(unsigned long address, byte* data, unsigned int numBytes) {
-   // Check if device is present
-   Wire.beginTransmission(i2cAddress);
-   byte error = Wire.endTransmission();
-   
-   if (error != 0) {
-     Serial.print(F("Error: Device at address 0x"));
-     Serial.print(i2cAddress, HEX);
-     Serial.println(F(" not responding"));
+ #if FEATURE_GANG
+ void gangProgram() {
+   if (currentMemoryType != MEM_SPI_FLASH) {
+     Serial.println(F("Gang programming is for SPI Flash mode"));
      return;
    }
-   
-   // For larger EEPROMs, handle 16-bit addressing
-   bool use16bitAddr = (address > 0xFF);
-   
-   // EEPROM page size (typically 8, 16, 32, or 64 bytes)
-   unsigned int pageSize = 8;  // Adjust based on your EEPROM
-   
-   // Write data in page-sized chunks (or smaller)
-   unsigned int bytesWritten = 0;
-   
-   while (bytesWritten < numBytes) {
-     // Calculate current address and offset within page
-     unsigned long currentAddr = address + bytesWritten;
-     unsigned int pageOffset = currentAddr % pageSize;
-     
-     // Calculate bytes to write in this page (don't cross page boundary)
-     unsigned int bytesToWrite = min(pageSize - pageOffset, numBytes - bytesWritten);
-     
-     // Begin write operation
-     Wire.beginTransmission(i2cAddress);
-     
-     // Write address bytes
-     if (use16bitAddr) {
-       Wire.write((currentAddr >> 8) & 0xFF); // MSB
+ 
+   promptLine(F("Enter chip select pins (separated by spaces):"), onGangPins);
+ }
+ 
+ void onGangPins(char* line) {
+   char* cursor = line;
+   char* token;
+   byte count = 0;
+ 
+   while ((token = nextToken(cursor)) != NULL) {
+     unsigned long pin;
+     if (!parseDecArg(token, pin)) {
+       return;
+     }
+     if (count == GANG_MAX_CHIPS) {
+       Serial.print(F("At most "));
+       Serial.print(GANG_MAX_CHIPS);
+       Serial.println(F(" chips"));
+       return;
+     }
+ 
+     bool repeated = false;
+     for (byte i = 0; i < count; i++) {
+       repeated |= spiGang.pins[i] == pin;
      }
-     Wire.write(currentAddr & 0xFF); // LSB
-     
-     // Write data bytes
-     for (unsigned int i = 0; i < bytesToWrite; i++) {
-       Wire.write(data[bytesWritten + i]);
+     if (!validChipSelect(pin) || repeated) {
+       Serial.print(F("Invalid chip select pin "));
+       Serial.println(pin);
+       return;
      }
-     
-     // Send data to device
-     Wire.endTransmission();
-     
-     // Wait for write cycle to complete (typically 5ms)
-     delay(5);
-     
-     bytesWritten += bytesToWrite;
-   }
-   
-   Serial.println(F("Write complete"));
+     spiGang.pins[count++] = pin;
+   }
+ 
+   if (count == 0) {
+     Serial.println(F("No chip select pins given"));
+     return;
+   }
+   spiGang.count = count;
+   promptLine(F("Enter start address (in hex):"), onGangAddress);
  }
  
- // ===== ERASE FUNCTIONS =====
+ void onGangAddress(char* line) {
+   if (!parseHexArg(line, args.address)) {
+     return;
+   }
  
- void eraseMemory() {
-   if (currentMemoryType == MEM_UNKNOWN) {
-     Serial.println(F("Please select memory type first!"));
+   Geometry geo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+   if (wholeEraseUnits(geo, args.address, 0)) {
+     promptLine(F("Enter image length in bytes:"), onGangLength);
+   }
+ }
+ 
+ void onGangLength(char* line) {
+   unsigned long length;
+   if (!parseDecArg(line, length)) {
      return;
    }
-   
-   Serial.println(F("Erase options:"));
-   Serial.println(F("1. Sector erase"));
-   Serial.println(F("2. Block erase"));
-   Serial.println(F("3. Chip erase"));
-   
-   while (!Serial.available()) {
-     delay(100);
-   }
-   
-   char option = Serial.read();
-   
-   unsigned long address = 0;
-   
-   if (option == '1' || option == '2') {
-     Serial.println(F("Enter start address (in hex):"));
-     address = readHexValue();
+ 
+   // Every chip erases the range before it is programmed
+   Geometry geo;
+   DRIVER(activeDevice, geometry)(activeDevice.unit, geo);
+   if (wholeEraseUnits(geo, args.address, length)) {
+     gangRun(args.address, length);
    }
-
-   String confirmation = ""; // Declare outside the switch to avoid bypassing initialization
-   switch (option) {
-     case '1':
-       Serial.print(F("Erasing sector at 0x"));
-       Serial.println(address, HEX);
-       break;
-     case '2':
-       Serial.print(F("Erasing block at 0x"));
-       Serial.println(address, HEX);
+ }
+ #endif
+ 
+ // ===== JOB CHECKPOINT FUNCTIONS =====
+ 
+ #if FEATURE_CHECKPOINT
+ void resumeJob() {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
+   if (checkpoint.op == OP_NONE || checkpoint.finished) {
+     Serial.println(F("No interrupted job to resume"));
+     return;
+   }
+ 
+   if (checkpoint.dev.driver != activeDevice.driver || checkpoint.dev.unit != activeDevice.unit) {
+     Serial.println(F("The job was for another device; select it first"));
+     return;
+   }
+ 
+   Serial.print(F("Resuming at 0x"));
+   Serial.print(checkpoint.start + checkpoint.done, HEX);
+   Serial.print(F(", "));
+   Serial.print(checkpoint.length - checkpoint.done);
+   Serial.println(F(" bytes left"));
+ 
+   engineResume(activeDevice);
+ }
+ 
+ void toggleCheckpointPersist() {
+   checkpointPersist = !checkpointPersist;
+   Serial.print(F("Checkpoints in EEPROM "));
+   Serial.println(checkpointPersist ? F("enabled") : F("disabled"));
+ }
+ #endif
+ 
+ // ===== JOB SCRIPT FUNCTIONS =====
+ 
+ #if FEATURE_SCRIPT
+ void uploadScript() {
+   scriptClear();
+   promptLine(F("Enter script steps, one per line, 'end' to finish:"), onScriptLine);
+ }
+ 
+ void onScriptLine(char* line) {
+   switch (scriptAddLine(line)) {
+     case SCRIPT_LINE_OK:
+       promptLine(F("ok"), onScriptLine);
        break;
-     case '3':
-       Serial.println(F("WARNING: This will erase the entire chip!"));
-       Serial.println(F("Type 'YES' to confirm:"));
-       
-       while (!Serial.available()) {
-         delay(100);
-       }
-       
-       confirmation = Serial.readStringUntil('\n');
-       confirmation.trim();
-       
-       if (confirmation != "YES") {
-         Serial.println(F("Erase aborted!"));
-         return;
-       }
-       
-       Serial.println(F("Erasing entire chip..."));
+     case SCRIPT_LINE_END:
+       Serial.print(F("Script stored, "));
+       Serial.print(scriptLength());
+       Serial.println(F(" steps"));
        break;
      default:
-       Serial.println(F("Invalid option"));
-       return;
+       Serial.println(F("Invalid step, script discarded"));
    }
-   
-   switch (currentMemoryType) {
-     case MEM_NAND_FLASH:
-       nandErase(option, address);
-       break;
-     case MEM_SPI_FLASH:
-       spiErase(option, address);
-       break;
-     case MEM_I2C_EEPROM:
-       i2cErase(option, address);
-       break;
-    default:
-      Serial.println(F("Unknown memory type!"));
-  }
-}
-
-void nandErase(char option, unsigned long address) {
-  // Select the chip
-  digitalWrite(NAND_CE_PIN, LOW);
-  
-  // Send ERASE command
-  digitalWrite(NAND_CLE_PIN, HIGH);
-  nandWriteByte(NAND_CMD_ERASE);
-  digitalWrite(NAND_CLE_PIN, LOW);
-  
-  if (option == '1' || option == '2') {
-    // For NAND, we erase blocks (no sector erase)
-    unsigned int blockSize = 16 * 1024; // 16KB blocks, adjust as needed
-    unsigned int block = address / blockSize;
-    
-    // Send row address for the block
-    digitalWrite(NAND_ALE_PIN, HIGH);
-    nandWriteByte(block & 0xFF);          // Block address low byte
-    nandWriteByte((block >> 8) & 0xFF);   // Block address high byte
-    nandWriteByte((block >> 16) & 0xFF);  // Block address highest byte (if needed)
-    digitalWrite(NAND_ALE_PIN, LOW);
-  }
-  
-  // Send ERASE confirm command
-  digitalWrite(NAND_CLE_PIN, HIGH);
-  nandWriteByte(NAND_CMD_ERASE_CONFIRM);
-  digitalWrite(NAND_CLE_PIN, LOW);
-  
-  // Wait for the device to be ready
-  waitForNandReady();
-  
-  // Check for erase status
-  digitalWrite(NAND_CLE_PIN, HIGH);
-  nandWriteByte(NAND_CMD_READ_STATUS);
-  digitalWrite(NAND_CLE_PIN, LOW);
-  
-  byte status = nandReadByte();
-  
-  // Deselect the chip
-  digitalWrite(NAND_CE_PIN, HIGH);
-  
-  // Check if erase was successful (bit 0 should be 0)
-  if (status & 0x01) {
-    Serial.println(F("Erase failed!"));
-  } else {
-    Serial.println(F("Erase successful"));
-  }
-}
-
-void spiErase(char option, unsigned long address) {
-  // Enable write operations
-  digitalWrite(SPI_CS_PIN, LOW);
-  SPI.transfer(SPI_CMD_WRITE_ENABLE);
-  digitalWrite(SPI_CS_PIN, HIGH);
-  delay(1);
-  
-  digitalWrite(SPI_CS_PIN, LOW);
-  
-  switch (option) {
-    case '1': // Sector erase (4KB)
-      SPI.transfer(SPI_CMD_SECTOR_ERASE);
-      SPI.transfer((address >> 16) & 0xFF);
-      SPI.transfer((address >> 8) & 0xFF);
-      SPI.transfer(address & 0xFF);
-      break;
-    case '2': // Block erase (64KB)
-      SPI.transfer(SPI_CMD_BLOCK_ERASE_64K);
-      SPI.transfer((address >> 16) & 0xFF);
-      SPI.transfer((address >> 8) & 0xFF);
-      SPI.transfer(address & 0xFF);
-      break;
-    case '3': // Chip erase
-      SPI.transfer(SPI_CMD_CHIP_ERASE);
-      break;
-  }
-  
-  digitalWrite(SPI_CS_PIN, HIGH);
-  
-  // Wait for erase to complete
-  unsigned long startTime = millis();
-  Serial.print(F("Erasing"));
-  
-  while (waitForSpiReady()) {
-    if (millis() - startTime > 500) {
-      Serial.print(".");
-      startTime = millis();
-    }
-  }
-  
-  Serial.println(F("\nErase complete"));
-}
-
-void i2cErase(char option, unsigned long address) {
-  if (option == '3') {
-    // Chip erase for EEPROM - fill with 0xFF
-    unsigned int pageSize = 8;  // Adjust based on your EEPROM
-    unsigned int maxSize = 32 * 1024; // Maximum size to erase (32KB)
-    
-    byte eraseData[8]; // Page-sized buffer of 0xFF
-    memset(eraseData, 0xFF, sizeof(eraseData));
-    
-    Serial.print(F("Erasing EEPROM"));
-    
-    for (unsigned int i = 0; i < maxSize; i += pageSize) {
-      i2cWriteData(i, eraseData, pageSize);
-      
-      if (i % 256 == 0) {
-        Serial.print(".");
-      }
-    }
-    
-    Serial.println(F("\nErase complete"));
-  } else {
-    // Sector/Block erase - For EEPROM, we're just writing 0xFF
-    unsigned int eraseSize = (option == '1') ? 256 : 4096; // Sector: 256B, Block: 4KB
-    
-    byte eraseData[8]; // Buffer of 0xFF
-    memset(eraseData, 0xFF, sizeof(eraseData));
-    
-    Serial.print(F("Erasing"));
-    
-    for (unsigned int i = 0; i < eraseSize; i += sizeof(eraseData)) {
-      i2cWriteData(address + i, eraseData, sizeof(eraseData));
-      
-      if (i % 64 == 0) {
-        Serial.print(".");
-      }
-    }
-    
-    Serial.println(F("\nErase complete"));
-  }
-}
+ }
+ 
+ void runScript() {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
+   if (scriptLength() == 0) {
+     Serial.println(F("No job script stored"));
+     return;
+   }
+ 
+   scriptRun(activeDevice);
+ }
+ #endif
+ 
+ #if FEATURE_ESTIMATE
+ void estimateJob() {
+   if (!memoryTypeSelected()) {
+     return;
+   }
+ 
+   promptLine(F("Enter a script step (e.g. program 0 10000) or 'script':"), onEstimateStep);
+ }
+ 
+ void onEstimateStep(char* line) {
+   if (!estimateRun(activeDevice, line)) {
+     Serial.println(F("Invalid step"));
+   }
+ }
+ #endif
 
 // ===== STATUS FUNCTIONS =====
 
 void readStatus() {
-  if (currentMemoryType == MEM_UNKNOWN) {
-    Serial.println(F("Please select memory type first!"));
+  if (!memoryTypeSelected()) {
     return;
   }
   
   Serial.println(F("Reading status register..."));
-  
-  switch (currentMemoryType) {
-    case MEM_NAND_FLASH:
-      nandReadStatus();
-      break;
-    case MEM_SPI_FLASH:
-      spiReadStatus();
-      break;
-    case MEM_I2C_EEPROM:
-      i2cReadStatus();
-      break;
-    default:
-      Serial.println(F("Unknown memory type!"));
-  }
+  DRIVER(activeDevice, status)(activeDevice.unit);
 }
 
-void nandReadStatus() {
-  // Select the chip
-  digitalWrite(NAND_CE_PIN, LOW);
-  
-  // Send READ STATUS command
-  digitalWrite(NAND_CLE_PIN, HIGH);
-  nandWriteByte(NAND_CMD_READ_STATUS);
-  digitalWrite(NAND_CLE_PIN, LOW);
-  
-  // Read status byte
-  byte status = nandReadByte();
-  
-  // Deselect the chip
-  digitalWrite(NAND_CE_PIN, HIGH);
-  
-  // Display status information
-  Serial.print(F("Status: 0x"));
-  Serial.println(status, HEX);
-  
-  Serial.print(F("Program/Erase Failed: "));
-  Serial.println((status & 0x01) ? "Yes" : "No");
-  
-  Serial.print(F("Ready/Busy: "));
-  Serial.println((status & 0x40) ? "Ready" : "Busy");
-  
-  Serial.print(F("Write Protected: "));
-  Serial.println((status & 0x80) ? "Yes" : "No");
-}
+// ===== UTILITY FUNCTIONS =====
 
-void spiReadStatus() {
-  digitalWrite(SPI_CS_PIN, LOW);
-  
-  SPI.transfer(SPI_CMD_READ_STATUS);
-  byte status = SPI.transfer(0);
-  
-  digitalWrite(SPI_CS_PIN, HIGH);
-  
-  // Display status information
-  Serial.print(F("Status Register: 0x"));
-  Serial.println(status, HEX);
-  
-  Serial.print(F("Busy: "));
-  Serial.println((status & 0x01) ? "Yes" : "No");
-  
-  Serial.print(F("Write Enable Latch: "));
-  Serial.println((status & 0x02) ? "Enabled" : "Disabled");
-  
-  Serial.print(F("Block Protection: "));
-  Serial.println((status >> 2) & 0x0F, BIN);
-  
-  Serial.print(F("Write Protect Enable: "));
-  Serial.println((status & 0x80) ? "Yes" : "No");
+#if FEATURE_LINK
+void negotiateLink() {
+  promptLine(F("Enter baud rate (e.g. 1000000):"), onLinkBaud);
 }
 
-void i2cReadStatus() {
-  // For I2C EEPROMs, there's typically no status register to read
-  // Instead, we check if the device responds
-  
-  Wire.beginTransmission(i2cAddress);
-  byte error = Wire.endTransmission();
-  
-  Serial.print(F("Device present: "));
-  Serial.println((error == 0) ? "Yes" : "No");
-  
-  if (error == 0) {
-    // Try to read one byte to see if the device is busy
-    // When busy with internal write cycle, the device won't ACK
-    Wire.beginTransmission(i2cAddress);
-    Wire.write(0); // Address 0
-    error = Wire.endTransmission();
-    
-    Serial.print(F("Device ready: "));
-    Serial.println((error == 0) ? "Yes" : "No");
+void onLinkBaud(char* line) {
+  unsigned long baud;
+  if (!parseDecArg(line, baud)) {
+    return;
   }
-}
 
-// ===== UTILITY FUNCTIONS =====
-
-byte nandReadByte() {
-  // Configure Arduino pins as inputs for reading data
-  DDRD &= 0x03; // Set pins 2-7 as inputs (D2-D7)
-  DDRB &= 0xFC; // Set pins 8-9 as inputs (D8-D9)
-  
-  // Assert read enable
-  digitalWrite(NAND_RE_PIN, LOW);
-  delayMicroseconds(1);
-  
-  // Read data from pins
-  byte data = 0;
-  data |= ((PIND >> 2) & 0x3F);    // Bits 0-5 from pins D2-D7
-  data |= ((PINB & 0x03) << 6);    // Bits 6-7 from pins D8-D9
-  
-  // De-assert read enable
-  digitalWrite(NAND_RE_PIN, HIGH);
-  delayMicroseconds(1);
-  
-  return data;
-}
+  if (!linkRateSupported(baud)) {
+    Serial.println(F("Unsupported baud rate! Try 250000, 500000, 1000000 or 2000000"));
+    return;
+  }
 
-void nandWriteByte(byte data) {
-  // Configure Arduino pins as outputs for writing data
-  DDRD |= 0xFC; // Set pins 2-7 as outputs (D2-D7)
-  DDRB |= 0x03; // Set pins 8-9 as outputs (D8-D9)
-  
-  // Output data to pins
-  PORTD = (PORTD & 0x03) | ((data & 0x3F) << 2); // Bits 0-5 to pins D2-D7
-  PORTB = (PORTB & 0xFC) | ((data >> 6) & 0x03); // Bits 6-7 to pins D8-D9
-  
-  // Assert write enable
-  digitalWrite(NAND_WE_PIN, LOW);
-  delayMicroseconds(1);
-  
-  // De-assert write enable
-  digitalWrite(NAND_WE_PIN, HIGH);
-  delayMicroseconds(1);
+  linkNegotiate(baud);
 }
+#endif
 
-void nandReset() {
-  // Select the chip
-  digitalWrite(NAND_CE_PIN, LOW);
-  
-  // Send RESET command
-  digitalWrite(NAND_CLE_PIN, HIGH);
-  nandWriteByte(NAND_CMD_RESET);
-  digitalWrite(NAND_CLE_PIN, LOW);
-  
-  // Wait for the device to be ready
-  waitForNandReady();
-  
-  // Deselect the chip
-  digitalWrite(NAND_CE_PIN, HIGH);
-  
-  Serial.println(F("NAND Flash reset complete"));
+#if FEATURE_I2C
+void setI2CAddress() {
+  promptLine(F("Enter I2C address (in hex, e.g. 50 for 0x50):"), onI2CAddress);
 }
 
-void waitForNandReady() {
-  // Wait for the RB pin to go high
-  unsigned long startTime = millis();
+void onI2CAddress(char* line) {
+  unsigned long newAddress;
+  if (!parseHexArg(line, newAddress)) {
+    return;
+  }
   
-  while (digitalRead(NAND_RB_PIN) == LOW) {
-    if (millis() - startTime > 1000) {
-      Serial.println(F("Warning: NAND Flash timeout"));
-      return;
+  if (newAddress >= 0x08 && newAddress <= 0x77) {
+    i2cAddress = newAddress;
+    if (currentMemoryType == MEM_I2C_EEPROM) {
+      activeDevice.unit = i2cAddress;
     }
+    Serial.print(F("I2C address set to 0x"));
+    Serial.println(i2cAddress, HEX);
+  } else {
+    Serial.println(F("Invalid I2C address! Valid range is 0x08-0x77"));
   }
 }
 
-bool waitForSpiReady() {
-  digitalWrite(SPI_CS_PIN, LOW);
-  SPI.transfer(SPI_CMD_READ_STATUS);
-  byte status = SPI.transfer(0);
-  digitalWrite(SPI_CS_PIN, HIGH);
-  
-  // Return true if busy (WIP bit set)
-  return (status & 0x01);
+void setEepromSize() {
+  promptLine(F("Enter EEPROM size in bytes (e.g. 256 for 24C02, 32768 for 24C256):"), onEepromSize);
 }
 
-void setI2CAddress() {
-  Serial.println(F("Enter I2C address (in hex, e.g. 50 for 0x50):"));
-  
-  while (!Serial.available()) {
-    delay(100);
+void onEepromSize(char* line) {
+  unsigned long size;
+  if (!parseDecArg(line, size)) {
+    return;
   }
   
-  String input = Serial.readStringUntil('\n');
-  input.trim();
-  
-  byte newAddress = strtol(input.c_str(), NULL, 16);
-  
-  if (newAddress >= 0x08 && newAddress <= 0x77) {
-    i2cAddress = newAddress;
-    Serial.print(F("I2C address set to 0x"));
-    Serial.println(i2cAddress, HEX);
+  // 24C01 (128 bytes) up to 24CM02 (256KB); sizes are powers of two
+  if (size >= 128 && size <= 262144UL && (size & (size - 1)) == 0) {
+    i2cEepromSize = size;
+    #if FEATURE_CACHE
+    cacheClear();  // Addresses map onto the chip differently
+    #endif
+    Serial.print(F("EEPROM size set to "));
+    Serial.println(i2cEepromSize);
   } else {
-    Serial.println(F("Invalid I2C address! Valid range is 0x08-0x77"));
+    Serial.println(F("Invalid size! Use a power of two from 128 to 262144"));
   }
 }
+#endif
 
-unsigned long readHexValue() {
-  while (!Serial.available()) {
-    delay(100);
+// Parse a prompt answer, reporting malformed input
+bool parseHexArg(const char* text, unsigned long& value) {
+  if (!parseHex(text, value)) {
+    Serial.println(F("Invalid hex number"));
+    return false;
   }
-  
-  String input = Serial.readStringUntil('\n');
-  input.trim();
-  
-  // Handle 0x prefix if present
-  if (input.startsWith("0x") || input.startsWith("0X")) {
-    input = input.substring(2);
+  return true;
+}
+
+bool parseDecArg(const char* text, unsigned long& value) {
+  if (!parseDec(text, value)) {
+    Serial.println(F("Invalid number"));
+    return false;
   }
-  
-  return strtoul(input.c_str(), NULL, 16);
+  return true;
 }
 
-unsigned int readDecValue() {
-  while (!Serial.available()) {
-    delay(100);
+// Flash erases whole units, so an erase over the range must not reach
+// outside it; prints why not
+bool wholeEraseUnits(const Geometry& geo, unsigned long address, unsigned long length) {
+  if ((geo.flags & GEO_NEEDS_ERASE) && (address % geo.eraseSize != 0 || length % geo.eraseSize != 0)) {
+    Serial.print(F("The range must be whole erase units of 0x"));
+    Serial.print(geo.eraseSize, HEX);
+    Serial.println(F(" bytes"));
+    return false;
   }
-  
-  String input = Serial.readStringUntil('\n');
-  input.trim();
-  
-  return input.toInt();
+  return true;
 }
 
-// Read bytes using a function pointer and display as hex dump
-void hexDump(byte (*readFunc)(), unsigned int numBytes) {
-  byte buffer[16];
-  
-  for (unsigned int i = 0; i < numBytes; i++) {
-    if (i % 16 == 0) {
-      // Print address at start of line
-      if (i > 0) {
-        Serial.println();
-      }
-      Serial.print("0x");
-      if (i < 0x1000) Serial.print("0");
-      if (i < 0x100) Serial.print("0");
-      if (i < 0x10) Serial.print("0");
-      Serial.print(i, HEX);
-      Serial.print(": ");
-    }
-    
-    // Read byte
-    buffer[i % 16] = readFunc();
-    
-    // Print hex value
-    if (buffer[i % 16] < 0x10) Serial.print("0");
-    Serial.print(buffer[i % 16], HEX);
-    Serial.print(" ");
-    
-    // Print ASCII representation at end of line
-    if ((i % 16 == 15) || (i == numBytes - 1)) {
-      // Pad with spaces if not a full line
-      for (int j = (i % 16) + 1; j < 16; j++) {
-        Serial.print("   ");
-      }
-      
-      Serial.print(" | ");
-      
-      // Print ASCII chars if printable
-      for (int j = 0; j <= (i % 16); j++) {
-        if (buffer[j] >= 32 && buffer[j] <= 126) {
-          Serial.write(buffer[j]);
-        } else {
-          Serial.print(".");
-        }
-      }
-    }
+// A pin that can select a second SPI chip: not the UART, the SPI bus or
+// any pin the NAND or I2C drivers in this build drive
+bool validChipSelect(unsigned long pin) {
+  if (pin < 2 || pin >= NUM_DIGITAL_PINS || pin == MOSI || pin == MISO || pin == SCK) {
+    return false;
   }
-  
-  Serial.println();
+  #if FEATURE_NAND
+  if ((pin >= NAND_DATA_FIRST_PIN && pin <= NAND_DATA_LAST_PIN) ||
+      pin == NAND_CLE_PIN || pin == NAND_ALE_PIN || pin == NAND_WE_PIN ||
+      pin == NAND_RE_PIN || pin == NAND_CE_PIN || pin == NAND_RB_PIN) {
+    return false;
+  }
+  #endif
+  #if FEATURE_I2C
+  if (pin == SDA || pin == SCL) {
+    return false;
+  }
+  #endif
+  return true;
 }
@@ -0,0 +1,196 @@
+/**
+ * Memory test - see memtest.h
+ */
+
+#include "arena.h"
+#include "engine.h"
+#include "memtest.h"
+#include "pattern.h"
+#include "scheduler.h"
+
+#if FEATURE_MEMTEST
+
+// Steps of each half cycle; the second half uses the inverse pattern
+enum MemTestOp {
+  MT_ERASE,
+  MT_BLANK,    // Read back as all 0xFF
+  MT_PROGRAM,
+  MT_VERIFY,
+  MT_OPS
+};
+
+static MemTestJob& test = arena.job.pattern.test;
+
+static void memTestCancel() {
+  engineSetQuiet(false);
+  writeVerify = test.savedVerify;
+}
+
+static void printDrift(const __FlashStringHelper* name, byte index) {
+  unsigned long first = test.firstTimes[index];
+  if (first == 0) {
+    return;
+  }
+
+  long drift = ((long)test.times[index] - (long)first) * 100 / (long)first;
+  Serial.print(name);
+  if (drift >= 0) {
+    Serial.print('+');
+  }
+  Serial.print(drift);
+  Serial.print('%');
+}
+
+static void reportCycle() {
+  Serial.print(F("Cycle "));
+  Serial.print(test.cycle);
+  Serial.print('/');
+  Serial.print(test.cycles);
+  Serial.print(F(": "));
+  if (test.needsErase) {
+    Serial.print(F("erase "));
+    Serial.print(test.times[MT_TIME_ERASE]);
+    Serial.print(F(" ms, "));
+  }
+  Serial.print(F("program "));
+  Serial.print(test.times[MT_TIME_PROGRAM]);
+  Serial.print(F(" ms, read "));
+  Serial.print(test.times[MT_TIME_READ]);
+  Serial.print(F(" ms, "));
+  Serial.print(test.errors);
+  Serial.print(F(" errors"));
+  if (test.errors > 0) {
+    Serial.print(F(" from 0x"));
+    Serial.print(test.firstError, HEX);
+  }
+
+  if (test.cycle == 1) {
+    memcpy(test.firstTimes, test.times, sizeof(test.times));
+  } else {
+    Serial.print(F(", drift"));
+    if (test.needsErase) {
+      printDrift(F(" erase "), MT_TIME_ERASE);
+    }
+    printDrift(F(" program "), MT_TIME_PROGRAM);
+  }
+  Serial.println();
+}
+
+static bool finishTest() {
+  memTestCancel();
+
+  Serial.print(F("Memory test "));
+  Serial.print(test.failedCycles == 0 ? F("passed, ") : F("failed, "));
+  if (test.failedCycles > 0) {
+    Serial.print(test.failedCycles);
+    Serial.print(F(" of "));
+  }
+  Serial.print(test.cycles);
+  Serial.print(test.failedCycles > 0 ? F(" cycles with errors, ") : F(" cycles, "));
+  Serial.print((millis() - test.startTime) / 1000);
+  Serial.println(F(" s"));
+  return true;
+}
+
+// Account for the job that has just ended
+static void endStep() {
+  byte op = test.step % MT_OPS;
+  unsigned long ms = millis() - test.stepStart;
+
+  switch (op) {
+    case MT_ERASE:   test.times[MT_TIME_ERASE] += ms; break;
+    case MT_PROGRAM: test.times[MT_TIME_PROGRAM] += ms; break;
+    default:         test.times[MT_TIME_READ] += ms; break;
+  }
+
+  // A failed program or erase has been reported by the engine
+  unsigned long failed = engineSucceeded() ? 0 : 1;
+  if (op == MT_BLANK || op == MT_VERIFY) {
+    if (patternErrors() > 0 && (test.errors == 0 || patternFirstError() < test.firstError)) {
+      test.firstError = patternFirstError();
+    }
+    failed += patternErrors();
+  }
+  test.errors += failed;
+}
+
+static bool memTestSequence() {
+  if (test.running) {
+    endStep();
+    test.running = false;
+    test.step++;
+
+    if (test.step == 2 * MT_OPS) {
+      reportCycle();
+      if (test.errors > 0) {
+        test.failedCycles++;
+      }
+      if (test.cycle == test.cycles) {
+        return finishTest();
+      }
+
+      test.cycle++;
+      test.step = 0;
+      test.errors = 0;
+      memset(test.times, 0, sizeof(test.times));
+    }
+  }
+
+  byte op = test.step % MT_OPS;
+  if (!test.needsErase && (op == MT_ERASE || op == MT_BLANK)) {
+    test.step += MT_PROGRAM - op;
+    op = MT_PROGRAM;
+  }
+
+  // P in the first half of the cycle, its inverse in the second
+  bool inverse = test.step >= MT_OPS;
+  switch (op) {
+    case MT_ERASE:
+      engineErase(test.dev, test.address, test.length);
+      break;
+    case MT_BLANK:
+      patternSet(PATTERN_CONSTANT, 0xFF, false);
+      patternRead(test.dev, test.address, test.length);
+      break;
+    case MT_PROGRAM:
+      patternSet(PATTERN_RANDOM, test.cycle * 0x9E3779B9UL, inverse);
+      patternWrite(test.dev, test.address, test.length);
+      break;
+    case MT_VERIFY:
+      patternSet(PATTERN_RANDOM, test.cycle * 0x9E3779B9UL, inverse);
+      patternRead(test.dev, test.address, test.length);
+      break;
+  }
+
+  test.stepStart = millis();
+  test.running = true;
+  return false;
+}
+
+void memTestRun(const MemoryDevice& dev, unsigned long address, unsigned long length, unsigned int cycles) {
+  Geometry geo;
+  DRIVER(dev, geometry)(dev.unit, geo);
+
+  test.dev = dev;
+  test.address = address;
+  test.length = length;
+  test.cycles = cycles;
+  test.cycle = 1;
+  test.step = 0;
+  test.running = false;
+  test.needsErase = geo.flags & GEO_NEEDS_ERASE;
+  test.errors = 0;
+  test.failedCycles = 0;
+  memset(test.times, 0, sizeof(test.times));
+  test.startTime = millis();
+
+  // Retries would hide weak bits
+  test.savedVerify = writeVerify;
+  writeVerify = false;
+
+  Serial.println(F("Testing..."));
+  engineSetQuiet(true);
+  startSequence(memTestSequence, memTestCancel);
+}
+
+#endif
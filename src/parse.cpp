@@ -0,0 +1,88 @@
+/**
+ * Input line parsing - see parse.h
+ */
+
+#include "parse.h"
+
+static bool isSeparator(char c) {
+  return c == ' ' || c == ',';
+}
+
+char* nextToken(char*& cursor) {
+  while (isSeparator(*cursor)) {
+    cursor++;
+  }
+  if (*cursor == '\0') {
+    return NULL;
+  }
+
+  char* token = cursor;
+  while (*cursor != '\0' && !isSeparator(*cursor)) {
+    cursor++;
+  }
+  if (*cursor != '\0') {
+    *cursor++ = '\0';
+  }
+  return token;
+}
+
+static int digitValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseNumber(const char* text, byte base, unsigned long& value) {
+  while (*text == ' ') {
+    text++;
+  }
+
+  if (base == 16 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+    text += 2;
+  }
+
+  unsigned long result = 0;
+  byte digits = 0;
+  for (; *text != '\0' && *text != ' '; text++) {
+    int digit = digitValue(*text);
+    if (digit < 0 || digit >= base || result > (0xFFFFFFFFUL - digit) / base) {
+      return false;
+    }
+    result = result * base + digit;
+    digits++;
+  }
+
+  // Only trailing spaces may follow the number
+  while (*text == ' ') {
+    text++;
+  }
+  if (digits == 0 || *text != '\0') {
+    return false;
+  }
+
+  value = result;
+  return true;
+}
+
+bool parseHex(const char* text, unsigned long& value) {
+  return parseNumber(text, 16, value);
+}
+
+bool parseDec(const char* text, unsigned long& value) {
+  return parseNumber(text, 10, value);
+}
+
+byte parseHexBytes(const char* text, byte* out, byte maxLen) {
+  byte count = 0;
+  while (*text != '\0' && *text != '/') {
+    int hi = digitValue(text[0]);
+    int lo = hi < 0 ? -1 : digitValue(text[1]);
+    if (lo < 0 || count == maxLen) {
+      return 0;
+    }
+    out[count++] = hi << 4 | lo;
+    text += 2;
+  }
+  return count;
+}
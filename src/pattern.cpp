@@ -0,0 +1,195 @@
+/**
+ * Test patterns - see pattern.h
+ */
+
+#include "arena.h"
+#include "engine.h"
+#include "pattern.h"
+#include "scheduler.h"
+
+#if FEATURE_PATTERN
+
+static PatternGenerator& pattern = arena.job.pattern.generator;
+
+// State of a fill or check started from the menu
+static PatternRun& run = arena.job.pattern.run;
+
+static void patternBegin(unsigned long address) {
+  pattern.start = address;
+  pattern.address = address;
+  pattern.state = pattern.seed ? pattern.seed : 0x2545F491UL;  // xorshift32 cannot start at 0
+  pattern.errors = 0;
+}
+
+static byte patternByte() {
+  unsigned long a = pattern.address++;
+
+  switch (pattern.kind) {
+    case PATTERN_INCREMENT:
+      return pattern.seed + (a - pattern.start);
+    case PATTERN_ADDRESS:
+      return (a & ~3UL) >> (8 * (a & 3));
+    case PATTERN_WALKING_ONES:
+      return 1 << (a & 7);
+    case PATTERN_WALKING_ZEROS:
+      return ~(1 << (a & 7));
+    case PATTERN_RANDOM: {
+      // A new word every four bytes
+      byte shift = 8 * ((a - pattern.start) & 3);
+      if (shift == 0 && a != pattern.start) {
+        pattern.state ^= pattern.state << 13;
+        pattern.state ^= pattern.state >> 17;
+        pattern.state ^= pattern.state << 5;
+      }
+      return pattern.state >> shift;
+    }
+    default:
+      return pattern.seed;
+  }
+}
+
+static byte patternNext() {
+  return patternByte() ^ pattern.invert;
+}
+
+void printPatterns() {
+  Serial.println(F("1. Constant (seed byte)"));
+  Serial.println(F("2. Incrementing from seed byte"));
+  Serial.println(F("3. Address as data"));
+  Serial.println(F("4. Walking ones"));
+  Serial.println(F("5. Walking zeros"));
+  Serial.println(F("6. Random (xorshift32 from seed)"));
+}
+
+// ===== SOURCE AND CHECKER =====
+
+static unsigned int patternSourceFill(byte* buffer, unsigned int len) {
+  for (unsigned int i = 0; i < len; i++) {
+    buffer[i] = patternNext();
+  }
+  return len;
+}
+
+static const DataSource patternSource PROGMEM = {
+  NULL,
+  patternSourceFill,
+  NULL
+};
+
+static bool patternReady() {
+  return true;
+}
+
+static void patternConsume(unsigned long address, const byte* data, unsigned int len) {
+  for (unsigned int i = 0; i < len; i++) {
+    if (data[i] != patternNext()) {
+      if (pattern.errors == 0) {
+        pattern.firstError = address + i;
+      }
+      pattern.errors++;
+    }
+  }
+}
+
+static const ReadSink patternSink PROGMEM = {
+  patternReady,
+  patternConsume,
+  NULL,
+  PAGE_BUFFER_SIZE
+};
+
+void patternSet(byte kind, uint32_t seed, bool invert) {
+  pattern.kind = kind;
+  pattern.seed = seed;
+  pattern.invert = invert ? 0xFF : 0;
+}
+
+void patternWrite(const MemoryDevice& dev, unsigned long address, unsigned long length) {
+  patternBegin(address);
+  engineWrite(dev, address, length, patternSource, WRITE_PROGRAM);
+}
+
+void patternRead(const MemoryDevice& dev, unsigned long address, unsigned long length) {
+  patternBegin(address);
+  engineRead(dev, address, length, patternSink);
+}
+
+unsigned long patternErrors() {
+  return pattern.errors;
+}
+
+unsigned long patternFirstError() {
+  return pattern.firstError;
+}
+
+// ===== SEQUENCE =====
+
+static void patternCancel() {
+  engineSetQuiet(false);
+}
+
+static void printRate() {
+  unsigned long ms = millis() - run.startTime;
+  Serial.print(run.length);
+  Serial.print(F(" bytes in "));
+  Serial.print(ms);
+  Serial.print(F(" ms"));
+  if (ms > 0) {
+    Serial.print(F(", "));
+    Serial.print(run.length / ms * 1000 + run.length % ms * 1000 / ms);
+    Serial.print(F(" bytes/s"));
+  }
+  Serial.println();
+}
+
+static bool patternSequence() {
+  if (!run.started) {
+    run.started = true;
+    run.startTime = millis();
+    if (run.check) {
+      patternRead(run.dev, run.start, run.length);
+    } else {
+      patternWrite(run.dev, run.start, run.length);
+    }
+    return false;
+  }
+
+  patternCancel();
+  if (!engineSucceeded()) {
+    // The engine has reported it
+  } else if (!run.check) {
+    Serial.print(F("Pattern written, "));
+    printRate();
+  } else if (pattern.errors == 0) {
+    Serial.print(F("Pattern OK, "));
+    printRate();
+  } else {
+    Serial.print(F("Pattern check failed: "));
+    Serial.print(pattern.errors);
+    Serial.print(F(" bytes differ, first at 0x"));
+    Serial.println(pattern.firstError, HEX);
+  }
+  return true;
+}
+
+static void patternRun(const MemoryDevice& dev, unsigned long address, unsigned long length, byte kind, uint32_t seed, bool check) {
+  run.dev = dev;
+  run.start = address;
+  run.length = length;
+  run.check = check;
+  run.started = false;
+  patternSet(kind, seed, false);
+
+  engineSetQuiet(true);
+  startSequence(patternSequence, patternCancel);
+}
+
+void patternFill(const MemoryDevice& dev, unsigned long address, unsigned long length, byte kind, uint32_t seed) {
+  patternRun(dev, address, length, kind, seed, false);
+}
+
+void patternCheck(const MemoryDevice& dev, unsigned long address, unsigned long length, byte kind, uint32_t seed) {
+  patternRun(dev, address, length, kind, seed, true);
+}
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * Cooperative task scheduler - see scheduler.h
+ */
+
+#include "arena.h"
+#include "scheduler.h"
+#include "txring.h"
+
+#define KEY_ETX  0x03  // Ctrl-C
+#define KEY_ESC  0x1B
+
+static void (*commandHandler)(char cmd) = NULL;
+
+// Serial RX state; the line is assembled in arena.line
+static byte lineLength = 0;
+static LineHandler pendingLine = NULL;
+
+// Active job state
+static JobStep activeStep = NULL;
+static JobCancel activeCancel = NULL;
+static byte activeFlags = 0;
+static unsigned long lastProgress = 0;
+
+// Active sequence state
+static JobStep activeSequence = NULL;
+static JobCancel sequenceCancel = NULL;
+
+void schedulerInit(void (*handler)(char cmd)) {
+  commandHandler = handler;
+}
+
+void promptLine(const __FlashStringHelper* prompt, LineHandler handler) {
+  Serial.println(prompt);
+  pendingLine = handler;
+  lineLength = 0;
+}
+
+void startJob(JobStep step, JobCancel cancel, byte flags) {
+  activeStep = step;
+  activeCancel = cancel;
+  activeFlags = flags;
+  lastProgress = millis();
+}
+
+void startSequence(JobStep step, JobCancel cancel) {
+  activeSequence = step;
+  sequenceCancel = cancel;
+}
+
+bool jobActive() {
+  return activeStep != NULL || activeSequence != NULL;
+}
+
+bool outputReady() {
+  return txRingEmpty() && Serial.availableForWrite() >= TX_READY_THRESHOLD;
+}
+
+static void abortJob() {
+  if (activeStep != NULL && activeCancel != NULL) {
+    activeCancel();
+  }
+  activeStep = NULL;
+
+  if (activeSequence != NULL && sequenceCancel != NULL) {
+    sequenceCancel();
+  }
+  activeSequence = NULL;
+
+  // Output still queued would come after the message
+  txRingClear();
+  Serial.println(F("\nAborted"));
+}
+
+// ===== TASKS =====
+
+static void serialRxTask() {
+  while (Serial.available()) {
+    if (jobActive()) {
+      // While a job runs, only abort keys are consumed; anything else
+      // stays queued and is handled once the job has finished
+      if (activeStep != NULL && (activeFlags & JOB_RAW_INPUT)) {
+        return;
+      }
+
+      int c = Serial.peek();
+      if (c == KEY_ESC || c == KEY_ETX) {
+        Serial.read();
+        abortJob();
+      }
+      return;
+    }
+
+    // Commands wait until the output of the last job has gone out
+    if (!txRingEmpty()) {
+      return;
+    }
+
+    char c = Serial.read();
+
+    if (pendingLine == NULL) {
+      // Idle: every character is a command
+      commandHandler(c);
+      continue;
+    }
+
+    if (c == '\n' || c == '\r') {
+      // Skip empty lines, e.g. the line ending that followed a command key
+      if (lineLength == 0) {
+        continue;
+      }
+
+      arena.line[lineLength] = '\0';
+      lineLength = 0;
+
+      LineHandler handler = pendingLine;
+      pendingLine = NULL;
+      handler(arena.line);
+
+      // The handler may have started a job or another prompt
+      if (jobActive()) {
+        return;
+      }
+    } else if (c == KEY_ESC || c == KEY_ETX) {
+      pendingLine = NULL;
+      lineLength = 0;
+      Serial.println(F("Cancelled"));
+    } else if (lineLength < LINE_BUFFER_SIZE - 1) {
+      arena.line[lineLength++] = c;
+    }
+  }
+}
+
+static void jobTask() {
+  if (activeStep != NULL) {
+    if (activeStep()) {
+      activeStep = NULL;
+    }
+  } else if (activeSequence != NULL && txRingEmpty() && activeSequence()) {
+    // Between jobs the sequence starts the next one or finishes
+    activeSequence = NULL;
+  }
+}
+
+static void progressTask() {
+  if (activeStep == NULL || !(activeFlags & JOB_PROGRESS)) {
+    return;
+  }
+
+  if (millis() - lastProgress > PROGRESS_INTERVAL) {
+    Serial.print('.');
+    lastProgress = millis();
+  }
+}
+
+void schedulerRun() {
+  txRingPump();
+  serialRxTask();
+  jobTask();
+  progressTask();
+}
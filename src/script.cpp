@@ -0,0 +1,321 @@
+/**
+ * On-device job scripts - see script.h
+ */
+
+#include <avr/eeprom.h>
+#include "arena.h"
+#include "engine.h"
+#include "parse.h"
+#include "scheduler.h"
+#include "script.h"
+#include "trace.h"
+
+#if FEATURE_SCRIPT
+
+#define SCRIPT_MAGIC  0x5053  // "SP"
+
+struct ScriptHeader {
+  uint16_t magic;
+  byte count;
+};
+
+#define STEP_ADDR(i) \
+  ((void*) (SCRIPT_EEPROM_ADDR + sizeof(ScriptHeader) + (i) * sizeof(ScriptStep)))
+
+static_assert(sizeof(ScriptHeader) + SCRIPT_MAX_STEPS * sizeof(ScriptStep) <= SCRIPT_EEPROM_SIZE,
+              "Script does not fit its EEPROM area");
+
+enum RunPhase {
+  RUN_START,  // Load and start the next step
+  RUN_JOB,    // The step's engine job has finished
+  RUN_POLL    // Waiting for a status register write
+};
+
+static byte uploadCount;
+
+// State of the running script
+static ScriptRun& run = arena.job.script;
+
+static void writeHeader(byte count) {
+  ScriptHeader header = { SCRIPT_MAGIC, count };
+  eeprom_update_block(&header, (void*) SCRIPT_EEPROM_ADDR, sizeof(header));
+}
+
+void scriptClear() {
+  uploadCount = 0;
+  writeHeader(0);
+}
+
+byte scriptLength() {
+  ScriptHeader header;
+  eeprom_read_block(&header, (const void*) SCRIPT_EEPROM_ADDR, sizeof(header));
+
+  if (header.magic != SCRIPT_MAGIC || header.count > SCRIPT_MAX_STEPS) {
+    return 0;
+  }
+  return header.count;
+}
+
+// Parse the next hex number of the line into value
+static bool nextHex(char*& cursor, unsigned long& value) {
+  char* token = nextToken(cursor);
+  return token != NULL && parseHex(token, value);
+}
+
+ScriptLine scriptParseLine(char* line, ScriptStep& step) {
+  char* cursor = line;
+  char* keyword = nextToken(cursor);
+  unsigned long value;
+  step.op = 0;
+  step.address = 0;
+  step.length = 0;
+  step.value = 0;
+
+  if (keyword == NULL) {
+    return SCRIPT_LINE_ERROR;
+  }
+
+  if (strcmp_P(keyword, PSTR("end")) == 0) {
+    return SCRIPT_LINE_END;
+  }
+
+  if (strcmp_P(keyword, PSTR("id")) == 0) {
+    step.op = SCRIPT_ID;
+    while (step.length < 4 && nextHex(cursor, value) && value <= 0xFF) {
+      step.value |= value << (8 * step.length);
+      step.length++;
+    }
+    if (step.length == 0) {
+      return SCRIPT_LINE_ERROR;
+    }
+  } else if (strcmp_P(keyword, PSTR("status")) == 0) {
+    step.op = SCRIPT_STATUS;
+    if (!nextHex(cursor, value) || value > 0xFF) {
+      return SCRIPT_LINE_ERROR;
+    }
+    step.value = value;
+  } else {
+    if (strcmp_P(keyword, PSTR("erase")) == 0) {
+      step.op = SCRIPT_ERASE;
+    } else if (strcmp_P(keyword, PSTR("program")) == 0) {
+      step.op = SCRIPT_PROGRAM;
+    } else if (strcmp_P(keyword, PSTR("verify")) == 0) {
+      step.op = SCRIPT_VERIFY;
+    } else {
+      return SCRIPT_LINE_ERROR;
+    }
+
+    unsigned long address, length;
+    if (!nextHex(cursor, address) || !nextHex(cursor, length) || length == 0) {
+      return SCRIPT_LINE_ERROR;
+    }
+    step.address = address;
+    step.length = length;
+    if (step.op == SCRIPT_VERIFY) {
+      if (!nextHex(cursor, value)) {
+        return SCRIPT_LINE_ERROR;
+      }
+      step.value = value;
+    }
+  }
+
+  // Nothing may follow the arguments
+  if (nextToken(cursor) != NULL) {
+    return SCRIPT_LINE_ERROR;
+  }
+  return SCRIPT_LINE_OK;
+}
+
+ScriptLine scriptAddLine(char* line) {
+  ScriptStep step;
+  ScriptLine result = scriptParseLine(line, step);
+
+  if (result == SCRIPT_LINE_END) {
+    writeHeader(uploadCount);
+  } else if (result == SCRIPT_LINE_OK) {
+    if (uploadCount >= SCRIPT_MAX_STEPS) {
+      return SCRIPT_LINE_ERROR;
+    }
+    eeprom_update_block(&step, STEP_ADDR(uploadCount), sizeof(step));
+    uploadCount++;
+  }
+  return result;
+}
+
+void scriptLoadStep(byte index, ScriptStep& step) {
+  eeprom_read_block(&step, STEP_ADDR(index), sizeof(step));
+}
+
+// ===== EXECUTION =====
+
+static void printStepName(byte op) {
+  switch (op) {
+    case SCRIPT_ID:      Serial.print(F("id")); break;
+    case SCRIPT_STATUS:  Serial.print(F("status")); break;
+    case SCRIPT_ERASE:   Serial.print(F("erase")); break;
+    case SCRIPT_PROGRAM: Serial.print(F("program")); break;
+    case SCRIPT_VERIFY:  Serial.print(F("verify")); break;
+  }
+}
+
+static bool finishScript(bool passed) {
+  engineSetQuiet(false);
+
+  if (passed) {
+    Serial.print(F("Script passed: "));
+    Serial.print(run.count);
+    Serial.print(F(" steps in "));
+    Serial.print(millis() - run.startTime);
+    Serial.println(F(" ms"));
+  } else {
+    Serial.print(F("Script failed at step "));
+    Serial.print(run.index + 1);
+    Serial.print(F(" ("));
+    printStepName(run.step.op);
+    Serial.println(')');
+  }
+  return true;
+}
+
+static bool nextStep() {
+  run.index++;
+  run.phase = RUN_START;
+  return false;
+}
+
+// Compare the device ID with the expected bytes; prints the ID on mismatch
+static bool checkID() {
+  byte id[4];
+  byte count = DRIVER(run.dev, readID)(run.dev.unit, id, sizeof(id));
+
+  bool match = count >= run.step.length;
+  for (byte i = 0; match && i < run.step.length; i++) {
+    match = id[i] == (byte) (run.step.value >> (8 * i));
+  }
+
+  if (!match) {
+    Serial.print(F("ID mismatch, read"));
+    for (byte i = 0; i < count; i++) {
+      Serial.print(' ');
+      Serial.print(id[i], HEX);
+    }
+    Serial.println();
+  }
+  return match;
+}
+
+static bool scriptSequence() {
+  switch (run.phase) {
+    case RUN_JOB:
+      // The engine job of the current step has finished
+      if (!engineSucceeded()) {
+        return finishScript(false);
+      }
+      if (run.step.op == SCRIPT_VERIFY && crcSinkValue() != run.step.value) {
+        Serial.print(F("CRC 0x"));
+        Serial.print(crcSinkValue(), HEX);
+        Serial.print(F(", expected 0x"));
+        Serial.println(run.step.value, HEX);
+        return finishScript(false);
+      }
+      return nextStep();
+
+    case RUN_POLL: {
+      TRACE_START(traceStart);
+      PollResult result = DRIVER(run.dev, poll)(run.dev.unit);
+      TRACE_END(TRACE_POLL, traceStart, 0, 0, result);
+      if (result == POLL_BUSY && (long)(millis() - run.deadline) < 0) {
+        return false;
+      }
+      if (result != POLL_DONE) {
+        Serial.println(F("Error: status write timed out"));
+        return finishScript(false);
+      }
+      return nextStep();
+    }
+  }
+
+  if (run.index == run.count) {
+    return finishScript(true);
+  }
+
+  scriptLoadStep(run.index, run.step);
+
+  switch (run.step.op) {
+    case SCRIPT_ID:
+      return checkID() ? nextStep() : finishScript(false);
+
+    case SCRIPT_STATUS: {
+      TRACE_START(traceStart);
+      bool written = DRIVER(run.dev, writeStatus)(run.dev.unit, run.step.value);
+      TRACE_END(TRACE_STATUS, traceStart, run.step.value, 1, !written);
+      if (!written) {
+        Serial.println(F("Error: no writable status register"));
+        return finishScript(false);
+      }
+      run.deadline = millis() + SCRIPT_STATUS_TIMEOUT_MS;
+      run.phase = RUN_POLL;
+      return false;
+    }
+
+    case SCRIPT_ERASE:
+      engineErase(run.dev, run.step.address, run.step.length);
+      break;
+
+    case SCRIPT_PROGRAM:
+      engineWrite(run.dev, run.step.address, run.step.length, hostSource, WRITE_PROGRAM);
+      break;
+
+    case SCRIPT_VERIFY:
+      crcSinkBegin();
+      engineRead(run.dev, run.step.address, run.step.length, crcSink);
+      break;
+  }
+
+  run.phase = RUN_JOB;
+  return false;
+}
+
+// Flash is erased in whole units, so an erase step that does not cover
+// whole ones would wipe data outside its range
+static bool checkErases() {
+  Geometry geo;
+  DRIVER(run.dev, geometry)(run.dev.unit, geo);
+  if (!(geo.flags & GEO_NEEDS_ERASE)) {
+    return true;
+  }
+
+  for (run.index = 0; run.index < run.count; run.index++) {
+    scriptLoadStep(run.index, run.step);
+    if (run.step.op == SCRIPT_ERASE &&
+        (run.step.address % geo.eraseSize != 0 || run.step.length % geo.eraseSize != 0)) {
+      Serial.print(F("The range must be whole erase units of 0x"));
+      Serial.print(geo.eraseSize, HEX);
+      Serial.println(F(" bytes"));
+      return false;
+    }
+  }
+  return true;
+}
+
+static void scriptCancel() {
+  engineSetQuiet(false);
+}
+
+void scriptRun(const MemoryDevice& dev) {
+  run.dev = dev;
+  run.count = scriptLength();
+  if (!checkErases()) {
+    finishScript(false);
+    return;
+  }
+
+  run.index = 0;
+  run.phase = RUN_START;
+  run.startTime = millis();
+
+  engineSetQuiet(true);
+  startSequence(scriptSequence, scriptCancel);
+}
+
+#endif
@@ -0,0 +1,205 @@
+/**
+ * On-device pattern search - see search.h
+ */
+
+#include "arena.h"
+#include "engine.h"
+#include "parse.h"
+#include "scheduler.h"
+#include "search.h"
+
+#if FEATURE_SEARCH
+
+// The bytes a match may still need are kept in arena.scratch
+static_assert(SEARCH_MAX_BYTES - 1 <= COMPARE_CHUNK, "A pattern must fit in the carried bytes");
+
+static SearchJob& search = arena.job.search;
+
+bool searchSetPatterns(char* line) {
+  SearchPatterns& p = arena.patterns;
+  byte used = 0;
+  p.count = 0;
+
+  char* cursor = line;
+  char* token;
+  while ((token = nextToken(cursor)) != NULL) {
+    if (p.count == SEARCH_MAX_PATTERNS) {
+      return false;
+    }
+
+    byte length = parseHexBytes(token, p.data + used, SEARCH_MAX_BYTES - used);
+    if (length == 0) {
+      return false;
+    }
+
+    memset(p.mask + used, 0xFF, length);
+    const char* mask = strchr(token, '/');
+    if (mask != NULL && parseHexBytes(mask + 1, p.mask + used, length) != length) {
+      return false;
+    }
+
+    p.length[p.count++] = length;
+    used += length;
+  }
+  return p.count > 0;
+}
+
+// Byte i of the carried bytes followed by the chunk
+static byte at(const byte* data, unsigned int i) {
+  return i < search.carried ? arena.scratch[i] : data[i - search.carried];
+}
+
+static void buildSkipTable() {
+  const SearchPatterns& p = arena.patterns;
+  byte m = search.shortest;
+  memset(arena.search.skip, m, sizeof(arena.search.skip));
+
+  // Any byte a pattern accepts at position j lets the window move m - 1 - j
+  byte offset = 0;
+  for (byte k = 0; k < p.count; k++) {
+    for (byte j = 0; j + 1 < m; j++) {
+      byte want = p.data[offset + j];
+      byte mask = p.mask[offset + j];
+      for (unsigned int c = 0; c < 256; c++) {
+        if (((c ^ want) & mask) == 0 && arena.search.skip[c] > m - 1 - j) {
+          arena.search.skip[c] = m - 1 - j;
+        }
+      }
+    }
+    offset += p.length[k];
+  }
+}
+
+static void checkMatches(const byte* data, unsigned int pos, unsigned int total) {
+  const SearchPatterns& p = arena.patterns;
+  byte offset = 0;
+  for (byte k = 0; k < p.count; k++) {
+    byte length = p.length[k];
+    if (pos + length <= total) {
+      byte j = 0;
+      while (j < length && ((at(data, pos + j) ^ p.data[offset + j]) & p.mask[offset + j]) == 0) {
+        j++;
+      }
+
+      if (j == length) {
+        if (search.matches < SEARCH_MAX_MATCHES) {
+          Serial.print(F("Match at 0x"));
+          Serial.print(search.base + pos, HEX);
+          Serial.print(F(", pattern "));
+          Serial.println(k + 1);
+        }
+        search.matches++;
+      }
+    }
+    offset += length;
+  }
+}
+
+// Search the carried bytes and the chunk. Windows that a longer pattern
+// could run past are left for the next chunk, except at the end
+static void scan(const byte* data, unsigned int len, bool last) {
+  unsigned int total = search.carried + len;
+  unsigned int need = last ? search.shortest : search.longest;
+  unsigned int pos = 0;
+
+  while (pos + need <= total) {
+    checkMatches(data, pos, total);
+    pos += arena.search.skip[at(data, pos + search.shortest - 1)];
+  }
+
+  if (pos > total) {
+    search.skipAhead = pos - total;
+    search.carried = 0;
+    return;
+  }
+
+  // Moving down, so the carried bytes can be overwritten in place
+  byte keep = total - pos;
+  for (byte i = 0; i < keep; i++) {
+    arena.scratch[i] = at(data, pos + i);
+  }
+  search.carried = keep;
+  search.base += pos;
+}
+
+static bool searchReady() {
+  return outputReady();
+}
+
+static void searchConsume(unsigned long address, const byte* data, unsigned int len) {
+  if (search.skipAhead >= len) {
+    search.skipAhead -= len;
+    return;
+  }
+  data += search.skipAhead;
+  len -= search.skipAhead;
+  if (search.carried == 0) {
+    search.base = address + search.skipAhead;
+  }
+  search.skipAhead = 0;
+
+  scan(data, len, false);
+}
+
+static void searchFinish() {
+  scan(NULL, 0, true);
+}
+
+static const ReadSink searchSink PROGMEM = {
+  searchReady,
+  searchConsume,
+  searchFinish,
+  PAGE_BUFFER_SIZE
+};
+
+static bool searchSequence() {
+  if (!search.running) {
+    search.running = true;
+    engineRead(search.dev, search.address, search.length, searchSink);
+    return false;
+  }
+
+  if (!engineSucceeded()) {
+    Serial.println(F("Search failed"));
+    return true;
+  }
+
+  Serial.print(F("Search done, "));
+  Serial.print(search.matches);
+  Serial.print(F(" matches in "));
+  Serial.print(millis() - search.startTime);
+  Serial.print(F(" ms"));
+  if (search.matches > SEARCH_MAX_MATCHES) {
+    Serial.print(F(", first "));
+    Serial.print(SEARCH_MAX_MATCHES);
+    Serial.print(F(" listed"));
+  }
+  Serial.println();
+  return true;
+}
+
+void searchRun(const MemoryDevice& dev, unsigned long address, unsigned long length) {
+  const SearchPatterns& p = arena.patterns;
+  search.shortest = 0xFF;
+  search.longest = 0;
+  for (byte k = 0; k < p.count; k++) {
+    search.shortest = min(search.shortest, p.length[k]);
+    search.longest = max(search.longest, p.length[k]);
+  }
+
+  search.dev = dev;
+  search.address = address;
+  search.length = length;
+  search.carried = 0;
+  search.skipAhead = 0;
+  search.base = address;
+  search.matches = 0;
+  search.running = false;
+  search.startTime = millis();
+
+  buildSkipTable();
+  Serial.println(F("Searching..."));
+  startSequence(searchSequence, NULL);
+}
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * Operation statistics - see stats.h
+ */
+
+#include "stats.h"
+
+#if FEATURE_STATS
+
+struct StatEntry {
+  unsigned long count;
+  unsigned long bytes;
+  unsigned long total;  // Microseconds; wraps after about 71 minutes
+  unsigned long min;
+  unsigned long max;
+};
+
+static StatEntry stats[STAT_COUNT];
+
+static void resetStats() {
+  for (byte i = 0; i < STAT_COUNT; i++) {
+    stats[i].count = 0;
+    stats[i].bytes = 0;
+    stats[i].total = 0;
+    stats[i].min = 0xFFFFFFFF;
+    stats[i].max = 0;
+  }
+}
+
+void statsRecord(byte op, unsigned int bytes, unsigned long micros) {
+  StatEntry& e = stats[op];
+
+  // The table starts out zeroed; min is primed on first use
+  if (e.count == 0) {
+    e.min = micros;
+  }
+
+  e.count++;
+  e.bytes += bytes;
+  e.total += micros;
+  if (micros < e.min) e.min = micros;
+  if (micros > e.max) e.max = micros;
+}
+
+static void printColumn(unsigned long value, byte width) {
+  // Right-align; at most 10 digits
+  byte digits = 1;
+  for (unsigned long v = value; v >= 10; v /= 10) {
+    digits++;
+  }
+  while (digits++ < width) {
+    Serial.print(' ');
+  }
+  Serial.print(value);
+}
+
+void printStats() {
+  static const char names[STAT_COUNT][8] PROGMEM = {
+    "read", "program", "erase", "poll", "busy", "output", "input"
+  };
+
+  Serial.println(F("op          count       bytes    total us   min us   max us"));
+  for (byte i = 0; i < STAT_COUNT; i++) {
+    const StatEntry& e = stats[i];
+    const char* name = names[i];
+
+    Serial.print((const __FlashStringHelper*) name);
+    for (byte pad = strlen_P(name); pad < 7; pad++) {
+      Serial.print(' ');
+    }
+    printColumn(e.count, 10);
+    printColumn(e.bytes, 12);
+    printColumn(e.total, 12);
+    printColumn(e.count ? e.min : 0, 9);
+    printColumn(e.max, 9);
+    Serial.println();
+  }
+
+  resetStats();
+}
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * Bus transaction trace - see trace.h
+ */
+
+#include "driver.h"
+#include "trace.h"
+
+#if FEATURE_TRACE
+
+struct TraceEntry {
+  uint32_t start;     // micros() when the call began
+  uint32_t duration;  // Until the call returned, or the last folded poll did
+  uint32_t address;
+  uint32_t length;
+  byte op;
+  byte result;
+};
+
+static TraceEntry ring[TRACE_ENTRIES];
+static byte head = 0;          // Next entry to write
+static byte count = 0;
+static unsigned long dropped = 0;
+
+void traceRecord(byte op, unsigned long start, unsigned long address, unsigned long length, byte result) {
+  unsigned long now = micros();
+
+  // Fold a run of busy polls into one entry spanning the wait
+  if (op == TRACE_POLL && result == POLL_BUSY && count > 0) {
+    TraceEntry& last = ring[head == 0 ? TRACE_ENTRIES - 1 : head - 1];
+    if (last.op == TRACE_POLL && last.result == POLL_BUSY) {
+      last.duration = now - last.start;
+      last.length++;
+      return;
+    }
+  }
+
+  TraceEntry& e = ring[head];
+  e.start = start;
+  e.duration = now - start;
+  e.address = address;
+  e.length = (op == TRACE_POLL) ? 1 : length;
+  e.op = op;
+  e.result = result;
+
+  head = (head + 1 < TRACE_ENTRIES) ? head + 1 : 0;
+  if (count < TRACE_ENTRIES) {
+    count++;
+  } else {
+    dropped++;
+  }
+}
+
+void printTrace() {
+  static const char names[TRACE_OP_COUNT][8] PROGMEM = {
+    "read", "program", "erase", "poll", "status"
+  };
+
+  Serial.print(F("Trace: "));
+  Serial.print(count);
+  Serial.print(F(" entries, "));
+  Serial.print(dropped);
+  Serial.println(F(" dropped"));
+
+  // Fields: start us, duration us, op, address (hex), length, result
+  byte index = (head + TRACE_ENTRIES - count) % TRACE_ENTRIES;
+  for (byte i = 0; i < count; i++) {
+    const TraceEntry& e = ring[index];
+
+    Serial.print(F("T "));
+    Serial.print(e.start);
+    Serial.print(' ');
+    Serial.print(e.duration);
+    Serial.print(' ');
+    Serial.print((const __FlashStringHelper*) names[e.op]);
+    Serial.print(' ');
+    Serial.print(e.address, HEX);
+    Serial.print(' ');
+    Serial.print(e.length);
+    Serial.print(' ');
+    Serial.println(e.result);
+
+    index = (index + 1 < TRACE_ENTRIES) ? index + 1 : 0;
+  }
+
+  head = 0;
+  count = 0;
+  dropped = 0;
+}
+
+#endif
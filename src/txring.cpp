@@ -0,0 +1,58 @@
+/**
+ * Serial TX ring - see txring.h
+ */
+
+#include "arena.h"
+#include "txring.h"
+
+static unsigned int head = 0;   // Next byte to send
+static unsigned int count = 0;  // Bytes queued
+
+bool txRingWrite(const byte* data, unsigned int len) {
+  if (len > TX_RING_SIZE - count) {
+    return false;
+  }
+
+  unsigned int tail = head + count;
+  if (tail >= TX_RING_SIZE) {
+    tail -= TX_RING_SIZE;
+  }
+  count += len;
+
+  // At most two copies: up to the end of the ring, then from its start
+  unsigned int first = min(len, (unsigned int)(TX_RING_SIZE - tail));
+  memcpy(arena.reader.tx + tail, data, first);
+  memcpy(arena.reader.tx, data + first, len - first);
+  return true;
+}
+
+unsigned int txRingFree() {
+  return TX_RING_SIZE - count;
+}
+
+bool txRingEmpty() {
+  return count == 0;
+}
+
+void txRingClear() {
+  head = 0;
+  count = 0;
+}
+
+void txRingPump() {
+  while (count > 0) {
+    unsigned int room = Serial.availableForWrite();
+    if (room == 0) {
+      return;
+    }
+
+    // One contiguous block per call
+    unsigned int len = min(min(room, count), (unsigned int)(TX_RING_SIZE - head));
+    Serial.write(arena.reader.tx + head, len);
+    head += len;
+    if (head == TX_RING_SIZE) {
+      head = 0;
+    }
+    count -= len;
+  }
+}
@@ -0,0 +1,79 @@
+"""
+Verify-on-write retry on the I2C EEPROM
+
+Runs the host build of the firmware (pio run -e native) with one EEPROM
+page set to fail its first write (--i2c-fail), leaving it all zeros. The
+read-back then finds bits that would need an erase on flash, but an EEPROM
+takes the page again, so the write must succeed with that one page
+programmed twice and the chip must hold the image afterwards.
+
+Usage:
+  python test/write_retry.py [--program .pio/build/native/program]
+"""
+
+import argparse
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import zlib
+
+DEFAULT_PROGRAM = os.path.join(".pio", "build", "native", "program")
+
+SIZE = 1024
+FAILING = 0x100
+
+
+def run(program, image, fail):
+    """Program the image with verify-on-write, then CRC it with a script."""
+    crc = zlib.crc32(image) & 0xFFFFFFFF
+    commands = "3\nW\np\n0\n%d\nS\nverify 0 %x %08X\nend\nx\n" % (len(image), len(image), crc)
+    with tempfile.NamedTemporaryFile(suffix=".bin", delete=False) as f:
+        f.write(image)
+    try:
+        args = [program, "--image", f.name]
+        if fail is not None:
+            args += ["--i2c-fail", str(fail)]
+        result = subprocess.run(args, input=commands.encode(), capture_output=True)
+    finally:
+        os.unlink(f.name)
+    return result.returncode, result.stdout.decode(errors="replace")
+
+
+def check(name, output, status, rewritten):
+    failures = []
+    if status != 0:
+        failures.append("exit status %d" % status)
+    if "Write complete" not in output:
+        failures.append("write did not complete")
+    if rewritten and "1 pages programmed twice" not in output:
+        failures.append("expected one page programmed twice")
+    if not rewritten and "programmed twice" in output:
+        failures.append("no page should be programmed twice")
+    if "Script passed" not in output:
+        failures.append("read-back CRC does not match")
+
+    print("%s: %s" % (name, "; ".join(failures) if failures else "ok"))
+    return not failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--program", default=DEFAULT_PROGRAM)
+    args = parser.parse_args()
+
+    # Non-zero bytes, so the zeroed page has a 0 wherever the image has a 1
+    rng = random.Random(1)
+    image = bytes(rng.randrange(1, 256) for _ in range(SIZE))
+
+    passed = True
+    status, output = run(args.program, image, None)
+    passed &= check("clean write", output, status, False)
+    status, output = run(args.program, image, FAILING)
+    passed &= check("page fails once", output, status, True)
+    sys.exit(0 if passed else 1)
+
+
+if __name__ == "__main__":
+    main()